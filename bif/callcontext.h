@@ -92,6 +92,8 @@ public:
 class CallContext {
 private:
     const Atom args;
+    const Atom* const argv;
+    const int argc;
     mutable Atom currentParam;
     mutable int currentIndex;
     mutable Atom result;
@@ -99,18 +101,41 @@ public:
     Engine* const engine;
     Storage* const storage;
 
+    /**
+      Creates a context for the given list of arguments.
+      */
     CallContext(Engine* engine, Storage* storage, Atom args)
         : args(args),
+          argv(NULL),
+          argc(0),
           currentParam(args),
           currentIndex(0),
           result(NIL),
           engine(engine),
           storage(storage) {}
 
+    /**
+      Creates a context for the given array of arguments. This is used if
+      the arguments are taken directly from the stack, so that no list has
+      to be created.
+      */
+    CallContext(Engine* engine, Storage* storage, const Atom* argv, int argc)
+        : args(NIL),
+          argv(argv),
+          argc(argc),
+          currentParam(NIL),
+          currentIndex(0),
+          result(NIL),
+          engine(engine),
+          storage(storage) {}
+
     /**
       Checks if more arguments are available.
       */
     inline bool hasMoreArguments() const {
+        if (argv != NULL) {
+            return currentIndex < argc;
+        }
         return isCons(currentParam);
     }
 
@@ -121,8 +146,8 @@ public:
     Atom fetchArgument(const char* bifName,
                        const char* file,
                        int line) const {
-        currentIndex++;
         if (!hasMoreArguments()) {
+            currentIndex++;
             if (currentIndex == 1) {
                 engine->panic(QString("The built in function: %1 requires at least one argument! (%3:%4)").
                       arg(QString(bifName),
@@ -137,17 +162,22 @@ public:
                           numberToString(line)));
             }
         }
+        currentIndex++;
+        if (argv != NULL) {
+            return argv[currentIndex - 1];
+        }
         Cell cons = storage->getCons(currentParam);
         currentParam = cons.cdr;
         return cons.car;
     }
 
     /**
-      Fetches a string argument.
+      Fetches a string argument without materializing its value. This is
+      used to create substrings.
       */
-    QString fetchString(const char* bifName,
-                        const char* file,
-                        int line) const {
+    Atom fetchStringAtom(const char* bifName,
+                         const char* file,
+                         int line) const {
         Atom result = fetchArgument(bifName, file, line);
         if (!isString(result)) {
             engine->panic(QString("The %2. argument of %1 must be a string! (%3:%4)").
@@ -156,7 +186,16 @@ public:
                       QString(file),
                       numberToString(line)));
         }
-        return storage->getString(result);
+        return result;
+    }
+
+    /**
+      Fetches a string argument.
+      */
+    QString fetchString(const char* bifName,
+                        const char* file,
+                        int line) const {
+        return storage->getString(fetchStringAtom(bifName, file, line));
     }
 
     /**
@@ -176,6 +215,24 @@ public:
         return storage->getNumber(result);
     }
 
+    /**
+      Fetches an integer argument without truncating it to an int. This is
+      used for sizes and positions which might exceed 2^31.
+      */
+    Number fetchLong(const char* bifName,
+                     const char* file,
+                     int line) const {
+        Atom result = fetchArgument(bifName, file, line);
+        if (!isNumber(result)) {
+            engine->panic(QString("The %2. argument of %1 must be a number! (%3:%4)").
+                  arg(QString(bifName),
+                      numberToString(currentIndex),
+                      QString(file),
+                      numberToString(line)));
+        }
+        return storage->getNumber(result);
+    }
+
     /**
       Fetches a double argument. If an integer was given, this is
       automatically converted.
@@ -203,8 +260,12 @@ public:
       */
    Array* fetchArray(const char* bifName,
                         const char* file,
-                        int line) const {
+                        int line,
+                        Atom* atom = NULL) const {
         Atom result = fetchArgument(bifName, file, line);
+        if (atom != NULL) {
+            *atom = result;
+        }
         if (!isArray(result)) {
             engine->panic(QString("The %2. argument of %1 must be an array! (%3:%4)").
                   arg(QString(bifName),
@@ -1,9 +1,13 @@
 #include "coreextension.h"
+#include "compiler/verifier.h"
 
 #include <algorithm>
+#include <cmath>
 #include <sstream>
 
 #include <QDateTime>
+#include <QFile>
+#include <QTextStream>
 
 CoreExtension* CoreExtension::INSTANCE = new CoreExtension();
 
@@ -31,24 +35,43 @@ void CoreExtension::registerBuiltInFunctions(Engine* engine) {
     engine->makeBuiltInFunction("makeArray", bif_makeArray);
     engine->makeBuiltInFunction("readArray", bif_readArray);
     engine->makeBuiltInFunction("writeArray", bif_writeArray);
+    engine->makeBuiltInFunction("arrayLength", bif_arrayLength);
+    engine->makeBuiltInFunction("sliceArray", bif_sliceArray);
 
     // String functions
     engine->makeBuiltInFunction("strLength", bif_strlen);
     engine->makeBuiltInFunction("strPart", bif_substr);
     engine->makeBuiltInFunction("ascii", bif_ascii);
     engine->makeBuiltInFunction("char", bif_char);
+    engine->makeBuiltInFunction("str::indexOf", bif_strIndexOf);
+    engine->makeBuiltInFunction("str::lastIndexOf", bif_strLastIndexOf);
+    engine->makeBuiltInFunction("str::contains", bif_strContains);
+    engine->makeBuiltInFunction("str::startsWith", bif_strStartsWith);
+    engine->makeBuiltInFunction("str::endsWith", bif_strEndsWith);
+    engine->makeBuiltInFunction("str::split", bif_strSplit);
 
     // Maths
-    //cos sin sqrt round floor ceil pow
+    engine->makeBuiltInFunction("sqrt", bif_sqrt);
+    engine->makeBuiltInFunction("sin", bif_sin);
+    engine->makeBuiltInFunction("cos", bif_cos);
+    engine->makeBuiltInFunction("pow", bif_pow);
+    engine->makeBuiltInFunction("round", bif_round);
+    engine->makeBuiltInFunction("floor", bif_floor);
+    engine->makeBuiltInFunction("ceil", bif_ceil);
 
     // Specials
     engine->makeBuiltInFunction("log", bif_log);
+    engine->makeBuiltInFunction("panic", bif_panic);
     engine->makeBuiltInFunction("time", bif_time);
     engine->makeBuiltInFunction("version", bif_version);
     engine->makeBuiltInFunction("wordsize", bif_wordsize);
     engine->makeBuiltInFunction("engine::setValue", bif_setValue);
     engine->makeBuiltInFunction("engine::getValue", bif_getValue);
     engine->makeBuiltInFunction("engine::getValueKeys", bif_getValueKeys);
+    engine->makeBuiltInFunction("engine::verify", bif_verify);
+    engine->makeBuiltInFunction("engine::writeOpProfile",
+                                bif_writeOpProfile);
+    engine->makeBuiltInFunction("engine::writeSamples", bif_writeSamples);
     engine->makeBuiltInFunction("settings::read", bif_readSetting);
     engine->makeBuiltInFunction("settings::write", bif_writeSetting);
 }
@@ -63,6 +86,47 @@ void CoreExtension::bif_getValue(const CallContext& ctx) {
     ctx.setResult(ctx.engine->getValue(ctx.fetchArgument(BIF_INFO)));
 }
 
+void CoreExtension::bif_writeOpProfile(const CallContext& ctx) {
+    QFile file(ctx.fetchString(BIF_INFO));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        ctx.setResult(SYMBOL_FALSE);
+        return;
+    }
+    QTextStream out(&file);
+    out << "name,count,cycles\n";
+    Atom profile = ctx.engine->getValue(SYMBOL_VALUE_OP_PROFILE);
+    while (isCons(profile)) {
+        Cell entry = ctx.storage->getCons(profile);
+        Cell name = ctx.storage->getCons(entry.car);
+        Cell count = ctx.storage->getCons(name.cdr);
+        Cell cycles = ctx.storage->getCons(count.cdr);
+        out << ctx.engine->toSimpleString(name.car) << ","
+            << ctx.storage->getNumber(count.car) << ","
+            << ctx.storage->getNumber(cycles.car) << "\n";
+        profile = entry.cdr;
+    }
+    ctx.setResult(SYMBOL_TRUE);
+}
+
+void CoreExtension::bif_verify(const CallContext& ctx) {
+    Atom code = ctx.fetchArgument(BIF_INFO);
+    Verifier verifier(ctx.storage);
+    if (verifier.verify(code)) {
+        ctx.setResult(SYMBOL_TRUE);
+    } else {
+        ctx.setResult(SYMBOL_FALSE);
+    }
+}
+
+void CoreExtension::bif_writeSamples(const CallContext& ctx) {
+    QString fileName = ctx.fetchString(BIF_INFO);
+    if (ctx.engine->getSamplingProfiler()->writeFoldedStacks(fileName)) {
+        ctx.setResult(SYMBOL_TRUE);
+    } else {
+        ctx.setResult(SYMBOL_FALSE);
+    }
+}
+
 void CoreExtension::bif_getValueKeys(const CallContext& ctx) {
     ListBuilder lb(ctx.storage);
     lb.append(SYMBOL_VALUE_HOME_PATH);
@@ -84,6 +148,15 @@ void CoreExtension::bif_getValueKeys(const CallContext& ctx) {
     lb.append(SYMBOL_VALUE_NUM_REFERENCES_USED);
     lb.append(SYMBOL_VALUE_NUM_TOTAL_ARRAYS);
     lb.append(SYMBOL_VALUE_NUM_ARRAYS_USED);
+    lb.append(SYMBOL_VALUE_PROFILE_OP_SEQUENCES);
+    lb.append(SYMBOL_VALUE_OP_SEQUENCES);
+    lb.append(SYMBOL_VALUE_PROFILE_OPS);
+    lb.append(SYMBOL_VALUE_OP_PROFILE);
+    lb.append(SYMBOL_VALUE_PROFILE_SAMPLES);
+    lb.append(SYMBOL_VALUE_SAMPLES);
+    lb.append(SYMBOL_VALUE_JIT_ENABLED);
+    lb.append(SYMBOL_VALUE_JIT_BLOCKS);
+    lb.append(SYMBOL_VALUE_JIT_PERF_MAP);
     ctx.setResult(lb.getResult());
 }
 
@@ -107,6 +180,11 @@ void CoreExtension::bif_log(const CallContext& ctx) {
                     ctx.fetchArgument(BIF_INFO)));
 }
 
+void CoreExtension::bif_panic(const CallContext& ctx) {
+    ctx.engine->panic(ctx.engine->toSimpleString(
+                          ctx.fetchArgument(BIF_INFO)));
+}
+
 void CoreExtension::bif_typeOf(const CallContext& ctx) {
     Atom first = ctx.fetchArgument(BIF_INFO);
     switch(getType(first)) {
@@ -143,7 +221,12 @@ void CoreExtension::bif_symbol(const CallContext& ctx) {
 }
 
 void CoreExtension::bif_ascii(const CallContext& ctx) {
-    ctx.setNumberResult(ctx.fetchString(BIF_INFO).at(0).toAscii());
+    Atom str = ctx.fetchStringAtom(BIF_INFO);
+    if (ctx.storage->getStringLength(str) == 0) {
+        ctx.setNumberResult(0);
+        return;
+    }
+    ctx.setNumberResult(ctx.storage->getStringChar(str, 0).toAscii());
 }
 
 void CoreExtension::bif_char(const CallContext& ctx) {
@@ -196,6 +279,22 @@ void CoreExtension::bif_writeArray(const CallContext& ctx) {
     ctx.setResult(val);
 }
 
+void CoreExtension::bif_arrayLength(const CallContext& ctx) {
+    ctx.setNumberResult(ctx.fetchArray(BIF_INFO)->length());
+}
+
+void CoreExtension::bif_sliceArray(const CallContext& ctx) {
+    Atom array = NIL;
+    int arrayLength = ctx.fetchArray(BIF_INFO, &array)->length();
+    int pos = ctx.fetchNumber(BIF_INFO);
+    pos = std::max(std::min(pos - 1, arrayLength), 0);
+    int length = arrayLength - pos;
+    if (ctx.hasMoreArguments()) {
+        length = std::max(std::min(ctx.fetchNumber(BIF_INFO), length), 0);
+    }
+    ctx.setResult(ctx.storage->makeArraySlice(array, pos + 1, length));
+}
+
 void CoreExtension::bif_include(const CallContext& ctx) {
     Atom code = ctx.engine->compileFile(ctx.fetchString(BIF_INFO),
                                         false);
@@ -236,16 +335,148 @@ void CoreExtension::bif_call(const CallContext& ctx) {
 }
 
 void CoreExtension::bif_strlen(const CallContext& ctx) {
-    ctx.setNumberResult(ctx.fetchString(BIF_INFO).length());
+    Atom str = ctx.fetchStringAtom(BIF_INFO);
+    ctx.setNumberResult(ctx.storage->getStringLength(str));
 }
 
 void CoreExtension::bif_substr(const CallContext& ctx) {
-    QString str = ctx.fetchString(BIF_INFO);
+    Atom str = ctx.fetchStringAtom(BIF_INFO);
+    int strLength = ctx.storage->getStringLength(str);
     int pos = ctx.fetchNumber(BIF_INFO);
-    pos = std::max(std::min(pos - 1, str.length()), 0);
+    pos = std::max(std::min(pos - 1, strLength), 0);
     int length = ctx.fetchNumber(BIF_INFO);
-    length = std::min(length, str.length() - pos);
-    ctx.setStringResult(str.mid(pos, length));
+    if (length < 0 || length > strLength - pos) {
+        length = strLength - pos;
+    }
+    ctx.setResult(ctx.storage->makeSubString(str, pos, length));
+}
+
+void CoreExtension::bif_strIndexOf(const CallContext& ctx) {
+    QString subString = ctx.fetchString(BIF_INFO);
+    QString str = ctx.fetchString(BIF_INFO);
+    int pos = 1;
+    if (ctx.hasMoreArguments()) {
+        pos = std::max(ctx.fetchNumber(BIF_INFO), 1);
+    }
+    // QString::indexOf switches to Boyer-Moore for longer strings, so that
+    // no substrings are created while searching...
+    ctx.setNumberResult(str.indexOf(subString, pos - 1) + 1);
+}
+
+void CoreExtension::bif_strLastIndexOf(const CallContext& ctx) {
+    QString subString = ctx.fetchString(BIF_INFO);
+    QString str = ctx.fetchString(BIF_INFO);
+    ctx.setNumberResult(str.lastIndexOf(subString) + 1);
+}
+
+void CoreExtension::bif_strContains(const CallContext& ctx) {
+    QString subString = ctx.fetchString(BIF_INFO);
+    QString str = ctx.fetchString(BIF_INFO);
+    ctx.setResult(str.contains(subString) ? SYMBOL_TRUE : SYMBOL_FALSE);
+}
+
+void CoreExtension::bif_strStartsWith(const CallContext& ctx) {
+    QString prefix = ctx.fetchString(BIF_INFO);
+    QString str = ctx.fetchString(BIF_INFO);
+    ctx.setResult(str.startsWith(prefix) ? SYMBOL_TRUE : SYMBOL_FALSE);
+}
+
+void CoreExtension::bif_strEndsWith(const CallContext& ctx) {
+    QString suffix = ctx.fetchString(BIF_INFO);
+    QString str = ctx.fetchString(BIF_INFO);
+    ctx.setResult(str.endsWith(suffix) ? SYMBOL_TRUE : SYMBOL_FALSE);
+}
+
+void CoreExtension::bif_strSplit(const CallContext& ctx) {
+    QString separator = ctx.fetchString(BIF_INFO);
+    QString str = ctx.fetchString(BIF_INFO);
+
+    // The parts are appended to the result directly, without creating an
+    // intermediate QStringList...
+    ListBuilder builder(ctx.storage);
+    int start = 0;
+    if (!separator.isEmpty()) {
+        int index = str.indexOf(separator);
+        while (index >= 0) {
+            if (index > start) {
+                builder.append(ctx.storage->makeString(
+                                   str.mid(start, index - start)));
+            }
+            start = index + separator.length();
+            index = str.indexOf(separator, start);
+        }
+    }
+    if (start < str.length()) {
+        builder.append(ctx.storage->makeString(str.mid(start)));
+    }
+    ctx.setResult(builder.getResult());
+}
+
+void CoreExtension::bif_sqrt(const CallContext& ctx) {
+    ctx.setDoubleResult(std::sqrt(ctx.fetchDouble(BIF_INFO)));
+}
+
+void CoreExtension::bif_sin(const CallContext& ctx) {
+    ctx.setDoubleResult(std::sin(ctx.fetchDouble(BIF_INFO)));
+}
+
+void CoreExtension::bif_cos(const CallContext& ctx) {
+    ctx.setDoubleResult(std::cos(ctx.fetchDouble(BIF_INFO)));
+}
+
+void CoreExtension::bif_pow(const CallContext& ctx) {
+    double base = ctx.fetchDouble(BIF_INFO);
+    double exponent = ctx.fetchDouble(BIF_INFO);
+    ctx.setDoubleResult(std::pow(base, exponent));
+}
+
+bool CoreExtension::fetchDecimal(const CallContext& ctx,
+                                 const char* bifName,
+                                 double* value)
+{
+    Atom x = ctx.fetchArgument(BIF_INFO);
+    if (isNumber(x)) {
+        // Integers are already rounded...
+        ctx.setResult(x);
+        return false;
+    }
+    if (!isDecimalNumber(x)) {
+        ctx.engine->panic(QString("The 1. argument of %1 must be a number!").
+                          arg(bifName));
+    }
+    *value = ctx.storage->getDecimal(x);
+    return true;
+}
+
+void CoreExtension::setIntegralResult(const CallContext& ctx, double value) {
+    // Compared as double, as the limits of Number cannot be represented
+    // exactly...
+    if (value >= -9.2e18 && value <= 9.2e18) {
+        ctx.setResult(ctx.storage->makeNumber(static_cast<Number>(value)));
+    } else {
+        ctx.setDoubleResult(value);
+    }
+}
+
+void CoreExtension::bif_round(const CallContext& ctx) {
+    double x;
+    if (fetchDecimal(ctx, "round", &x)) {
+        setIntegralResult(ctx, x < 0 ? std::ceil(x - 0.5) : std::floor(x + 0.5));
+    }
+}
+
+void CoreExtension::bif_floor(const CallContext& ctx) {
+    double x;
+    if (fetchDecimal(ctx, "floor", &x)) {
+        setIntegralResult(ctx, std::floor(x));
+    }
+}
+
+void CoreExtension::bif_ceil(const CallContext& ctx) {
+    double x;
+    if (fetchDecimal(ctx, "ceil", &x)) {
+        setIntegralResult(ctx, std::ceil(x));
+    }
 }
 
 QVariant CoreExtension::fetchQVariant(const CallContext& ctx,
@@ -40,6 +40,35 @@ private:
      */
     static void bif_getValueKeys(const CallContext& ctx);
 
+    /**
+      Verifies the given hand written code list like compiled code. The op
+      codes of accepted function bodies are replaced by their unchecked
+      variants. Returns #TRUE if all bodies were accepted.
+
+        verify := (code : List) -> Boolean
+
+     */
+    static void bif_verify(const CallContext& ctx);
+
+    /**
+      Writes the values recorded by the op profiler (see #OP_PROFILE) as
+      CSV (name,count,cycles) into the given file.
+
+        writeOpProfile := (fileName : String) -> Boolean
+
+     */
+    static void bif_writeOpProfile(const CallContext& ctx);
+
+    /**
+      Writes the stacks recorded by the sampling profiler (see
+      #PROFILE_SAMPLES) as folded stacks into the given file. This can be
+      read by flamegraph.pl or speedscope.
+
+        writeSamples := (fileName : String) -> Boolean
+
+     */
+    static void bif_writeSamples(const CallContext& ctx);
+
     /**
       Returns the current time in milliseconds.
 
@@ -73,6 +102,14 @@ private:
      */
     static void bif_log(const CallContext& ctx);
 
+    /**
+      Aborts the execution with the given argument as error message.
+
+        panic := (str : *) -> NIL
+
+     */
+    static void bif_panic(const CallContext& ctx);
+
     /**
       Determines the type of the given argument and pushes an appropriate
       symbol on the stack.
@@ -132,6 +169,27 @@ private:
      */
     static void bif_writeArray(const CallContext& ctx);
 
+    /**
+      Returns the number of elements of the given array.
+
+        arrayLength := (array : Array) -> Integer
+
+     */
+    static void bif_arrayLength(const CallContext& ctx);
+
+    /**
+      Returns a slice of the given array which contains (at most) length
+      elements, starting at pos. If no length is given, the slice extends
+      to the end of the array. No elements are copied until either the
+      slice or the array is modified. Modifications are not visible to the
+      other one.
+
+        sliceArray := (array : Array, pos : Integer, length : Integer?)
+                      -> Array
+
+     */
+    static void bif_sliceArray(const CallContext& ctx);
+
     /**
       Compiles and executes the given file. If this file was already included
       nothing will happen.
@@ -175,13 +233,67 @@ private:
     static void bif_strlen(const CallContext& ctx);
 
     /**
-      Returns a substring of the given string.
+      Returns a substring of the given string. Unless the substring is very
+      short, it shares the characters of the given string instead of copying
+      them.
 
         substr := (str : String, pos : Integer, length : Integer) -> String
 
       */
     static void bif_substr(const CallContext& ctx);
 
+    /**
+      Returns the position of the first occurrence of subString within
+      string, starting at pos (default: 1). Returns 0 if there is none.
+
+        str::indexOf := (subString : String, string : String, pos : Integer?)
+                        -> Integer
+
+      */
+    static void bif_strIndexOf(const CallContext& ctx);
+
+    /**
+      Returns the position of the last occurrence of subString within
+      string or 0 if there is none.
+
+        str::lastIndexOf := (subString : String, string : String) -> Integer
+
+      */
+    static void bif_strLastIndexOf(const CallContext& ctx);
+
+    /**
+      Checks whether subString is contained in string.
+
+        str::contains := (subString : String, string : String) -> (TRUE|FALSE)
+
+      */
+    static void bif_strContains(const CallContext& ctx);
+
+    /**
+      Checks whether string starts with the given prefix.
+
+        str::startsWith := (prefix : String, string : String) -> (TRUE|FALSE)
+
+      */
+    static void bif_strStartsWith(const CallContext& ctx);
+
+    /**
+      Checks whether string ends with the given suffix.
+
+        str::endsWith := (suffix : String, string : String) -> (TRUE|FALSE)
+
+      */
+    static void bif_strEndsWith(const CallContext& ctx);
+
+    /**
+      Splits string at each occurrence of separator. Empty parts are
+      omitted.
+
+        str::split := (separator : String, string : String) -> List[String]
+
+      */
+    static void bif_strSplit(const CallContext& ctx);
+
     /**
       Reads the given setting
 
@@ -215,6 +327,77 @@ private:
      */
     static void bif_char(const CallContext& ctx);
 
+    /**
+      Returns the square root of the given number.
+
+        sqrt := (x : Number) -> Decimal
+
+     */
+    static void bif_sqrt(const CallContext& ctx);
+
+    /**
+      Returns the sine of the given angle (in radians).
+
+        sin := (x : Number) -> Decimal
+
+     */
+    static void bif_sin(const CallContext& ctx);
+
+    /**
+      Returns the cosine of the given angle (in radians).
+
+        cos := (x : Number) -> Decimal
+
+     */
+    static void bif_cos(const CallContext& ctx);
+
+    /**
+      Raises base to the given exponent.
+
+        pow := (base : Number, exponent : Number) -> Decimal
+
+     */
+    static void bif_pow(const CallContext& ctx);
+
+    /**
+      Rounds the given number to the nearest integer (halfway cases away
+      from zero).
+
+        round := (x : Number) -> Integer
+
+     */
+    static void bif_round(const CallContext& ctx);
+
+    /**
+      Returns the largest integer not greater than the given number.
+
+        floor := (x : Number) -> Integer
+
+     */
+    static void bif_floor(const CallContext& ctx);
+
+    /**
+      Returns the smallest integer not less than the given number.
+
+        ceil := (x : Number) -> Integer
+
+     */
+    static void bif_ceil(const CallContext& ctx);
+
+    /**
+      Fetches the argument of round, floor or ceil. If an integer is given,
+      it is directly used as result and false is returned.
+      */
+    static bool fetchDecimal(const CallContext& ctx,
+                             const char* bifName,
+                             double* value);
+
+    /**
+      Converts the result of round, floor or ceil into an integer. Values
+      which do not fit (like infinity) remain decimals.
+      */
+    static void setIntegralResult(const CallContext& ctx, double value);
+
     /**
       Fetches a QVariant from the given context.
       */
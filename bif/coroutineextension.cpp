@@ -0,0 +1,89 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+#include "coroutineextension.h"
+
+
+CoroutineExtension* CoroutineExtension::INSTANCE = new CoroutineExtension();
+
+QString CoroutineExtension::name() {
+    return QString("CoroutineExtension");
+}
+
+void CoroutineExtension::registerBuiltInFunctions(Engine* engine) {
+    engine->makeBuiltInFunction("co::spawn", bif_spawn);
+    engine->makeBuiltInFunction("co::yield", bif_yield);
+    engine->makeBuiltInFunction("co::join", bif_join);
+    engine->makeBuiltInFunction("co::channel", bif_makeChannel);
+    engine->makeBuiltInFunction("co::send", bif_send);
+    engine->makeBuiltInFunction("co::receive", bif_receive);
+}
+
+void CoroutineExtension::bif_spawn(const CallContext& ctx) {
+    Atom fn = ctx.fetchArgument(BIF_INFO);
+    ListBuilder args(ctx.storage);
+    while (ctx.hasMoreArguments()) {
+        args.append(ctx.fetchArgument(BIF_INFO));
+    }
+    ctx.setReferenceResult(CoroutineReference::make(
+                               ctx.engine->spawn(fn, args.getResult())));
+}
+
+void CoroutineExtension::bif_yield(const CallContext& ctx) {
+    ctx.engine->yield();
+}
+
+void CoroutineExtension::bif_join(const CallContext& ctx) {
+    CoroutineReference* ref = ctx.fetchRef<CoroutineReference>(BIF_INFO);
+    if (ref->coroutine->finished) {
+        ctx.setResult(ref->coroutine->result->atom());
+        return;
+    }
+    QSharedPointer<Coroutine> current = ctx.engine->getCurrentCoroutine();
+    if (ref->coroutine == current) {
+        ctx.engine->panic("A coroutine cannot join itself!");
+    }
+    // The result is passed in by resume, once the coroutine completes...
+    ref->coroutine->joiners.push_back(current);
+    ctx.engine->suspend();
+}
+
+void CoroutineExtension::bif_makeChannel(const CallContext& ctx) {
+    int capacity = 0;
+    if (ctx.hasMoreArguments()) {
+        capacity = ctx.fetchNumber(BIF_INFO);
+    }
+    if (capacity < 0) {
+        ctx.engine->panic("The capacity of a channel must not be negative!");
+    }
+    ctx.setReferenceResult(Channel::make(ctx.storage, capacity));
+}
+
+void CoroutineExtension::bif_send(const CallContext& ctx) {
+    Channel* channel = ctx.fetchRef<Channel>(BIF_INFO);
+    channel->send(ctx.engine, ctx.fetchArgument(BIF_INFO));
+}
+
+void CoroutineExtension::bif_receive(const CallContext& ctx) {
+    Channel* channel = ctx.fetchRef<Channel>(BIF_INFO);
+    Atom result = NIL;
+    // If nothing is available, the value is passed in by resume...
+    if (channel->receive(ctx.engine, &result)) {
+        ctx.setResult(result);
+    }
+}
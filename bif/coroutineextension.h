@@ -0,0 +1,104 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+#ifndef COROUTINEEXTENSION_H
+#define COROUTINEEXTENSION_H
+
+#include "engineextension.h"
+#include "callcontext.h"
+#include "vm/coroutine.h"
+
+/**
+  Provides coroutines (green threads) and channels. All coroutines run
+  within the engine which spawned them. They are switched if one waits
+  (join, send, receive), yields or has used up its slice of op codes.
+  */
+class CoroutineExtension : public EngineExtension
+{
+private:
+
+    /**
+      Starts a coroutine which applies fn to the given arguments.
+
+        co::spawn := (fn : Function, args : *...) -> Coroutine
+
+      */
+    static void bif_spawn(const CallContext& ctx);
+
+    /**
+      Lets the other runnable coroutines execute before the calling one
+      continues.
+
+        co::yield := () -> NIL
+
+      */
+    static void bif_yield(const CallContext& ctx);
+
+    /**
+      Waits until the given coroutine is completed and returns its result.
+
+        co::join := (coroutine : Coroutine) -> *
+
+      */
+    static void bif_join(const CallContext& ctx);
+
+    /**
+      Creates a channel which buffers up to capacity values (default: 0).
+
+        co::channel := (capacity : Number) -> Channel
+
+      */
+    static void bif_makeChannel(const CallContext& ctx);
+
+    /**
+      Sends a value. Waits until it is received if the channel is full.
+
+        co::send := (channel : Channel, value : *) -> NIL
+
+      */
+    static void bif_send(const CallContext& ctx);
+
+    /**
+      Receives the next value. Waits until one is sent if the channel is
+      empty.
+
+        co::receive := (channel : Channel) -> *
+
+      */
+    static void bif_receive(const CallContext& ctx);
+
+public:
+
+    /**
+      Contains the static instance of the extension. This is directly loaded
+      by the Engine.
+      */
+    static CoroutineExtension* INSTANCE;
+
+    /**
+      see: EngineExtension.name()
+      */
+    virtual QString name();
+
+    /**
+      see: EngineExtension.registerBuiltInFunctions()
+      */
+    virtual void registerBuiltInFunctions(Engine* engine);
+};
+
+#endif // COROUTINEEXTENSION_H
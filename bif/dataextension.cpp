@@ -0,0 +1,139 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+#include "dataextension.h"
+#include "filesextension.h"
+#include "vm/engine.h"
+
+#include <QFileInfo>
+
+DataExtension* DataExtension::INSTANCE = new DataExtension();
+
+QString DataExtension::name() {
+    return QString("DataExtension");
+}
+
+void DataExtension::registerBuiltInFunctions(Engine* engine) {
+    engine->makeBuiltInFunction("json::parse", bif_jsonParse);
+    engine->makeBuiltInFunction("json::write", bif_jsonWrite);
+    engine->makeBuiltInFunction("json::elements", bif_jsonElements);
+    engine->makeBuiltInFunction("csv::parse", bif_csvParse);
+    engine->makeBuiltInFunction("csv::rows", bif_csvRows);
+}
+
+bool JsonSequence::next(Storage* storage, AtomRef* value) {
+    Q_UNUSED(storage);
+    return parser.nextElement(value);
+}
+
+QString JsonSequence::getError() {
+    if (!parser.hasError()) {
+        return QString();
+    }
+    return QString("json::elements: %1: %2").arg(mapping->getPath(),
+                                                 parser.getError());
+}
+
+QString JsonSequence::toString() {
+    return QString("json(%1)").arg(QFileInfo(mapping->getPath()).fileName());
+}
+
+bool CsvSequence::next(Storage* storage, AtomRef* value) {
+    Q_UNUSED(storage);
+    return parser.nextRow(value);
+}
+
+QString CsvSequence::getError() {
+    if (!parser.hasError()) {
+        return QString();
+    }
+    return QString("csv::rows: %1: %2").arg(mapping->getPath(),
+                                            parser.getError());
+}
+
+QString CsvSequence::toString() {
+    return QString("csv(%1)").arg(QFileInfo(mapping->getPath()).fileName());
+}
+
+void DataExtension::bif_jsonParse(const CallContext& ctx) {
+    QByteArray json = ctx.fetchString(BIF_INFO).toUtf8();
+
+    JsonParser parser(ctx.storage, json.constData(), json.size());
+    AtomRef result(ctx.storage, NIL);
+    if (!parser.parse(&result)) {
+        ctx.engine->panic(QString("json::parse: %1").arg(parser.getError()));
+    }
+    ctx.setResult(result.atom());
+}
+
+void DataExtension::bif_jsonWrite(const CallContext& ctx) {
+    Atom value = ctx.fetchArgument(BIF_INFO);
+
+    JsonWriter writer(ctx.storage);
+    if (!writer.write(value)) {
+        ctx.engine->panic(QString("json::write: %1").arg(writer.getError()));
+    }
+    ctx.setStringResult(writer.getOutput());
+}
+
+void DataExtension::bif_jsonElements(const CallContext& ctx) {
+    QSharedPointer<MappedFile> file =
+            FilesExtension::mapFile(ctx, "json::elements");
+
+    ctx.setReferenceResult(JsonSequence::make(ctx.storage, file));
+}
+
+char DataExtension::fetchSeparator(const CallContext& ctx,
+                                   const char* bifName)
+{
+    if (!ctx.hasMoreArguments()) {
+        return ',';
+    }
+    QString separator = ctx.fetchString(BIF_INFO);
+    if (separator.length() != 1 || separator.at(0).unicode() > 127 ||
+            separator.at(0) == QChar('"') || separator.at(0) == QChar('\n') ||
+            separator.at(0) == QChar('\r')) {
+        ctx.engine->panic(QString("%1: Invalid separator: '%2'").
+                          arg(bifName, separator));
+    }
+    return static_cast<char>(separator.at(0).unicode());
+}
+
+void DataExtension::bif_csvParse(const CallContext& ctx) {
+    QByteArray csv = ctx.fetchString(BIF_INFO).toUtf8();
+    char separator = fetchSeparator(ctx, "csv::parse");
+
+    CsvParser parser(ctx.storage, csv.constData(), csv.size(), separator);
+    ListBuilder builder(ctx.storage);
+    AtomRef row(ctx.storage, NIL);
+    while (parser.nextRow(&row)) {
+        builder.append(row.atom());
+    }
+    if (parser.hasError()) {
+        ctx.engine->panic(QString("csv::parse: %1").arg(parser.getError()));
+    }
+    ctx.setResult(builder.getResult());
+}
+
+void DataExtension::bif_csvRows(const CallContext& ctx) {
+    QSharedPointer<MappedFile> file =
+            FilesExtension::mapFile(ctx, "csv::rows");
+    char separator = fetchSeparator(ctx, "csv::rows");
+
+    ctx.setReferenceResult(CsvSequence::make(ctx.storage, file, separator));
+}
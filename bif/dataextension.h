@@ -0,0 +1,167 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+#ifndef DATAEXTENSION_H
+#define DATAEXTENSION_H
+
+#include "engineextension.h"
+#include "callcontext.h"
+#include "vm/sequence.h"
+#include "vm/mappedfile.h"
+#include "vm/jsonparser.h"
+#include "vm/csvparser.h"
+
+#include <QSharedPointer>
+
+/**
+  A Sequence of the elements of a top level JSON array (or of the values of
+  a JSON lines file). The file is memory mapped and each element is parsed
+  once it is requested.
+  */
+class JsonSequence : public Sequence {
+private:
+    QSharedPointer<MappedFile> mapping;
+    JsonParser parser;
+    JsonSequence(Storage* storage, const QSharedPointer<MappedFile>& mapping) :
+        mapping(mapping),
+        parser(storage, mapping->data(), mapping->size()) {}
+public:
+    static Reference* make(Storage* storage,
+                           const QSharedPointer<MappedFile>& mapping) {
+        return new JsonSequence(storage, mapping);
+    }
+
+    virtual bool next(Storage* storage, AtomRef* value);
+
+    virtual QString getError();
+
+    virtual QString toString();
+};
+
+/**
+  A Sequence of the rows of a memory mapped CSV file. Each row is parsed
+  once it is requested.
+  */
+class CsvSequence : public Sequence {
+private:
+    QSharedPointer<MappedFile> mapping;
+    CsvParser parser;
+    CsvSequence(Storage* storage,
+                const QSharedPointer<MappedFile>& mapping,
+                char separator) :
+        mapping(mapping),
+        parser(storage, mapping->data(), mapping->size(), separator) {}
+public:
+    static Reference* make(Storage* storage,
+                           const QSharedPointer<MappedFile>& mapping,
+                           char separator) {
+        return new CsvSequence(storage, mapping, separator);
+    }
+
+    virtual bool next(Storage* storage, AtomRef* value);
+
+    virtual QString getError();
+
+    virtual QString toString();
+};
+
+/**
+  Provides functions to read and write JSON and CSV.
+
+  A JSON object becomes a list of (key value) pairs, where each key is a
+  symbol. Arrays become lists, integers numbers and all other numbers
+  decimals. true and false become #TRUE and #FALSE, null becomes #NULL. As
+  the empty list is NIL, both [] and {} become NIL, which is written as [].
+  A CSV row becomes a list of strings.
+  */
+class DataExtension : public EngineExtension
+{
+private:
+
+    /**
+      Parses the given JSON string:
+
+        json::parse := (json : String) -> *
+
+      */
+    static void bif_jsonParse(const CallContext& ctx);
+
+    /**
+      Converts the given value into JSON. Lists of (symbol value) pairs are
+      written as objects, all other lists and arrays as arrays. NIL is
+      written as [] and #NULL as null:
+
+        json::write := (value : *) -> String
+
+      */
+    static void bif_jsonWrite(const CallContext& ctx);
+
+    /**
+      Returns a sequence of the elements of the top level array of the given
+      JSON file. If the file does not contain an array, its values (e.g.
+      one per line) are returned. Only one element is in memory at a time:
+
+        json::elements := (file : (FileInfo|String)) -> JsonSequence
+
+      */
+    static void bif_jsonElements(const CallContext& ctx);
+
+    /**
+      Parses the given CSV string into a list of rows. The separator
+      defaults to ",":
+
+        csv::parse := (csv : String, separator : String?) -> List[List[String]]
+
+      */
+    static void bif_csvParse(const CallContext& ctx);
+
+    /**
+      Returns a sequence of the rows of the given CSV file. Only one row is
+      in memory at a time:
+
+        csv::rows := (file : (FileInfo|String), separator : String?)
+                     -> CsvSequence
+
+      */
+    static void bif_csvRows(const CallContext& ctx);
+
+    /**
+      Fetches the optional separator, which must be a single ASCII character.
+      */
+    static char fetchSeparator(const CallContext& ctx, const char* bifName);
+
+public:
+
+    /**
+      Contains the static instance of the extension. This is directly loaded
+      by the Engine.
+      */
+    static DataExtension* INSTANCE;
+
+    /**
+      see: EngineExtension.name()
+      */
+    virtual QString name();
+
+    /**
+      see: EngineExtension.registerBuiltInFunctions()
+      */
+    virtual void registerBuiltInFunctions(Engine* engine);
+};
+
+#endif // DATAEXTENSION_H
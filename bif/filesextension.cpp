@@ -1,4 +1,16 @@
 #include "filesextension.h"
+#include "vm/asyncoperation.h"
+#include "vm/isolatepool.h"
+
+#include <QAtomicInt>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QRegExp>
+
+#include <climits>
+#include <deque>
 
 
 FilesExtension* FilesExtension::INSTANCE = new FilesExtension();
@@ -21,10 +33,20 @@ void FilesExtension::registerBuiltInFunctions(Engine* engine) {
     engine->makeBuiltInFunction("fs::mkDir", bif_mkDir);
     engine->makeBuiltInFunction("fs::delete", bif_deleteFile);
     engine->makeBuiltInFunction("fs::move", bif_moveFile);
+    engine->makeBuiltInFunction("fs::readAsync", bif_readAsync);
+    engine->makeBuiltInFunction("fs::writeAsync", bif_writeAsync);
+    engine->makeBuiltInFunction("fs::map", bif_map);
+    engine->makeBuiltInFunction("fs::readAll", bif_readAll);
+    engine->makeBuiltInFunction("fs::viewLength", bif_viewLength);
+    engine->makeBuiltInFunction("fs::viewPart", bif_viewPart);
+    engine->makeBuiltInFunction("fs::viewFind", bif_viewFind);
+    engine->makeBuiltInFunction("fs::viewDecode", bif_viewDecode);
+    engine->makeBuiltInFunction("fs::viewByte", bif_viewByte);
+    engine->makeBuiltInFunction("fs::lines", bif_lines);
+    engine->makeBuiltInFunction("fs::walk", bif_walk);
 
     // listFiles isFile isDirectory exists file(forString), directory(forString)
-    // cdUp read readall readLine eof write write line openFile closeFile
-    // fileClosed mkDir
+    // cdUp write line openFile closeFile fileClosed
 }
 
 void FilesExtension::bif_getFile(const CallContext& ctx) {
@@ -123,3 +145,475 @@ void FilesExtension::bif_moveFile(const CallContext& ctx) {
 
     ctx.setResult(input);
 }
+
+/**
+  Reads a whole file for fs::readAsync.
+  */
+class ReadOperation : public AsyncOperation {
+private:
+    QString path;
+    QString contents;
+    QString error;
+public:
+    ReadOperation(const QString& path) : path(path) {}
+
+    virtual void perform() {
+        MappedFile file(path);
+        if (!file.isValid()) {
+            error = file.getError();
+            return;
+        }
+        if (file.size() > INT_MAX) {
+            error = QString("%1 is too large for a string!").arg(path);
+            return;
+        }
+        contents = file.decode(0, file.size());
+    }
+
+    virtual Atom makeArguments(Storage* storage) {
+        if (!error.isEmpty()) {
+            AtomRef message(storage, storage->makeString(error));
+            return storage->makeCons(NIL,
+                                     storage->makeCons(message.atom(), NIL));
+        }
+        return storage->makeCons(storage->makeString(contents), NIL);
+    }
+};
+
+/**
+  Writes a whole file for fs::writeAsync.
+  */
+class WriteOperation : public AsyncOperation {
+private:
+    QString path;
+    QString contents;
+    QString error;
+public:
+    WriteOperation(const QString& path, const QString& contents) :
+        path(path), contents(contents) {}
+
+    virtual void perform() {
+        QFile file(path);
+        if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+            error = QString("Cannot open %1: %2").arg(path, file.errorString());
+            return;
+        }
+        QByteArray data = contents.toUtf8();
+        if (file.write(data) != data.size()) {
+            error = QString("Cannot write %1: %2").arg(path,
+                                                       file.errorString());
+        }
+    }
+
+    virtual Atom makeArguments(Storage* storage) {
+        if (!error.isEmpty()) {
+            AtomRef message(storage, storage->makeString(error));
+            return storage->makeCons(SYMBOL_FALSE,
+                                     storage->makeCons(message.atom(), NIL));
+        }
+        return storage->makeCons(SYMBOL_TRUE, NIL);
+    }
+};
+
+QString FilesExtension::fetchPath(const CallContext& ctx,
+                                  const char* bifName)
+{
+    Atom file = ctx.fetchArgument(BIF_INFO);
+    if (isString(file)) {
+        return ctx.storage->getString(file);
+    }
+    FileInfoReference* ref = NULL;
+    if (isReference(file)) {
+        ref = dynamic_cast<FileInfoReference*>(
+                    ctx.storage->getReference(file));
+    }
+    if (ref == NULL) {
+        ctx.engine->panic(QString("The 1. argument of %1 must be a FileInfo or a string!").
+                          arg(bifName));
+    }
+    return ref->info.absoluteFilePath();
+}
+
+/**
+  Generates a panic if an async BIF is called by an isolate. An isolate only
+  runs until its task is completed, therefore no continuation would ever be
+  executed.
+  */
+static void expectContinuations(const CallContext& ctx, const char* bifName) {
+    if (IsolatePool::isWorkerThread()) {
+        ctx.engine->panic(QString("%1 cannot be used within a parallel task!").
+                          arg(bifName));
+    }
+}
+
+void FilesExtension::bif_readAsync(const CallContext& ctx) {
+    expectContinuations(ctx, "fs::readAsync");
+    QString path = fetchPath(ctx, "fs::readAsync");
+    Atom continuation = ctx.fetchArgument(BIF_INFO);
+
+    ctx.engine->runAsync(new ReadOperation(path), continuation);
+}
+
+void FilesExtension::bif_writeAsync(const CallContext& ctx) {
+    expectContinuations(ctx, "fs::writeAsync");
+    QString path = fetchPath(ctx, "fs::writeAsync");
+    QString contents = ctx.fetchString(BIF_INFO);
+    Atom continuation = ctx.fetchArgument(BIF_INFO);
+
+    ctx.engine->runAsync(new WriteOperation(path, contents), continuation);
+}
+
+QSharedPointer<MappedFile> FilesExtension::mapFile(const CallContext& ctx,
+                                                   const char* bifName)
+{
+    QSharedPointer<MappedFile> file(new MappedFile(fetchPath(ctx, bifName)));
+    if (!file->isValid()) {
+        ctx.engine->panic(QString("%1: %2").arg(bifName, file->getError()));
+    }
+    return file;
+}
+
+void FilesExtension::bif_map(const CallContext& ctx) {
+    QSharedPointer<MappedFile> file = mapFile(ctx, "fs::map");
+
+    ctx.setReferenceResult(ByteViewReference::make(file, 0, file->size()));
+}
+
+void FilesExtension::bif_readAll(const CallContext& ctx) {
+    QSharedPointer<MappedFile> file = mapFile(ctx, "fs::readAll");
+    if (file->size() > INT_MAX) {
+        ctx.engine->panic(QString("fs::readAll: %1 is too large for a string!").
+                          arg(file->getPath()));
+    }
+
+    ctx.setStringResult(file->decode(0, file->size()));
+}
+
+void FilesExtension::bif_viewLength(const CallContext& ctx) {
+    ByteViewReference* view = ctx.fetchRef<ByteViewReference>(BIF_INFO);
+
+    ctx.setResult(ctx.storage->makeNumber(view->length));
+}
+
+void FilesExtension::fetchRange(const CallContext& ctx,
+                                ByteViewReference* view,
+                                qint64* offset,
+                                qint64* length)
+{
+    qint64 pos = ctx.fetchLong(BIF_INFO);
+    pos = qMax(qMin(pos - 1, view->length), (qint64) 0);
+    *length = qMin(static_cast<qint64>(ctx.fetchLong(BIF_INFO)),
+                   view->length - pos);
+    *length = qMax(*length, (qint64) 0);
+    *offset = view->offset + pos;
+}
+
+void FilesExtension::bif_viewPart(const CallContext& ctx) {
+    ByteViewReference* view = ctx.fetchRef<ByteViewReference>(BIF_INFO);
+    qint64 offset;
+    qint64 length;
+    fetchRange(ctx, view, &offset, &length);
+
+    ctx.setReferenceResult(ByteViewReference::make(view->file,
+                                                   offset,
+                                                   length));
+}
+
+void FilesExtension::bif_viewFind(const CallContext& ctx) {
+    ByteViewReference* view = ctx.fetchRef<ByteViewReference>(BIF_INFO);
+    QByteArray needle = ctx.fetchString(BIF_INFO).toUtf8();
+    qint64 pos = 1;
+    if (ctx.hasMoreArguments()) {
+        pos = qMax(static_cast<qint64>(ctx.fetchLong(BIF_INFO)), (qint64) 1);
+    }
+    if (pos - 1 > view->length) {
+        ctx.setNumberResult(0);
+        return;
+    }
+
+    qint64 index = view->file->indexOf(needle,
+                                       view->offset + pos - 1,
+                                       view->offset + view->length);
+    ctx.setResult(ctx.storage->makeNumber(index < 0 ?
+                                              0 :
+                                              index - view->offset + 1));
+}
+
+void FilesExtension::bif_viewDecode(const CallContext& ctx) {
+    ByteViewReference* view = ctx.fetchRef<ByteViewReference>(BIF_INFO);
+    qint64 offset = view->offset;
+    qint64 length = view->length;
+    if (ctx.hasMoreArguments()) {
+        fetchRange(ctx, view, &offset, &length);
+    }
+    if (length > INT_MAX) {
+        ctx.engine->panic(QString("fs::viewDecode: %1 is too large for a string!").
+                          arg(view->toString()));
+    }
+
+    ctx.setStringResult(view->file->decode(offset, length));
+}
+
+void FilesExtension::bif_viewByte(const CallContext& ctx) {
+    ByteViewReference* view = ctx.fetchRef<ByteViewReference>(BIF_INFO);
+    qint64 pos = ctx.fetchLong(BIF_INFO);
+    if (pos < 1 || pos > view->length) {
+        ctx.engine->panic(QString("fs::viewByte: %1 is outside of %2!").
+                          arg(QString::number(pos), view->toString()));
+    }
+
+    const uchar* bytes = reinterpret_cast<const uchar*>(view->file->data());
+    ctx.setNumberResult(bytes[view->offset + pos - 1]);
+}
+
+void LineSequence::close() {
+    mapping.clear();
+    delete file;
+    file = NULL;
+}
+
+/**
+  Removes a trailing line feed and carriage return.
+  */
+static qint64 trimLineEnd(const char* line, qint64 length) {
+    if (length > 0 && line[length - 1] == '\n') {
+        length--;
+    }
+    if (length > 0 && line[length - 1] == '\r') {
+        length--;
+    }
+    return length;
+}
+
+bool LineSequence::next(Storage* storage, AtomRef* value) {
+    if (!mapping.isNull()) {
+        if (position >= mapping->size()) {
+            close();
+            return false;
+        }
+        qint64 end = mapping->indexOf(QByteArray("\n"),
+                                      position,
+                                      mapping->size());
+        end = end < 0 ? mapping->size() : end + 1;
+        qint64 length = trimLineEnd(mapping->data() + position,
+                                    end - position);
+        value->atom(storage->makeString(mapping->decode(position, length)));
+        position = end;
+        return true;
+    }
+    if (file == NULL) {
+        return false;
+    }
+    QByteArray line = file->readLine();
+    if (line.isEmpty()) {
+        close();
+        return false;
+    }
+    value->atom(storage->makeString(
+                    QString::fromUtf8(line.constData(),
+                                      trimLineEnd(line.constData(),
+                                                  line.size()))));
+    return true;
+}
+
+void FilesExtension::bif_lines(const CallContext& ctx) {
+    QString path = fetchPath(ctx, "fs::lines");
+
+    if (QFileInfo(path).isFile()) {
+        QSharedPointer<MappedFile> mapping(new MappedFile(path));
+        if (mapping->isValid()) {
+            ctx.setReferenceResult(LineSequence::make(mapping));
+            return;
+        }
+    }
+    // Pipes and devices cannot be mapped. The same holds for files which
+    // exceed the address space. These are read via QFile, which buffers
+    // its input...
+    QFile* file = new QFile(path);
+    if (!file->open(QFile::ReadOnly)) {
+        QString error = file->errorString();
+        delete file;
+        ctx.engine->panic(QString("fs::lines: Cannot open %1: %2").
+                          arg(path, error));
+    }
+    ctx.setReferenceResult(LineSequence::make(file));
+}
+
+/**
+  Collects the results of the directory scans of a WalkSequence.
+  */
+class WalkJob {
+private:
+    QMutex lock;
+    QWaitCondition available;
+    std::deque<QStringList> batches;
+
+    /**
+      Contains the number of directories which are not yet scanned.
+      */
+    int pendingDirectories;
+
+    QAtomicInt cancelled;
+
+    Q_DISABLE_COPY(WalkJob)
+public:
+    const QString root;
+    const QString glob;
+    const int maxDepth;
+
+    WalkJob(const QString& root, const QString& glob, int maxDepth) :
+        pendingDirectories(0),
+        cancelled(false),
+        root(root),
+        glob(glob),
+        maxDepth(maxDepth) {}
+
+    /**
+      Schedules a scan of the given directory.
+      */
+    static void scan(const QSharedPointer<WalkJob>& job,
+                     const QString& path,
+                     int depth);
+
+    void addBatch(const QStringList& batch) {
+        QMutexLocker locker(&lock);
+        batches.push_back(batch);
+        available.wakeAll();
+    }
+
+    void directoryDone() {
+        QMutexLocker locker(&lock);
+        pendingDirectories--;
+        available.wakeAll();
+    }
+
+    /**
+      Waits for the next batch of paths. Returns false once all
+      directories are scanned and all batches are taken.
+      */
+    bool takeBatch(QStringList* batch) {
+        QMutexLocker locker(&lock);
+        while (batches.empty() && pendingDirectories > 0) {
+            available.wait(&lock);
+        }
+        if (batches.empty()) {
+            return false;
+        }
+        *batch = batches.front();
+        batches.pop_front();
+        return true;
+    }
+
+    void cancel() {
+        cancelled.fetchAndStoreOrdered(true);
+    }
+
+    bool isCancelled() {
+        return cancelled;
+    }
+};
+
+/**
+  Scans one directory of a WalkJob and schedules a scan for each of its
+  sub directories.
+  */
+class DirectoryScan : public QRunnable {
+private:
+    QSharedPointer<WalkJob> job;
+    QString path;
+    int depth;
+public:
+    DirectoryScan(const QSharedPointer<WalkJob>& job,
+                  const QString& path,
+                  int depth) : job(job), path(path), depth(depth) {}
+
+    virtual void run() {
+        if (!job->isCancelled()) {
+            scanDirectory();
+        }
+        job->directoryDone();
+    }
+
+    void scanDirectory() {
+        // Each scan uses its own QRegExp, as matching modifies it...
+        QRegExp filter(job->glob, Qt::CaseSensitive, QRegExp::Wildcard);
+        bool descend = job->maxDepth <= 0 || depth < job->maxDepth;
+        // Listing the directory stats all entries. As this is done by
+        // several threads at once, this is the part we parallelize...
+        QFileInfoList entries = QDir(path).entryInfoList(
+                    QDir::AllEntries |
+                    QDir::NoDotAndDotDot |
+                    QDir::Hidden |
+                    QDir::System);
+        QStringList batch;
+        foreach (QFileInfo entry, entries) {
+            QString entryPath = entry.absoluteFilePath();
+            if (descend && entry.isDir() && !entry.isSymLink()) {
+                WalkJob::scan(job, entryPath, depth + 1);
+            }
+            if (job->glob.isEmpty() || filter.exactMatch(entry.fileName())) {
+                batch << entryPath;
+                if (batch.size() >= (int) TUNING_PARAM_WALK_BATCH_SIZE) {
+                    job->addBatch(batch);
+                    batch.clear();
+                }
+            }
+        }
+        if (!batch.isEmpty()) {
+            job->addBatch(batch);
+        }
+    }
+};
+
+void WalkJob::scan(const QSharedPointer<WalkJob>& job,
+                   const QString& path,
+                   int depth)
+{
+    {
+        QMutexLocker locker(&job->lock);
+        job->pendingDirectories++;
+    }
+    QThreadPool::globalInstance()->start(new DirectoryScan(job, path, depth));
+}
+
+bool WalkSequence::next(Storage* storage, AtomRef* value) {
+    if (index >= batch.size()) {
+        batch.clear();
+        index = 0;
+        if (!job->takeBatch(&batch)) {
+            return false;
+        }
+    }
+    value->atom(storage->makeString(batch.at(index++)));
+    return true;
+}
+
+QString WalkSequence::toString() {
+    return QString("walk(%1)").arg(job->root);
+}
+
+WalkSequence::~WalkSequence() {
+    // Pending scans hold their own pointer to the job and will skip their
+    // directories...
+    job->cancel();
+}
+
+void FilesExtension::bif_walk(const CallContext& ctx) {
+    QString path = fetchPath(ctx, "fs::walk");
+    QString glob;
+    if (ctx.hasMoreArguments()) {
+        glob = ctx.fetchString(BIF_INFO);
+    }
+    int maxDepth = 0;
+    if (ctx.hasMoreArguments()) {
+        maxDepth = ctx.fetchNumber(BIF_INFO);
+    }
+
+    if (!QFileInfo(path).isDir()) {
+        ctx.engine->panic(QString("fs::walk: %1 is not a directory!").
+                          arg(path));
+    }
+    QSharedPointer<WalkJob> job(new WalkJob(path, glob, maxDepth));
+    WalkJob::scan(job, QFileInfo(path).absoluteFilePath(), 1);
+    ctx.setReferenceResult(WalkSequence::make(job));
+}
@@ -3,11 +3,15 @@
 
 #include "engineextension.h"
 #include "vm/reference.h"
+#include "vm/mappedfile.h"
+#include "vm/sequence.h"
 #include "callcontext.h"
 
 #include <QFile>
 #include <QDir>
 #include <QFileInfo>
+#include <QSharedPointer>
+#include <QStringList>
 
 class FileReference : public Reference {
 private:
@@ -45,6 +49,102 @@ public:
     friend class FilesExtension;
 };
 
+/**
+  A read-only range of a memory mapped file. Slices share the mapping,
+  which is released once the last view is collected.
+  */
+class ByteViewReference : public Reference {
+private:
+    QSharedPointer<MappedFile> file;
+    qint64 offset;
+    qint64 length;
+    ByteViewReference(const QSharedPointer<MappedFile>& file,
+                      qint64 offset,
+                      qint64 length) :
+        file(file), offset(offset), length(length) {}
+public:
+    static Reference* make(const QSharedPointer<MappedFile>& file,
+                           qint64 offset,
+                           qint64 length) {
+        return new ByteViewReference(file, offset, length);
+    }
+
+    virtual QString toString() {
+        return QString("%1[%2..%3]").arg(QFileInfo(file->getPath()).fileName(),
+                                         QString::number(offset + 1),
+                                         QString::number(offset + length));
+    }
+
+    friend class FilesExtension;
+};
+
+/**
+  A Sequence which reads a text file (UTF-8) line by line. Regular files are
+  memory mapped, others (like pipes) are read via a buffered QFile. Only the
+  current line is ever decoded, so that a file of any size can be processed
+  in constant memory. The file is released once the last line was read.
+  */
+class LineSequence : public Sequence {
+private:
+    QString path;
+    QSharedPointer<MappedFile> mapping;
+    QFile* file;
+    qint64 position;
+    LineSequence(const QString& path,
+                 const QSharedPointer<MappedFile>& mapping,
+                 QFile* file) :
+        path(path), mapping(mapping), file(file), position(0) {}
+
+    void close();
+public:
+    static Reference* make(const QSharedPointer<MappedFile>& mapping) {
+        return new LineSequence(mapping->getPath(), mapping, NULL);
+    }
+
+    static Reference* make(QFile* file) {
+        return new LineSequence(file->fileName(),
+                                QSharedPointer<MappedFile>(),
+                                file);
+    }
+
+    virtual bool next(Storage* storage, AtomRef* value);
+
+    virtual QString toString() {
+        return QString("lines(%1)").arg(QFileInfo(path).fileName());
+    }
+
+    virtual ~LineSequence() {
+        close();
+    }
+};
+
+class WalkJob;
+
+/**
+  A Sequence of the paths of all files and directories below a directory.
+  The directories are scanned in parallel by the threads of the global
+  QThreadPool. Their results are passed to the sequence in batches, so
+  that the engine can consume the first paths while the rest of the tree
+  is still being scanned. Scanning stops, once the sequence is collected.
+  */
+class WalkSequence : public Sequence {
+private:
+    QSharedPointer<WalkJob> job;
+    QStringList batch;
+    int index;
+    WalkSequence(const QSharedPointer<WalkJob>& job) : job(job), index(0) {}
+public:
+    static Reference* make(const QSharedPointer<WalkJob>& job) {
+        return new WalkSequence(job);
+    }
+
+    virtual bool next(Storage* storage, AtomRef* value);
+
+    virtual QString toString();
+
+    virtual ~WalkSequence();
+};
+
 class FilesExtension : public EngineExtension
 {
     /**
@@ -148,9 +248,132 @@ class FilesExtension : public EngineExtension
       */
     static void bif_moveFile(const CallContext& ctx);
 
+    /**
+      Reads the whole given file (UTF-8) in the background. Once this is
+      completed, the continuation is called with the contents as single
+      argument. If the file cannot be read, NIL and the error message are
+      passed instead. Returns immediately:
+
+        readAsync := (file : (FileInfo|String),
+                      continuation : ((String|NIL), String?) -> _) -> NIL
+
+      */
+    static void bif_readAsync(const CallContext& ctx);
+
+    /**
+      Writes the given string (UTF-8) into the given file in the background.
+      An existing file is overwritten. Once this is completed, the
+      continuation is called with TRUE or with FALSE and the error message.
+      Returns immediately:
+
+        writeAsync := (file : (FileInfo|String),
+                       contents : String,
+                       continuation : ((TRUE|FALSE), String?) -> _) -> NIL
+
+      */
+    static void bif_writeAsync(const CallContext& ctx);
+
+    /**
+      Maps the given file into memory and returns a view of all of its
+      bytes. The file is not read into the heap. Pages are loaded by the
+      operating system as they are accessed:
+
+        map := (file : (FileInfo|String)) -> ByteView
+
+      */
+    static void bif_map(const CallContext& ctx);
+
+    /**
+      Reads the whole given file (UTF-8) into a string. This uses the
+      memory mapping, so that the contents are only decoded once:
 
-    // readall readLine eof write write line openFile closeFile
-    // fileClosed
+        readAll := (file : (FileInfo|String)) -> String
+
+      */
+    static void bif_readAll(const CallContext& ctx);
+
+    /**
+      Returns the number of bytes of the given view:
+
+        viewLength := (view : ByteView) -> Number
+
+      */
+    static void bif_viewLength(const CallContext& ctx);
+
+    /**
+      Returns a view of the given range, like strPart. The first byte is at
+      position 1. The range is limited to the given view. No bytes are
+      copied:
+
+        viewPart := (view : ByteView, pos : Number, length : Number)
+                    -> ByteView
+
+      */
+    static void bif_viewPart(const CallContext& ctx);
+
+    /**
+      Returns the position of the first occurrence of the given string
+      (UTF-8) at or after pos (default: 1) or 0 if there is none:
+
+        viewFind := (view : ByteView, needle : String, pos : Number?)
+                    -> Number
+
+      */
+    static void bif_viewFind(const CallContext& ctx);
+
+    /**
+      Decodes the given view (UTF-8) into a string. If pos and length are
+      given, only this range of the view is decoded:
+
+        viewDecode := (view : ByteView, pos : Number?, length : Number?)
+                      -> String
+
+      */
+    static void bif_viewDecode(const CallContext& ctx);
+
+    /**
+      Returns the byte (0..255) at the given position of the view:
+
+        viewByte := (view : ByteView, pos : Number) -> Number
+
+      */
+    static void bif_viewByte(const CallContext& ctx);
+
+    /**
+      Returns a sequence of the lines (without line terminators) of the
+      given text file (UTF-8). It can be consumed by each:do:,
+      fold:with:start: or any other function which destructures lists.
+      Reading is lazy, only one line is in memory at a time:
+
+        lines := (file : (FileInfo|String)) -> LineSequence
+
+      */
+    static void bif_lines(const CallContext& ctx);
+
+    /**
+      Returns a sequence of the absolute paths of all files and directories
+      below the given directory, in no particular order. If a glob (like
+      "*.pi") is given, only paths whose file name matches are returned.
+      If maxDepth is positive, only this many levels are scanned (1 returns
+      only the direct children). Symbolic links to directories are not
+      followed:
+
+        walk := (dir : (FileInfo|String), glob : String?, maxDepth : Number?)
+                -> WalkSequence
+
+      */
+    static void bif_walk(const CallContext& ctx);
+
+    /**
+      Fetches a pos and length argument and limits them to the given view.
+      On return, offset is the index of the first byte within the mapping.
+      */
+    static void fetchRange(const CallContext& ctx,
+                           ByteViewReference* view,
+                           qint64* offset,
+                           qint64* length);
+
+    // write line openFile closeFile fileClosed
 public:
 
     /**
@@ -168,6 +391,18 @@ public:
       see: EngineExtension.registerBuiltInFunctions()
       */
     virtual void registerBuiltInFunctions(Engine* engine);
+
+    /**
+      Fetches the path of a file which is given either as FileInfo or as
+      string.
+      */
+    static QString fetchPath(const CallContext& ctx, const char* bifName);
+
+    /**
+      Maps the given file or generates a panic if this fails.
+      */
+    static QSharedPointer<MappedFile> mapFile(const CallContext& ctx,
+                                              const char* bifName);
 };
 
 #endif // FILESEXTENSION_H
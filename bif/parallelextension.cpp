@@ -0,0 +1,465 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+#include "parallelextension.h"
+#include "vm/copier.h"
+#include "vm/isolatepool.h"
+
+#include <QMutexLocker>
+#include <QThreadStorage>
+
+/**
+  Contains the copy of the function of a job within the isolate of a worker
+  thread.
+  */
+class ImportedFunction
+{
+private:
+    Q_DISABLE_COPY(ImportedFunction)
+public:
+    /**
+      Contains the id of the job which the copy belongs to.
+      */
+    const int job;
+
+    AtomRef* const fn;
+
+    ImportedFunction(Storage* local, int job) :
+        job(job), fn(local->ref(NIL)) {}
+
+    ~ImportedFunction() {
+        delete fn;
+    }
+};
+
+/**
+  Contains the imported function of the last job executed by each worker.
+  As a deep copy of a function includes all globals it refers to, it is
+  only made once per worker and job instead of once per chunk. The copy is
+  kept (and its memory retained by the isolate) until the worker executes
+  a task of another job.
+  */
+static QThreadStorage<ImportedFunction*> importedFunctions;
+
+/**
+  Provides a unique id for each ParallelJob, as jobs are created on the
+  stack and therefore their addresses get reused.
+  */
+static QAtomicInt nextJobId;
+
+/**
+  Contains the state shared by the tasks of one call of a parallel BIF.
+  As the tasks run concurrently, each access to the storage of the caller
+  is guarded by lock.
+  */
+class ParallelJob
+{
+private:
+    QMutex lock;
+    bool failed;
+    QString error;
+
+    Q_DISABLE_COPY(ParallelJob)
+public:
+    /**
+      Contains the id used to recognize the ImportedFunction of this job.
+      */
+    const int id;
+
+    /**
+      Contains the storage of the calling engine.
+      */
+    Storage* const storage;
+
+    /**
+      Contains the function to apply and the start value of a reduction.
+      */
+    const Atom fn;
+    const Atom start;
+
+    /**
+      Contains the elements of the collection.
+      */
+    const std::vector<Atom> elements;
+
+    /**
+      Contains an array which receives the results of the tasks.
+      */
+    AtomRef* const results;
+
+    ParallelJob(Storage* storage,
+                Atom fn,
+                Atom start,
+                const std::vector<Atom>& elements,
+                Word numResults) :
+        failed(false),
+        id(nextJobId.fetchAndAddOrdered(1)),
+        storage(storage),
+        fn(fn),
+        start(start),
+        elements(elements),
+        results(storage->ref(storage->makeArray(numResults))) {}
+
+    ~ParallelJob() {
+        delete results;
+    }
+
+    /**
+      Returns the copy of fn within the given storage of an isolate. This is
+      only copied by the first task of this job which runs on the calling
+      worker thread. Returns NULL if the copy failed.
+      */
+    ImportedFunction* importFunction(Storage* local) {
+        ImportedFunction* imported = importedFunctions.localData();
+        if (imported != NULL && imported->job == id) {
+            return imported;
+        }
+        imported = new ImportedFunction(local, id);
+        importedFunctions.setLocalData(imported);
+        QMutexLocker locker(&lock);
+        Copier copier(storage, local);
+        if (!copier.copy(fn, imported->fn)) {
+            failed = true;
+            error = copier.getError();
+            importedFunctions.setLocalData(NULL);
+            return NULL;
+        }
+        return imported;
+    }
+
+    /**
+      Copies start and the elements from (inclusive) to (exclusive) into the
+      given storage of an isolate. The elements are stored in the given
+      array. As fn might modify the start value, each chunk gets its own
+      copy of it.
+      */
+    bool importValues(Storage* local,
+                      AtomRef* localStart,
+                      Word from,
+                      Word to,
+                      Atom values)
+    {
+        QMutexLocker locker(&lock);
+        Copier copier(storage, local);
+        if (!copier.copy(start, localStart)) {
+            failed = true;
+            error = copier.getError();
+            return false;
+        }
+        AtomRef value(local, NIL);
+        for(Word i = from; i < to; i++) {
+            if (!copier.copy(elements[i], &value)) {
+                failed = true;
+                error = copier.getError();
+                return false;
+            }
+            Array* array = local->getArray(values);
+            array->put(i - from + 1, value.atom());
+        }
+        return true;
+    }
+
+    /**
+      Copies the values of the given array of an isolate into the results,
+      starting at the given position.
+      */
+    bool exportValues(Storage* local, Atom values, Word position) {
+        QMutexLocker locker(&lock);
+        Copier copier(local, storage);
+        AtomRef value(storage, NIL);
+        Word count = local->getArray(values)->length();
+        for(Word i = 1; i <= count; i++) {
+            if (!copier.copy(local->getArray(values)->at(i), &value)) {
+                failed = true;
+                error = copier.getError();
+                return false;
+            }
+            Array* array = storage->getArray(results->atom());
+            array->put(position + i, value.atom());
+        }
+        return true;
+    }
+
+    /**
+      Reports a panic within an isolate. The other tasks skip their work.
+      */
+    void fail(const QString& message) {
+        QMutexLocker locker(&lock);
+        if (!failed) {
+            failed = true;
+            error = message;
+        }
+    }
+
+    bool hasFailed() {
+        QMutexLocker locker(&lock);
+        return failed;
+    }
+
+    QString getError() {
+        QMutexLocker locker(&lock);
+        return error;
+    }
+};
+
+/**
+  Applies fn to each element of a chunk.
+  */
+class MapTask : public IsolateTask
+{
+private:
+    ParallelJob* job;
+    Word from;
+    Word to;
+public:
+    MapTask(ParallelJob* job, Word from, Word to) :
+        job(job), from(from), to(to) {}
+
+    virtual void run(Engine* isolate) {
+        if (job->hasFailed()) {
+            return;
+        }
+        Storage* local = isolate->getStorage();
+        ImportedFunction* imported = job->importFunction(local);
+        if (imported == NULL) {
+            return;
+        }
+        AtomRef start(local, NIL);
+        AtomRef values(local, local->makeArray(to - from));
+        if (!job->importValues(local, &start, from, to, values.atom())) {
+            return;
+        }
+        AtomRef result(local, NIL);
+        for(Word i = 1; i <= to - from; i++) {
+            Atom args = local->makeCons(local->getArray(values.atom())->at(i),
+                                        NIL);
+            if (!isolate->call(imported->fn->atom(), args, &result)) {
+                job->fail(isolate->getLastError());
+                return;
+            }
+            Array* array = local->getArray(values.atom());
+            array->put(i, result.atom());
+        }
+        job->exportValues(local, values.atom(), from);
+    }
+};
+
+/**
+  Folds the elements of a chunk. The result is stored at the given index
+  of the results.
+  */
+class ReduceTask : public IsolateTask
+{
+private:
+    ParallelJob* job;
+    Word from;
+    Word to;
+    Word index;
+public:
+    ReduceTask(ParallelJob* job, Word from, Word to, Word index) :
+        job(job), from(from), to(to), index(index) {}
+
+    virtual void run(Engine* isolate) {
+        if (job->hasFailed()) {
+            return;
+        }
+        Storage* local = isolate->getStorage();
+        ImportedFunction* imported = job->importFunction(local);
+        if (imported == NULL) {
+            return;
+        }
+        AtomRef sum(local, NIL);
+        AtomRef values(local, local->makeArray(to - from));
+        if (!job->importValues(local, &sum, from, to, values.atom())) {
+            return;
+        }
+        AtomRef args(local, NIL);
+        for(Word i = 1; i <= to - from; i++) {
+            args.atom(local->makeCons(sum.atom(), NIL));
+            args.atom(local->makeCons(local->getArray(values.atom())->at(i),
+                                      args.atom()));
+            if (!isolate->call(imported->fn->atom(), args.atom(), &sum)) {
+                job->fail(isolate->getLastError());
+                return;
+            }
+        }
+        AtomRef result(local, local->makeArray(1));
+        local->getArray(result.atom())->put(1, sum.atom());
+        job->exportValues(local, result.atom(), index);
+    }
+};
+
+ParallelExtension* ParallelExtension::INSTANCE = new ParallelExtension();
+
+QString ParallelExtension::name() {
+    return QString("ParallelExtension");
+}
+
+void ParallelExtension::registerBuiltInFunctions(Engine* engine) {
+    engine->makeBuiltInFunction("parallel::map", bif_map);
+    engine->makeBuiltInFunction("parallel::reduce", bif_reduce);
+}
+
+/**
+  Collects the elements of the given list or array.
+  */
+static void fetchElements(const CallContext& ctx,
+                          const char* bifName,
+                          Atom collection,
+                          std::vector<Atom>* elements)
+{
+    if (isArray(collection)) {
+        Array* array = ctx.storage->getArray(collection);
+        for(int i = 1; i <= array->length(); i++) {
+            elements->push_back(array->at(i));
+        }
+    } else if (isCons(collection) || isNil(collection)) {
+        while(isCons(collection)) {
+            Cell cell = ctx.storage->getCons(collection);
+            elements->push_back(cell.car);
+            collection = cell.cdr;
+        }
+    } else {
+        ctx.engine->panic(QString("%1 requires a list or an array!").
+                          arg(bifName));
+    }
+    if (IsolatePool::isWorkerThread()) {
+        ctx.engine->panic(QString("%1 cannot be used within a parallel task!").
+                          arg(bifName));
+    }
+}
+
+/**
+  Checks whether the given start value of a reduction is neutral, i.e.
+  NIL, 0 or ''. As each chunk is folded starting with it, any other value
+  would be applied once per chunk.
+  */
+static bool isNeutral(Storage* storage, Atom start) {
+    if (isNil(start)) {
+        return true;
+    }
+    if (isSmallNumber(start)) {
+        return storage->getNumber(start) == 0;
+    }
+    if (isDecimalNumber(start)) {
+        return storage->getDecimal(start) == 0.0;
+    }
+    if (isString(start)) {
+        return storage->getStringLength(start) == 0;
+    }
+    return false;
+}
+
+/**
+  Returns the number of chunks into which the given number of elements is
+  split.
+  */
+static Word numberOfChunks(Word numElements) {
+    Word perWorker = TUNING_PARAM_PARALLEL_CHUNKS_PER_WORKER;
+    return qMin(numElements,
+                IsolatePool::getInstance()->size() * perWorker);
+}
+
+/**
+  Executes the given tasks and panics if one of them failed.
+  */
+static void executeTasks(const CallContext& ctx,
+                         const char* bifName,
+                         ParallelJob& job,
+                         std::vector<IsolateTask*>& tasks)
+{
+    IsolatePool::getInstance()->execute(tasks);
+    for(std::vector<IsolateTask*>::iterator i = tasks.begin();
+        i != tasks.end();
+        ++i)
+    {
+        delete *i;
+    }
+    if (job.hasFailed()) {
+        ctx.engine->panic(QString("%1: %2").arg(bifName, job.getError()));
+    }
+}
+
+void ParallelExtension::bif_map(const CallContext& ctx) {
+    AtomRef collection(ctx.storage, ctx.fetchArgument(BIF_INFO));
+    AtomRef fn(ctx.storage, ctx.fetchArgument(BIF_INFO));
+    std::vector<Atom> elements;
+    fetchElements(ctx, "parallel::map", collection.atom(), &elements);
+
+    ParallelJob job(ctx.storage, fn.atom(), NIL, elements, elements.size());
+    Word numChunks = numberOfChunks(elements.size());
+    std::vector<IsolateTask*> tasks;
+    for(Word i = 0; i < numChunks; i++) {
+        tasks.push_back(new MapTask(&job,
+                                    elements.size() * i / numChunks,
+                                    elements.size() * (i + 1) / numChunks));
+    }
+    executeTasks(ctx, "parallel::map", job, tasks);
+
+    if (isArray(collection.atom())) {
+        ctx.setResult(job.results->atom());
+        return;
+    }
+    ListBuilder result(ctx.storage);
+    for(Word i = 1; i <= elements.size(); i++) {
+        result.append(ctx.storage->getArray(job.results->atom())->at(i));
+    }
+    ctx.setResult(result.getResult());
+}
+
+void ParallelExtension::bif_reduce(const CallContext& ctx) {
+    AtomRef collection(ctx.storage, ctx.fetchArgument(BIF_INFO));
+    AtomRef fn(ctx.storage, ctx.fetchArgument(BIF_INFO));
+    AtomRef start(ctx.storage, ctx.fetchArgument(BIF_INFO));
+    std::vector<Atom> elements;
+    fetchElements(ctx, "parallel::reduce", collection.atom(), &elements);
+    if (!isNeutral(ctx.storage, start.atom())) {
+        ctx.engine->panic(QString("parallel::reduce: start must be NIL, 0 or ''!"));
+    }
+
+    Word numChunks = numberOfChunks(elements.size());
+    if (numChunks == 0) {
+        ctx.setResult(start.atom());
+        return;
+    }
+    ParallelJob job(ctx.storage, fn.atom(), start.atom(), elements, numChunks);
+    std::vector<IsolateTask*> tasks;
+    for(Word i = 0; i < numChunks; i++) {
+        tasks.push_back(new ReduceTask(&job,
+                                       elements.size() * i / numChunks,
+                                       elements.size() * (i + 1) / numChunks,
+                                       i));
+    }
+    executeTasks(ctx, "parallel::reduce", job, tasks);
+    if (numChunks == 1) {
+        ctx.setResult(ctx.storage->getArray(job.results->atom())->at(1));
+        return;
+    }
+
+    // Fold the results of the remaining chunks in order into the result of
+    // the first one, so that start isn't applied once more...
+    std::vector<Atom> partials;
+    fetchElements(ctx, "parallel::reduce", job.results->atom(), &partials);
+    AtomRef first(ctx.storage, partials.front());
+    partials.erase(partials.begin());
+    ParallelJob combine(ctx.storage, fn.atom(), first.atom(), partials, 1);
+    tasks.clear();
+    tasks.push_back(new ReduceTask(&combine, 0, partials.size(), 0));
+    executeTasks(ctx, "parallel::reduce", combine, tasks);
+    ctx.setResult(ctx.storage->getArray(combine.results->atom())->at(1));
+}
@@ -0,0 +1,79 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+#ifndef PARALLELEXTENSION_H
+#define PARALLELEXTENSION_H
+
+#include "engineextension.h"
+#include "callcontext.h"
+
+/**
+  Provides data parallel functions which run on all cores.
+
+  The given collection is split into chunks, which are executed by the
+  IsolatePool. Each chunk is deep-copied into the isolate of a worker. The
+  function (and the globals it refers to) is copied once per worker. The
+  results are copied back into the storage of the calling engine. Therefore the
+  function cannot modify values of the caller and must not use references
+  (e.g. files). The calling engine waits until all chunks are completed.
+  */
+class ParallelExtension : public EngineExtension
+{
+private:
+
+    /**
+      Applies fn to each element of the given list or array. Returns the
+      results in the same order (as list or array, like the input).
+
+        parallel::map := (collection : List|Array, fn : Function) -> List|Array
+
+      */
+    static void bif_map(const CallContext& ctx);
+
+    /**
+      Folds the given list or array like fold:with:start:. Each chunk is
+      folded on its own, starting with start. The results of the chunks are
+      then folded in order into the result of the first chunk. Therefore fn
+      must be associative and start must be neutral: NIL, 0 or '' are
+      accepted, any other value results in a panic.
+
+        parallel::reduce := (collection : List|Array, fn : Function, start : *) -> *
+
+      */
+    static void bif_reduce(const CallContext& ctx);
+
+public:
+
+    /**
+      Contains the static instance of the extension. This is directly loaded
+      by the Engine.
+      */
+    static ParallelExtension* INSTANCE;
+
+    /**
+      see: EngineExtension.name()
+      */
+    virtual QString name();
+
+    /**
+      see: EngineExtension.registerBuiltInFunctions()
+      */
+    virtual void registerBuiltInFunctions(Engine* engine);
+};
+
+#endif // PARALLELEXTENSION_H
@@ -0,0 +1,195 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+#include "regexextension.h"
+#include "vm/engine.h"
+
+#include <QMutexLocker>
+
+RegexExtension* RegexExtension::INSTANCE = new RegexExtension();
+
+QCache<QString, QRegExp> RegexExtension::cache(TUNING_PARAM_REGEX_CACHE_SIZE);
+QMutex RegexExtension::cacheLock;
+
+QString RegexExtension::name() {
+    return QString("RegexExtension");
+}
+
+void RegexExtension::registerBuiltInFunctions(Engine* engine) {
+    engine->makeBuiltInFunction("regex::compile", bif_compile);
+    engine->makeBuiltInFunction("regex::match", bif_match);
+    engine->makeBuiltInFunction("regex::find", bif_find);
+    engine->makeBuiltInFunction("regex::replace", bif_replace);
+    engine->makeBuiltInFunction("regex::split", bif_split);
+}
+
+QRegExp RegexExtension::compile(const CallContext& ctx,
+                                const QString& pattern,
+                                const char* bifName)
+{
+    {
+        QMutexLocker locker(&cacheLock);
+        QRegExp* cached = cache.object(pattern);
+        if (cached != NULL) {
+            // Copies share the compiled pattern, but each has its own
+            // captures. Therefore it is safe to match the copy...
+            return *cached;
+        }
+    }
+    QRegExp regExp(pattern, Qt::CaseSensitive, QRegExp::RegExp2);
+    if (!regExp.isValid()) {
+        ctx.engine->panic(QString("%1: Invalid pattern '%2': %3").
+                          arg(bifName, pattern, regExp.errorString()));
+    }
+    QMutexLocker locker(&cacheLock);
+    cache.insert(pattern, new QRegExp(regExp));
+    return regExp;
+}
+
+QRegExp RegexExtension::fetchPattern(const CallContext& ctx,
+                                     const char* bifName)
+{
+    Atom pattern = ctx.fetchArgument(BIF_INFO);
+    if (isString(pattern)) {
+        return compile(ctx, ctx.storage->getString(pattern), bifName);
+    }
+    PatternReference* ref = NULL;
+    if (isReference(pattern)) {
+        ref = dynamic_cast<PatternReference*>(
+                    ctx.storage->getReference(pattern));
+    }
+    if (ref == NULL) {
+        ctx.engine->panic(QString("The 2. argument of %1 must be a Pattern or a string!").
+                          arg(bifName));
+    }
+    return ref->regExp;
+}
+
+Atom RegexExtension::makeCaptures(const CallContext& ctx,
+                                  const QRegExp& regExp)
+{
+    ListBuilder builder(ctx.storage);
+    for (int i = 0; i <= regExp.captureCount(); i++) {
+        builder.append(ctx.storage->makeString(regExp.cap(i)));
+    }
+    return builder.getResult();
+}
+
+void RegexExtension::bif_compile(const CallContext& ctx) {
+    QString pattern = ctx.fetchString(BIF_INFO);
+
+    ctx.setReferenceResult(PatternReference::make(
+                               compile(ctx, pattern, "regex::compile")));
+}
+
+void RegexExtension::bif_match(const CallContext& ctx) {
+    QString string = ctx.fetchString(BIF_INFO);
+    QRegExp regExp = fetchPattern(ctx, "regex::match");
+
+    if (regExp.exactMatch(string)) {
+        ctx.setResult(makeCaptures(ctx, regExp));
+    }
+}
+
+void RegexExtension::bif_find(const CallContext& ctx) {
+    QString string = ctx.fetchString(BIF_INFO);
+    QRegExp regExp = fetchPattern(ctx, "regex::find");
+    int pos = 1;
+    if (ctx.hasMoreArguments()) {
+        pos = qMax(1, ctx.fetchNumber(BIF_INFO));
+    }
+
+    int index = regExp.indexIn(string, pos - 1);
+    if (index >= 0) {
+        AtomRef captures(ctx.storage, makeCaptures(ctx, regExp));
+        ctx.setResult(ctx.storage->makeCons(ctx.storage->makeNumber(index + 1),
+                                            captures.atom()));
+    }
+}
+
+void RegexExtension::bif_replace(const CallContext& ctx) {
+    QString string = ctx.fetchString(BIF_INFO);
+    QRegExp regExp = fetchPattern(ctx, "regex::replace");
+    QString replacement = ctx.fetchString(BIF_INFO);
+
+    QString result;
+    int last = 0;
+    int offset = 0;
+    while (offset <= string.length()) {
+        int index = regExp.indexIn(string, offset);
+        if (index < 0) {
+            break;
+        }
+        result.append(string.mid(last, index - last));
+        for (int i = 0; i < replacement.length(); i++) {
+            QChar ch = replacement.at(i);
+            if (ch == QChar('\\') && i + 1 < replacement.length()) {
+                QChar next = replacement.at(++i);
+                if (next.isDigit()) {
+                    result.append(regExp.cap(next.digitValue()));
+                } else {
+                    result.append(next);
+                }
+            } else {
+                result.append(ch);
+            }
+        }
+        int length = regExp.matchedLength();
+        if (length > 0) {
+            last = index + length;
+        } else {
+            // Skip a character after an empty match, so that the loop
+            // terminates...
+            if (index < string.length()) {
+                result.append(string.at(index));
+            }
+            last = index + 1;
+        }
+        offset = last;
+    }
+    if (last < string.length()) {
+        result.append(string.mid(last));
+    }
+    ctx.setStringResult(result);
+}
+
+void RegexExtension::bif_split(const CallContext& ctx) {
+    QString string = ctx.fetchString(BIF_INFO);
+    QRegExp regExp = fetchPattern(ctx, "regex::split");
+
+    ListBuilder builder(ctx.storage);
+    int last = 0;
+    int offset = 0;
+    while (offset < string.length()) {
+        int index = regExp.indexIn(string, offset);
+        if (index < 0) {
+            break;
+        }
+        int length = regExp.matchedLength();
+        if (length == 0) {
+            offset = index + 1;
+            continue;
+        }
+        builder.append(ctx.storage->makeString(string.mid(last,
+                                                          index - last)));
+        last = index + length;
+        offset = last;
+    }
+    builder.append(ctx.storage->makeString(string.mid(last)));
+    ctx.setResult(builder.getResult());
+}
@@ -0,0 +1,155 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+#ifndef REGEXEXTENSION_H
+#define REGEXEXTENSION_H
+
+#include "engineextension.h"
+#include "callcontext.h"
+#include "vm/reference.h"
+
+#include <QRegExp>
+#include <QCache>
+#include <QMutex>
+
+/**
+  Wraps a compiled regular expression (see regex::compile).
+  */
+class PatternReference : public Reference {
+private:
+    QRegExp regExp;
+    PatternReference(const QRegExp& regExp) : regExp(regExp) {}
+public:
+    static Reference* make(const QRegExp& regExp) {
+        return new PatternReference(regExp);
+    }
+
+    virtual QString toString() {
+        return regExp.pattern();
+    }
+
+    friend class RegexExtension;
+};
+
+/**
+  Provides functions for regular expressions.
+
+  Wherever a pattern is expected, either a string or a compiled pattern can
+  be given. Patterns given as string are compiled once and then kept in an
+  LRU cache (see TUNING_PARAM_REGEX_CACHE_SIZE), so that matching within a
+  loop does not recompile the pattern each time.
+  */
+class RegexExtension : public EngineExtension
+{
+private:
+    /**
+      Contains the compiled patterns by their source. The cache is shared
+      by all engines, therefore it is guarded by cacheLock.
+      */
+    static QCache<QString, QRegExp> cache;
+    static QMutex cacheLock;
+
+    /**
+      Compiles the given pattern:
+
+        regex::compile := (pattern : String) -> Pattern
+
+      */
+    static void bif_compile(const CallContext& ctx);
+
+    /**
+      Checks if the whole string matches the pattern. Returns the matched
+      string followed by the captured groups or NIL if it does not match:
+
+        regex::match := (string : String, pattern : (String|Pattern))
+                        -> (List[String]|NIL)
+
+      */
+    static void bif_match(const CallContext& ctx);
+
+    /**
+      Finds the first match at or after pos (default: 1). Returns its
+      position, followed by the matched string and the captured groups or
+      NIL if there is no match:
+
+        regex::find := (string : String,
+                        pattern : (String|Pattern),
+                        pos : Number?) -> (List|NIL)
+
+      */
+    static void bif_find(const CallContext& ctx);
+
+    /**
+      Replaces all matches by the given replacement, in which \0 to \9
+      refer to the matched string and the captured groups:
+
+        regex::replace := (string : String,
+                           pattern : (String|Pattern),
+                           replacement : String) -> String
+
+      */
+    static void bif_replace(const CallContext& ctx);
+
+    /**
+      Splits the string at each match. Empty parts are kept, empty matches
+      are ignored:
+
+        regex::split := (string : String, pattern : (String|Pattern))
+                        -> List[String]
+
+      */
+    static void bif_split(const CallContext& ctx);
+
+    /**
+      Returns the compiled pattern for the given source, either from the
+      cache or by compiling it. Generates a panic for invalid patterns.
+      */
+    static QRegExp compile(const CallContext& ctx,
+                           const QString& pattern,
+                           const char* bifName);
+
+    /**
+      Fetches a pattern which is given either as string or as Pattern.
+      */
+    static QRegExp fetchPattern(const CallContext& ctx, const char* bifName);
+
+    /**
+      Creates a list of the captured texts of the last match.
+      */
+    static Atom makeCaptures(const CallContext& ctx, const QRegExp& regExp);
+
+public:
+
+    /**
+      Contains the static instance of the extension. This is directly loaded
+      by the Engine.
+      */
+    static RegexExtension* INSTANCE;
+
+    /**
+      see: EngineExtension.name()
+      */
+    virtual QString name();
+
+    /**
+      see: EngineExtension.registerBuiltInFunctions()
+      */
+    virtual void registerBuiltInFunctions(Engine* engine);
+};
+
+#endif // REGEXEXTENSION_H
@@ -0,0 +1,691 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+#include "vectorextension.h"
+#include "vm/engine.h"
+
+#include <QScopedPointer>
+
+#include <cmath>
+#include <climits>
+
+VectorExtension* VectorExtension::INSTANCE = new VectorExtension();
+
+QString VectorExtension::name() {
+    return QString("VectorExtension");
+}
+
+void VectorExtension::registerBuiltInFunctions(Engine* engine) {
+    engine->makeBuiltInFunction("vec::float64", bif_float64);
+    engine->makeBuiltInFunction("vec::int64", bif_int64);
+    engine->makeBuiltInFunction("vec::length", bif_length);
+    engine->makeBuiltInFunction("vec::get", bif_get);
+    engine->makeBuiltInFunction("vec::set", bif_set);
+    engine->makeBuiltInFunction("vec::toList", bif_toList);
+    engine->makeBuiltInFunction("vec::add", bif_add);
+    engine->makeBuiltInFunction("vec::sub", bif_sub);
+    engine->makeBuiltInFunction("vec::mul", bif_mul);
+    engine->makeBuiltInFunction("vec::div", bif_div);
+    engine->makeBuiltInFunction("vec::sum", bif_sum);
+    engine->makeBuiltInFunction("vec::min", bif_min);
+    engine->makeBuiltInFunction("vec::max", bif_max);
+    engine->makeBuiltInFunction("vec::dot", bif_dot);
+    engine->makeBuiltInFunction("vec::sqrt", bif_sqrt);
+    engine->makeBuiltInFunction("vec::sin", bif_sin);
+    engine->makeBuiltInFunction("vec::cos", bif_cos);
+    engine->makeBuiltInFunction("vec::abs", bif_abs);
+}
+
+// ---------------------------------------------------------------------------
+// Kernels
+// ---------------------------------------------------------------------------
+
+/**
+  The operations are functors, so that they are inlined into the loops.
+  Integer arithmetic is performed unsigned, which wraps around instead of
+  being undefined on overflow.
+  */
+struct Add {
+    double operator()(double a, double b) const {
+        return a + b;
+    }
+    qint64 operator()(qint64 a, qint64 b) const {
+        return static_cast<qint64>(static_cast<quint64>(a) +
+                                   static_cast<quint64>(b));
+    }
+};
+
+struct Sub {
+    double operator()(double a, double b) const {
+        return a - b;
+    }
+    qint64 operator()(qint64 a, qint64 b) const {
+        return static_cast<qint64>(static_cast<quint64>(a) -
+                                   static_cast<quint64>(b));
+    }
+};
+
+struct Mul {
+    double operator()(double a, double b) const {
+        return a * b;
+    }
+    qint64 operator()(qint64 a, qint64 b) const {
+        return static_cast<qint64>(static_cast<quint64>(a) *
+                                   static_cast<quint64>(b));
+    }
+};
+
+struct Div {
+    double operator()(double a, double b) const {
+        return a / b;
+    }
+    qint64 operator()(qint64 a, qint64 b) const {
+        // MIN / -1 would trap...
+        return b == -1 ? static_cast<qint64>(0 - static_cast<quint64>(a))
+                       : a / b;
+    }
+};
+
+struct Sqrt {
+    double operator()(double x) const {
+        return std::sqrt(x);
+    }
+};
+
+struct Sin {
+    double operator()(double x) const {
+        return std::sin(x);
+    }
+};
+
+struct Cos {
+    double operator()(double x) const {
+        return std::cos(x);
+    }
+};
+
+template<typename T, typename Op>
+static void combine(const T* a, const T* b, T* out, int n, Op op) {
+    for (int i = 0; i < n; i++) {
+        out[i] = op(a[i], b[i]);
+    }
+}
+
+template<typename T, typename Op>
+static void combineScalar(const T* a, T b, T* out, int n, Op op) {
+    for (int i = 0; i < n; i++) {
+        out[i] = op(a[i], b);
+    }
+}
+
+/**
+  Applies the given arithmetic opcode to each pair of elements. If b is
+  NULL, the scalar is used as second operand.
+  */
+template<typename T>
+static void compute(Atom opcode,
+                    const T* a,
+                    const T* b,
+                    T scalar,
+                    T* out,
+                    int n)
+{
+    if (b != NULL) {
+        switch (opcode) {
+        case SYMBOL_OP_ADD:
+            combine(a, b, out, n, Add());
+            break;
+        case SYMBOL_OP_SUB:
+            combine(a, b, out, n, Sub());
+            break;
+        case SYMBOL_OP_MUL:
+            combine(a, b, out, n, Mul());
+            break;
+        case SYMBOL_OP_DIV:
+            combine(a, b, out, n, Div());
+            break;
+        }
+    } else {
+        switch (opcode) {
+        case SYMBOL_OP_ADD:
+            combineScalar(a, scalar, out, n, Add());
+            break;
+        case SYMBOL_OP_SUB:
+            combineScalar(a, scalar, out, n, Sub());
+            break;
+        case SYMBOL_OP_MUL:
+            combineScalar(a, scalar, out, n, Mul());
+            break;
+        case SYMBOL_OP_DIV:
+            combineScalar(a, scalar, out, n, Div());
+            break;
+        }
+    }
+}
+
+/**
+  Sums up the given values. The compiler must not reorder floating point
+  additions by itself. Therefore four independent partial sums are used,
+  which can be computed in parallel.
+  */
+static double sum(const double* values, int n) {
+    double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += values[i];
+        s1 += values[i + 1];
+        s2 += values[i + 2];
+        s3 += values[i + 3];
+    }
+    for (; i < n; i++) {
+        s0 += values[i];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+static qint64 sum(const qint64* values, int n) {
+    quint64 result = 0;
+    for (int i = 0; i < n; i++) {
+        result += static_cast<quint64>(values[i]);
+    }
+    return static_cast<qint64>(result);
+}
+
+static double dot(const double* a, const double* b, int n) {
+    double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; i++) {
+        s0 += a[i] * b[i];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+static qint64 dot(const qint64* a, const qint64* b, int n) {
+    quint64 result = 0;
+    for (int i = 0; i < n; i++) {
+        result += static_cast<quint64>(a[i]) * static_cast<quint64>(b[i]);
+    }
+    return static_cast<qint64>(result);
+}
+
+template<typename T> static T minimum(const T* values, int n) {
+    T result = values[0];
+    for (int i = 1; i < n; i++) {
+        result = values[i] < result ? values[i] : result;
+    }
+    return result;
+}
+
+template<typename T> static T maximum(const T* values, int n) {
+    T result = values[0];
+    for (int i = 1; i < n; i++) {
+        result = values[i] > result ? values[i] : result;
+    }
+    return result;
+}
+
+/**
+  Converts the given Int64Array into a Float64Array, so that it can be
+  combined with one.
+  */
+static Float64Array* toFloats(Int64Array* ints) {
+    Float64Array* result = Float64Array::make(ints->size());
+    const qint64* in = ints->data();
+    double* out = result->data();
+    for (int i = 0; i < ints->size(); i++) {
+        out[i] = static_cast<double>(in[i]);
+    }
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Built-in functions
+// ---------------------------------------------------------------------------
+
+void VectorExtension::fetchVector(const CallContext& ctx,
+                                  const char* bifName,
+                                  Float64Array** floats,
+                                  Int64Array** ints)
+{
+    Atom vector = ctx.fetchArgument(BIF_INFO);
+    *floats = NULL;
+    *ints = NULL;
+    if (isReference(vector)) {
+        Reference* ref = ctx.storage->getReference(vector);
+        *floats = dynamic_cast<Float64Array*>(ref);
+        *ints = dynamic_cast<Int64Array*>(ref);
+    }
+    if (*floats == NULL && *ints == NULL) {
+        ctx.engine->panic(QString("%1: Expected a Float64Array or an Int64Array!").
+                          arg(bifName));
+    }
+}
+
+int VectorExtension::fetchIndex(const CallContext& ctx,
+                                const char* bifName,
+                                int size)
+{
+    int pos = ctx.fetchNumber(BIF_INFO);
+    if (pos < 1 || pos > size) {
+        ctx.engine->panic(QString("%1: Position %2 is out of range (1..%3)!").
+                          arg(bifName,
+                              QString::number(pos),
+                              QString::number(size)));
+    }
+    return pos - 1;
+}
+
+/**
+  Converts a numeric atom into a double or generates a panic.
+  */
+static double toDouble(const CallContext& ctx,
+                       const char* bifName,
+                       Atom value)
+{
+    if (isNumber(value)) {
+        return static_cast<double>(ctx.storage->getNumber(value));
+    }
+    if (!isDecimalNumber(value)) {
+        ctx.engine->panic(QString("%1: Expected a number but got: %2").
+                          arg(bifName, ctx.engine->toSimpleString(value)));
+    }
+    return ctx.storage->getDecimal(value);
+}
+
+/**
+  Truncates a double into an integer or generates a panic if it is out of
+  range (or NaN), as the conversion would be undefined otherwise.
+  */
+static qint64 truncate(const CallContext& ctx,
+                       const char* bifName,
+                       double value)
+{
+    // 2^63 is exactly representable, other than the largest qint64...
+    if (!(value >= -9223372036854775808.0 && value < 9223372036854775808.0)) {
+        ctx.engine->panic(QString("%1: %2 is out of range for an Int64Array!").
+                          arg(bifName, QString::number(value)));
+    }
+    return static_cast<qint64>(value);
+}
+
+/**
+  Converts a double into an element of a typed array.
+  */
+template<typename T>
+static T fromDouble(const CallContext& ctx, const char* bifName, double value);
+
+template<>
+double fromDouble<double>(const CallContext&, const char*, double value) {
+    return value;
+}
+
+template<>
+qint64 fromDouble<qint64>(const CallContext& ctx,
+                          const char* bifName,
+                          double value)
+{
+    return truncate(ctx, bifName, value);
+}
+
+/**
+  Converts a numeric atom into an element of a typed array or generates a
+  panic. Integers are not converted via double, to keep them exact.
+  */
+template<typename T>
+static T toElement(const CallContext& ctx, const char* bifName, Atom value) {
+    if (isNumber(value)) {
+        return static_cast<T>(ctx.storage->getNumber(value));
+    }
+    return fromDouble<T>(ctx, bifName, toDouble(ctx, bifName, value));
+}
+
+/**
+  Creates a typed array of the given type for the argument of vec::float64
+  or vec::int64. As converting the elements might panic, the result is only
+  released once it is complete.
+  */
+template<typename T>
+static NumericArray<T>* makeVector(const CallContext& ctx,
+                                   const char* bifName)
+{
+    Atom values = ctx.fetchArgument(BIF_INFO);
+    if (isNumber(values)) {
+        Number size = ctx.storage->getNumber(values);
+        if (size < 0 || size > INT_MAX) {
+            ctx.engine->panic(QString("%1: Invalid size: %2").
+                              arg(bifName, QString::number(size)));
+        }
+        return NumericArray<T>::make(static_cast<int>(size));
+    }
+    if (isNil(values) || isCons(values)) {
+        int size = 0;
+        for (Atom i = values; isCons(i); i = ctx.storage->getCons(i).cdr) {
+            size++;
+        }
+        QScopedPointer< NumericArray<T> > result(NumericArray<T>::make(size));
+        T* out = result->data();
+        for (int i = 0; i < size; i++) {
+            Cell cell = ctx.storage->getCons(values);
+            out[i] = toElement<T>(ctx, bifName, cell.car);
+            values = cell.cdr;
+        }
+        return result.take();
+    }
+    if (isArray(values)) {
+        Array* array = ctx.storage->getArray(values);
+        QScopedPointer< NumericArray<T> > result(
+                    NumericArray<T>::make(array->length()));
+        T* out = result->data();
+        for (int i = 0; i < array->length(); i++) {
+            out[i] = toElement<T>(ctx, bifName, array->at(i + 1));
+        }
+        return result.take();
+    }
+    Reference* ref = isReference(values) ?
+                ctx.storage->getReference(values) : NULL;
+    Float64Array* floats = dynamic_cast<Float64Array*>(ref);
+    Int64Array* ints = dynamic_cast<Int64Array*>(ref);
+    if (floats != NULL) {
+        QScopedPointer< NumericArray<T> > result(
+                    NumericArray<T>::make(floats->size()));
+        for (int i = 0; i < floats->size(); i++) {
+            result->data()[i] = fromDouble<T>(ctx,
+                                              bifName,
+                                              floats->data()[i]);
+        }
+        return result.take();
+    }
+    if (ints != NULL) {
+        NumericArray<T>* result = NumericArray<T>::make(ints->size());
+        for (int i = 0; i < ints->size(); i++) {
+            result->data()[i] = static_cast<T>(ints->data()[i]);
+        }
+        return result;
+    }
+    ctx.engine->panic(QString("%1: Expected a size, a list, an array or a vector!").
+                      arg(bifName));
+    return NULL;
+}
+
+void VectorExtension::bif_float64(const CallContext& ctx) {
+    ctx.setReferenceResult(makeVector<double>(ctx, "vec::float64"));
+}
+
+void VectorExtension::bif_int64(const CallContext& ctx) {
+    ctx.setReferenceResult(makeVector<qint64>(ctx, "vec::int64"));
+}
+
+void VectorExtension::bif_length(const CallContext& ctx) {
+    Float64Array* floats;
+    Int64Array* ints;
+    fetchVector(ctx, "vec::length", &floats, &ints);
+    ctx.setNumberResult(floats ? floats->size() : ints->size());
+}
+
+void VectorExtension::bif_get(const CallContext& ctx) {
+    Float64Array* floats;
+    Int64Array* ints;
+    fetchVector(ctx, "vec::get", &floats, &ints);
+    if (floats) {
+        int index = fetchIndex(ctx, "vec::get", floats->size());
+        ctx.setDoubleResult(floats->data()[index]);
+    } else {
+        int index = fetchIndex(ctx, "vec::get", ints->size());
+        ctx.setResult(ctx.storage->makeNumber(ints->data()[index]));
+    }
+}
+
+void VectorExtension::bif_set(const CallContext& ctx) {
+    Float64Array* floats;
+    Int64Array* ints;
+    fetchVector(ctx, "vec::set", &floats, &ints);
+    int index = fetchIndex(ctx,
+                           "vec::set",
+                           floats ? floats->size() : ints->size());
+    Atom value = ctx.fetchArgument(BIF_INFO);
+    if (floats) {
+        floats->data()[index] = toDouble(ctx, "vec::set", value);
+    } else {
+        ints->data()[index] = toElement<qint64>(ctx, "vec::set", value);
+    }
+    ctx.setResult(value);
+}
+
+void VectorExtension::bif_toList(const CallContext& ctx) {
+    Float64Array* floats;
+    Int64Array* ints;
+    fetchVector(ctx, "vec::toList", &floats, &ints);
+    ListBuilder builder(ctx.storage);
+    if (floats) {
+        for (int i = 0; i < floats->size(); i++) {
+            builder.append(ctx.storage->makeDecimal(floats->data()[i]));
+        }
+    } else {
+        for (int i = 0; i < ints->size(); i++) {
+            builder.append(ctx.storage->makeNumber(ints->data()[i]));
+        }
+    }
+    ctx.setResult(builder.getResult());
+}
+
+void VectorExtension::arithmetic(const CallContext& ctx,
+                                 const char* bifName,
+                                 Atom opcode)
+{
+    Float64Array* floatsA;
+    Int64Array* intsA;
+    fetchVector(ctx, bifName, &floatsA, &intsA);
+    int size = floatsA ? floatsA->size() : intsA->size();
+
+    Atom b = ctx.fetchArgument(BIF_INFO);
+    Float64Array* floatsB = NULL;
+    Int64Array* intsB = NULL;
+    if (isReference(b)) {
+        Reference* ref = ctx.storage->getReference(b);
+        floatsB = dynamic_cast<Float64Array*>(ref);
+        intsB = dynamic_cast<Int64Array*>(ref);
+    }
+    bool scalar = floatsB == NULL && intsB == NULL;
+    if (scalar && !isNumeric(b)) {
+        ctx.engine->panic(QString("%1: The 2. argument must be a vector or a number!").
+                          arg(bifName));
+    }
+    if (!scalar && (floatsB ? floatsB->size() : intsB->size()) != size) {
+        ctx.engine->panic(QString("%1: The vectors differ in length!").
+                          arg(bifName));
+    }
+
+    if (floatsA == NULL && floatsB == NULL && !isDecimalNumber(b)) {
+        // Both are integers...
+        qint64 value = scalar ? ctx.storage->getNumber(b) : 0;
+        if (opcode == SYMBOL_OP_DIV) {
+            bool zero = scalar ? value == 0 : false;
+            for (int i = 0; !scalar && i < size; i++) {
+                zero |= intsB->data()[i] == 0;
+            }
+            if (zero) {
+                ctx.engine->panic(QString("%1: Division by zero!").
+                                  arg(bifName));
+            }
+        }
+        QScopedPointer<Int64Array> result(Int64Array::make(size));
+        compute<qint64>(opcode,
+                        intsA->data(),
+                        scalar ? NULL : intsB->data(),
+                        value,
+                        result->data(),
+                        size);
+        ctx.setReferenceResult(result.take());
+        return;
+    }
+
+    // Integer operands are converted, so that the kernel works on doubles
+    // only...
+    QScopedPointer<Float64Array> convertedA(intsA ? toFloats(intsA) : NULL);
+    QScopedPointer<Float64Array> convertedB(intsB ? toFloats(intsB) : NULL);
+    Float64Array* a = floatsA ? floatsA : convertedA.data();
+    Float64Array* vectorB = floatsB ? floatsB : convertedB.data();
+    double value = scalar ? toDouble(ctx, bifName, b) : 0.0;
+    QScopedPointer<Float64Array> result(Float64Array::make(size));
+    compute<double>(opcode,
+                    a->data(),
+                    scalar ? NULL : vectorB->data(),
+                    value,
+                    result->data(),
+                    size);
+    ctx.setReferenceResult(result.take());
+}
+
+void VectorExtension::bif_add(const CallContext& ctx) {
+    arithmetic(ctx, "vec::add", SYMBOL_OP_ADD);
+}
+
+void VectorExtension::bif_sub(const CallContext& ctx) {
+    arithmetic(ctx, "vec::sub", SYMBOL_OP_SUB);
+}
+
+void VectorExtension::bif_mul(const CallContext& ctx) {
+    arithmetic(ctx, "vec::mul", SYMBOL_OP_MUL);
+}
+
+void VectorExtension::bif_div(const CallContext& ctx) {
+    arithmetic(ctx, "vec::div", SYMBOL_OP_DIV);
+}
+
+void VectorExtension::bif_sum(const CallContext& ctx) {
+    Float64Array* floats;
+    Int64Array* ints;
+    fetchVector(ctx, "vec::sum", &floats, &ints);
+    if (floats) {
+        ctx.setDoubleResult(sum(floats->data(), floats->size()));
+    } else {
+        ctx.setResult(ctx.storage->makeNumber(sum(ints->data(),
+                                                  ints->size())));
+    }
+}
+
+void VectorExtension::bif_min(const CallContext& ctx) {
+    Float64Array* floats;
+    Int64Array* ints;
+    fetchVector(ctx, "vec::min", &floats, &ints);
+    if (floats && floats->size() > 0) {
+        ctx.setDoubleResult(minimum(floats->data(), floats->size()));
+    } else if (ints && ints->size() > 0) {
+        ctx.setResult(ctx.storage->makeNumber(minimum(ints->data(),
+                                                      ints->size())));
+    }
+}
+
+void VectorExtension::bif_max(const CallContext& ctx) {
+    Float64Array* floats;
+    Int64Array* ints;
+    fetchVector(ctx, "vec::max", &floats, &ints);
+    if (floats && floats->size() > 0) {
+        ctx.setDoubleResult(maximum(floats->data(), floats->size()));
+    } else if (ints && ints->size() > 0) {
+        ctx.setResult(ctx.storage->makeNumber(maximum(ints->data(),
+                                                      ints->size())));
+    }
+}
+
+void VectorExtension::bif_dot(const CallContext& ctx) {
+    Float64Array* floatsA;
+    Int64Array* intsA;
+    fetchVector(ctx, "vec::dot", &floatsA, &intsA);
+    Float64Array* floatsB;
+    Int64Array* intsB;
+    fetchVector(ctx, "vec::dot", &floatsB, &intsB);
+    int size = floatsA ? floatsA->size() : intsA->size();
+    if ((floatsB ? floatsB->size() : intsB->size()) != size) {
+        ctx.engine->panic("vec::dot: The vectors differ in length!");
+    }
+    if (intsA && intsB) {
+        ctx.setResult(ctx.storage->makeNumber(dot(intsA->data(),
+                                                  intsB->data(),
+                                                  size)));
+        return;
+    }
+    QScopedPointer<Float64Array> convertedA(intsA ? toFloats(intsA) : NULL);
+    QScopedPointer<Float64Array> convertedB(intsB ? toFloats(intsB) : NULL);
+    Float64Array* a = floatsA ? floatsA : convertedA.data();
+    Float64Array* b = floatsB ? floatsB : convertedB.data();
+    ctx.setDoubleResult(dot(a->data(), b->data(), size));
+}
+
+template<typename Fn>
+void VectorExtension::apply(const CallContext& ctx,
+                            const char* bifName,
+                            Fn fn)
+{
+    Float64Array* floats;
+    Int64Array* ints;
+    fetchVector(ctx, bifName, &floats, &ints);
+    QScopedPointer<Float64Array> converted(ints ? toFloats(ints) : NULL);
+    Float64Array* input = floats ? floats : converted.data();
+    QScopedPointer<Float64Array> result(Float64Array::make(input->size()));
+    const double* in = input->data();
+    double* out = result->data();
+    for (int i = 0; i < input->size(); i++) {
+        out[i] = fn(in[i]);
+    }
+    ctx.setReferenceResult(result.take());
+}
+
+void VectorExtension::bif_sqrt(const CallContext& ctx) {
+    apply(ctx, "vec::sqrt", Sqrt());
+}
+
+void VectorExtension::bif_sin(const CallContext& ctx) {
+    apply(ctx, "vec::sin", Sin());
+}
+
+void VectorExtension::bif_cos(const CallContext& ctx) {
+    apply(ctx, "vec::cos", Cos());
+}
+
+void VectorExtension::bif_abs(const CallContext& ctx) {
+    Float64Array* floats;
+    Int64Array* ints;
+    fetchVector(ctx, "vec::abs", &floats, &ints);
+    if (floats) {
+        QScopedPointer<Float64Array> result(
+                    Float64Array::make(floats->size()));
+        const double* in = floats->data();
+        double* out = result->data();
+        for (int i = 0; i < floats->size(); i++) {
+            out[i] = std::fabs(in[i]);
+        }
+        ctx.setReferenceResult(result.take());
+    } else {
+        QScopedPointer<Int64Array> result(Int64Array::make(ints->size()));
+        const qint64* in = ints->data();
+        qint64* out = result->data();
+        for (int i = 0; i < ints->size(); i++) {
+            out[i] = in[i] < 0 ?
+                        static_cast<qint64>(0 - static_cast<quint64>(in[i])) :
+                        in[i];
+        }
+        ctx.setReferenceResult(result.take());
+    }
+}
@@ -0,0 +1,307 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+#ifndef VECTOREXTENSION_H
+#define VECTOREXTENSION_H
+
+#include "engineextension.h"
+#include "callcontext.h"
+#include "vm/reference.h"
+
+#include <vector>
+
+/**
+  Represents an array of unboxed numbers, stored contiguously. In contrast
+  to Array, an element is not an Atom, therefore no entry in the tables of
+  the storage is needed per element. Like Array, the first index is 1.
+  */
+template<typename T> class NumericArray : public Reference {
+private:
+    std::vector<T> values;
+    NumericArray(int size) : values(size, T()) {}
+public:
+    static NumericArray<T>* make(int size) {
+        return new NumericArray<T>(size);
+    }
+
+    int size() const {
+        return static_cast<int>(values.size());
+    }
+
+    /**
+      Provides direct access to the elements, so that the kernels can
+      operate on plain memory.
+      */
+    T* data() {
+        return values.empty() ? NULL : &values[0];
+    }
+
+    /**
+      Lists the first elements along with the given type name.
+      */
+    QString describe(const char* typeName) {
+        QString result(typeName);
+        result += "(";
+        for (int i = 0; i < size() && i < 10; i++) {
+            if (i > 0) {
+                result += " ";
+            }
+            result += QString::number(values[i]);
+        }
+        if (size() > 10) {
+            result += QString(" ... (%1 elements)").arg(size());
+        }
+        result += ")";
+        return result;
+    }
+
+    virtual QString toString();
+};
+
+typedef NumericArray<double> Float64Array;
+typedef NumericArray<qint64> Int64Array;
+
+template<> inline QString Float64Array::toString() {
+    return describe("Float64Array");
+}
+
+template<> inline QString Int64Array::toString() {
+    return describe("Int64Array");
+}
+
+/**
+  Provides typed numeric arrays (Float64Array and Int64Array) along with
+  element-wise arithmetic, reductions and math functions.
+
+  All kernels are plain loops over contiguous memory, without any calls or
+  type checks per element, so that the compiler can vectorize them.
+  Arithmetic on Int64Arrays wraps around on overflow. If a Float64Array and
+  an Int64Array (or a decimal) are combined, the result is a Float64Array.
+  */
+class VectorExtension : public EngineExtension
+{
+private:
+
+    /**
+      Creates a Float64Array. Either the size (all elements are 0) or the
+      initial values are given. Values can be given as list, Array or typed
+      array:
+
+        vec::float64 := (sizeOrValues : (Number|List|Array|Vector))
+                        -> Float64Array
+
+      */
+    static void bif_float64(const CallContext& ctx);
+
+    /**
+      Creates an Int64Array, like vec::float64. Decimals are truncated, a
+      decimal which is out of range (or NaN) is a panic. Other than scalar
+      arithmetic, which switches to decimals, the arithmetic on Int64Arrays
+      wraps around on overflow (modulo 2^64):
+
+        vec::int64 := (sizeOrValues : (Number|List|Array|Vector))
+                      -> Int64Array
+
+      */
+    static void bif_int64(const CallContext& ctx);
+
+    /**
+      Returns the number of elements:
+
+        vec::length := (v : Vector) -> Number
+
+      */
+    static void bif_length(const CallContext& ctx);
+
+    /**
+      Returns the element at the given position (starting at 1):
+
+        vec::get := (v : Vector, pos : Number) -> (Number|Decimal)
+
+      */
+    static void bif_get(const CallContext& ctx);
+
+    /**
+      Stores the given value at the given position (starting at 1) and
+      returns it:
+
+        vec::set := (v : Vector, pos : Number, value : (Number|Decimal))
+                    -> (Number|Decimal)
+
+      */
+    static void bif_set(const CallContext& ctx);
+
+    /**
+      Returns the elements as list:
+
+        vec::toList := (v : Vector) -> List
+
+      */
+    static void bif_toList(const CallContext& ctx);
+
+    /**
+      Computes a + b element-wise. b is either a vector of the same length
+      or a number which is combined with each element:
+
+        vec::add := (a : Vector, b : (Vector|Number|Decimal)) -> Vector
+
+      */
+    static void bif_add(const CallContext& ctx);
+
+    /**
+      Computes a - b element-wise (see vec::add):
+
+        vec::sub := (a : Vector, b : (Vector|Number|Decimal)) -> Vector
+
+      */
+    static void bif_sub(const CallContext& ctx);
+
+    /**
+      Computes a * b element-wise (see vec::add):
+
+        vec::mul := (a : Vector, b : (Vector|Number|Decimal)) -> Vector
+
+      */
+    static void bif_mul(const CallContext& ctx);
+
+    /**
+      Computes a / b element-wise (see vec::add). Integers are divided like
+      #DIV does, a division by zero generates a panic:
+
+        vec::div := (a : Vector, b : (Vector|Number|Decimal)) -> Vector
+
+      */
+    static void bif_div(const CallContext& ctx);
+
+    /**
+      Returns the sum of all elements:
+
+        vec::sum := (v : Vector) -> (Number|Decimal)
+
+      */
+    static void bif_sum(const CallContext& ctx);
+
+    /**
+      Returns the smallest element or NIL if the vector is empty:
+
+        vec::min := (v : Vector) -> (Number|Decimal|NIL)
+
+      */
+    static void bif_min(const CallContext& ctx);
+
+    /**
+      Returns the largest element or NIL if the vector is empty:
+
+        vec::max := (v : Vector) -> (Number|Decimal|NIL)
+
+      */
+    static void bif_max(const CallContext& ctx);
+
+    /**
+      Returns the dot product of two vectors of the same length:
+
+        vec::dot := (a : Vector, b : Vector) -> (Number|Decimal)
+
+      */
+    static void bif_dot(const CallContext& ctx);
+
+    /**
+      Computes the square root of each element:
+
+        vec::sqrt := (v : Vector) -> Float64Array
+
+      */
+    static void bif_sqrt(const CallContext& ctx);
+
+    /**
+      Computes the sine of each element:
+
+        vec::sin := (v : Vector) -> Float64Array
+
+      */
+    static void bif_sin(const CallContext& ctx);
+
+    /**
+      Computes the cosine of each element:
+
+        vec::cos := (v : Vector) -> Float64Array
+
+      */
+    static void bif_cos(const CallContext& ctx);
+
+    /**
+      Computes the absolute value of each element:
+
+        vec::abs := (v : Vector) -> Vector
+
+      */
+    static void bif_abs(const CallContext& ctx);
+
+    /**
+      Fetches a Float64Array or an Int64Array. Exactly one of the given
+      pointers is set.
+      */
+    static void fetchVector(const CallContext& ctx,
+                            const char* bifName,
+                            Float64Array** floats,
+                            Int64Array** ints);
+
+    /**
+      Fetches a position argument and checks it against the given size.
+      Returns the zero based index.
+      */
+    static int fetchIndex(const CallContext& ctx,
+                          const char* bifName,
+                          int size);
+
+    /**
+      Shared implementation of vec::add, vec::sub, vec::mul and vec::div.
+      */
+    static void arithmetic(const CallContext& ctx,
+                           const char* bifName,
+                           Atom opcode);
+
+    /**
+      Shared implementation of vec::sqrt, vec::sin and vec::cos. The
+      function is passed as functor, so that it can be inlined into the
+      loop.
+      */
+    template<typename Fn> static void apply(const CallContext& ctx,
+                                            const char* bifName,
+                                            Fn fn);
+
+public:
+
+    /**
+      Contains the static instance of the extension. This is directly loaded
+      by the Engine.
+      */
+    static VectorExtension* INSTANCE;
+
+    /**
+      see: EngineExtension.name()
+      */
+    virtual QString name();
+
+    /**
+      see: EngineExtension.registerBuiltInFunctions()
+      */
+    virtual void registerBuiltInFunctions(Engine* engine);
+};
+
+#endif // VECTOREXTENSION_H
@@ -18,6 +18,8 @@
  */
 
 #include "compiler.h"
+#include "compiler/peephole.h"
+#include "compiler/verifier.h"
 
 Compiler::Compiler(const QString& fileName,
                    const QString& input,
@@ -87,7 +89,14 @@ bool Compiler::compile(bool appendStop) {
     } else {
         addCode(SYMBOL_OP_RTN);
     }
-    return errors.empty();
+    if (!errors.empty()) {
+        return false;
+    }
+    PeepholeOptimizer optimizer(&engine->storage);
+    optimizer.optimize(code->atom());
+    Verifier verifier(&engine->storage);
+    verifier.verify(code->atom());
+    return true;
 }
 
 void Compiler::block() {
@@ -314,11 +323,11 @@ void Compiler::generateFunctionCode(bool expectBracet, bool asSublist) {
     if (asSublist) {
         Atom fn = code->atom();
         code->atom(backupCode->atom());
-        delete backupCode;
         tail->atom(backupTail->atom());
-        delete backupTail;
         addCode(fn);
     }
+    delete backupCode;
+    delete backupTail;
 }
 
 
@@ -587,47 +596,58 @@ void Compiler::call() {
 
 void Compiler::colonCall() {
     QString name("");
-    addCode(SYMBOL_OP_NIL);
+    int numberOfArguments = 0;
     while(tokenizer.isCurrent(TT_NAME) &&
           tokenizer.getCurrentString().endsWith(':')) {
         name += tokenizer.getCurrentString();
         tokenizer.fetch();
         expression();
-        addCode(SYMBOL_OP_CHAIN);
+        numberOfArguments++;
     }
-    addCode(SYMBOL_OP_CHAIN_END);
-    load(name);
-    addCode(SYMBOL_OP_AP);
-    addCode(engine->storage.makeSymbol(name));
+    apply(name, numberOfArguments);
 }
 
 void Compiler::standardCall() {
     QString name = tokenizer.getCurrentString();
     tokenizer.fetch(); // name
     tokenizer.fetch(); // (
-    if (!tokenizer.isCurrent(TT_R_BRACE)) {
-        addCode(SYMBOL_OP_NIL);
-        while(!tokenizer.isCurrent(TT_R_BRACE) &&
-              !tokenizer.isCurrent(TT_EOF))
-        {
-            expression();
-            addCode(SYMBOL_OP_CHAIN);
-            if (tokenizer.isCurrent(TT_KOMMA)) {
-                tokenizer.fetch();
-            }
+    int numberOfArguments = 0;
+    while(!tokenizer.isCurrent(TT_R_BRACE) &&
+          !tokenizer.isCurrent(TT_EOF))
+    {
+        expression();
+        numberOfArguments++;
+        if (tokenizer.isCurrent(TT_KOMMA)) {
+            tokenizer.fetch();
         }
-        addCode(SYMBOL_OP_CHAIN_END);
-        expect(TT_R_BRACE, ")");
-        load(name);
-        addCode(SYMBOL_OP_AP);
-        addCode(engine->storage.makeSymbol(name));
+    }
+    expect(TT_R_BRACE, ")");
+    apply(name, numberOfArguments);
+}
 
-    } else {
-        expect(TT_R_BRACE, ")");
-        load(name);
+void Compiler::apply(const QString& name, int numberOfArguments) {
+    load(name);
+    switch(numberOfArguments) {
+    case 0:
         addCode(SYMBOL_OP_AP0);
-        addCode(engine->storage.makeSymbol(name));
+        break;
+    case 1:
+        addCode(SYMBOL_OP_AP1);
+        break;
+    case 2:
+        addCode(SYMBOL_OP_AP2);
+        break;
+    case 3:
+        addCode(SYMBOL_OP_AP3);
+        break;
+    case 4:
+        addCode(SYMBOL_OP_AP4);
+        break;
+    default:
+        addCode(SYMBOL_OP_APV);
+        addCode(engine->storage.makeNumber(numberOfArguments));
     }
+    addCode(engine->storage.makeSymbol(name));
 }
 
 void Compiler::splitAssignment() {
@@ -46,7 +46,10 @@
   same name.
 
   Being a one pass compiler, each method directly outputs the appropriate
-  bytecode for the parsed sources.
+  bytecode for the parsed sources. Once the compilation succeeded, the
+  PeepholeOptimizer replaces frequently used op code sequences by
+  superinstructions. Afterwards the Verifier checks the code, so that the
+  engine can execute it without redundant checks.
 
   Tokens
   -------------------------------------------------------------------
@@ -337,6 +340,12 @@ private:
       */
     void standardCall();
 
+    /**
+      Generates the code to invoke the function with the given name. The
+      arguments have already been pushed onto the stack.
+      */
+    void apply(const QString& name, int numberOfArguments);
+
     /**
       Compiles a lokal assignment: x := 1;
       */
@@ -0,0 +1,152 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+
+#include "peephole.h"
+
+Atom PeepholeOptimizer::skip(Atom cell, int count) {
+    while(count > 0 && isCons(cell)) {
+        cell = storage->getCons(cell).cdr;
+        count--;
+    }
+    return cell;
+}
+
+bool PeepholeOptimizer::isRelation(Atom opcode) {
+    return opcode == SYMBOL_OP_EQ ||
+           opcode == SYMBOL_OP_NE ||
+           opcode == SYMBOL_OP_LT ||
+           opcode == SYMBOL_OP_GT ||
+           opcode == SYMBOL_OP_LTQ ||
+           opcode == SYMBOL_OP_GTQ;
+}
+
+int PeepholeOptimizer::stackArguments(Atom opcode) {
+    switch(opcode) {
+    case SYMBOL_OP_AP1:
+        return 1;
+    case SYMBOL_OP_AP2:
+        return 2;
+    case SYMBOL_OP_AP3:
+        return 3;
+    case SYMBOL_OP_AP4:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+void PeepholeOptimizer::optimize(Atom code) {
+    Atom cell = code;
+    while(isCons(cell)) {
+        fuse(cell);
+        Atom opcode = storage->getCons(cell).car;
+        if (opcode == SYMBOL_OP_LDF) {
+            Atom body = skip(cell, 1);
+            optimize(storage->getCons(body).car);
+            addEntry(body);
+        } else if (opcode == SYMBOL_OP_BT) {
+            optimize(storage->getCons(skip(cell, 1)).car);
+        } else if (opcode == SYMBOL_OP_TESTC) {
+            optimize(storage->getCons(skip(cell, 4)).car);
+        }
+        cell = skip(cell, 1 + countOperands(opcode));
+    }
+}
+
+void PeepholeOptimizer::addEntry(Atom body) {
+    Atom code = storage->getCons(body).car;
+    Atom counter = storage->makeCons(storage->makeNumber(0), code);
+    storage->setCAR(body, storage->makeCons(SYMBOL_OP_ENTRY, counter));
+}
+
+void PeepholeOptimizer::fuse(Atom cell) {
+    Atom cells[MAX_SEQUENCE_LENGTH];
+    Atom ops[MAX_SEQUENCE_LENGTH];
+    int length = 0;
+    while(length < MAX_SEQUENCE_LENGTH && isCons(cell)) {
+        Cell current = storage->getCons(cell);
+        cells[length] = cell;
+        ops[length] = current.car;
+        cell = current.cdr;
+        length++;
+    }
+
+    if (length >= 5 &&
+            ops[0] == SYMBOL_OP_LD &&
+            ops[2] == SYMBOL_OP_LDC)
+    {
+        if (length >= 7 && isRelation(ops[4]) && ops[5] == SYMBOL_OP_BT) {
+            // LD pos LDC k REL BT list -> TESTC pos k REL list
+            storage->setCAR(cells[0], SYMBOL_OP_TESTC);
+            storage->setCDR(cells[1], cells[3]);
+            storage->setCDR(cells[4], cells[6]);
+        } else if (ops[4] == SYMBOL_OP_ADD || ops[4] == SYMBOL_OP_SUB) {
+            // LD pos LDC k ADD -> LDADDC pos k
+            storage->setCAR(cells[0], ops[4] == SYMBOL_OP_ADD ?
+                                SYMBOL_OP_LDADDC : SYMBOL_OP_LDSUBC);
+            storage->setCDR(cells[1], cells[3]);
+            storage->setCDR(cells[3], storage->getCons(cells[4]).cdr);
+        }
+    } else if (length >= 4 &&
+               ops[0] == SYMBOL_OP_LDG &&
+               stackArguments(ops[2]) > 0)
+    {
+        // LDG global APn name -> CALLG global name n cache
+        // The cell of the APn holds the number of arguments. The cache and
+        // the cell which refers to it, are allocated while all cells are
+        // still reachable from the code.
+        Atom cache = storage->makeCons(NIL, NIL);
+        Atom cacheCell = storage->makeCons(cache,
+                                           storage->getCons(cells[3]).cdr);
+        storage->setCAR(cells[0], SYMBOL_OP_CALLG);
+        storage->setCDR(cells[1], cells[3]);
+        storage->setCDR(cells[3], cells[2]);
+        storage->setCAR(cells[2],
+                        storage->makeNumber(stackArguments(ops[2])));
+        storage->setCDR(cells[2], cacheCell);
+    } else if (length >= 5 &&
+               ops[0] == SYMBOL_OP_LDG &&
+               ops[2] == SYMBOL_OP_APV)
+    {
+        // LDG global APV n name -> CALLG global name n cache
+        // The cell of the APV holds the reference to the cache.
+        Atom cache = storage->makeCons(NIL, NIL);
+        Atom rest = storage->getCons(cells[4]).cdr;
+        storage->setCAR(cells[0], SYMBOL_OP_CALLG);
+        storage->setCDR(cells[1], cells[4]);
+        storage->setCDR(cells[4], cells[3]);
+        storage->setCDR(cells[3], cells[2]);
+        storage->setCAR(cells[2], cache);
+        storage->setCDR(cells[2], rest);
+    } else if (length >= 4 &&
+               ops[0] == SYMBOL_OP_LDG &&
+               ops[2] == SYMBOL_OP_AP0)
+    {
+        // LDG global AP0 name -> CALLG0 global name cache
+        // The cell of the AP0 holds the reference to the cache. All cells
+        // are still reachable from the code, when the cache is allocated.
+        Atom cache = storage->makeCons(NIL, NIL);
+        Atom rest = storage->getCons(cells[3]).cdr;
+        storage->setCAR(cells[0], SYMBOL_OP_CALLG0);
+        storage->setCDR(cells[1], cells[3]);
+        storage->setCDR(cells[3], cells[2]);
+        storage->setCAR(cells[2], cache);
+        storage->setCDR(cells[2], rest);
+    }
+}
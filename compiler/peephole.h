@@ -0,0 +1,107 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+/**
+  ---------------------------------------------------------------------------
+  Contains the peephole optimizer which is run over the generated bytecode.
+  ---------------------------------------------------------------------------
+  */
+
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "vm/env.h"
+#include "vm/storage.h"
+
+/**
+  Replaces frequently executed sequences of op codes by superinstructions.
+  The sequences were determined by running the SequenceProfiler (see
+  engine::setValue(#PROFILE_OP_SEQUENCES, #TRUE)) on typical workloads.
+
+  The following sequences are replaced:
+
+  #LD pos #LDC k #ADD                   -> #LDADDC pos k
+  #LD pos #LDC k #SUB                   -> #LDSUBC pos k
+  #LD pos #LDC k <relation> #BT list    -> #TESTC pos k <relation> list
+  #LDG global #AP<n> name               -> #CALLG global name n cache
+  #LDG global #APV n name               -> #CALLG global name n cache
+  #LDG global #AP0 name                 -> #CALLG0 global name cache
+
+  The cache of a #CALLG / #CALLG0 is a cons (version . fun) which is used by
+  the engine as inline cache for the called function. It starts out as
+  (NIL . NIL).
+
+  Additionally each function body is prefixed with #ENTRY 0, which counts
+  its invocations for the JitCompiler.
+
+  The optimizer mostly re-links the cells of the given code. Only the
+  inline caches and the #ENTRY prefixes require newly allocated cells.
+  */
+class PeepholeOptimizer
+{
+private:
+    /**
+      Contains the storage which contains the code.
+      */
+    Storage* storage;
+
+    /**
+      Maximal length of a sequence which is replaced.
+      */
+    static const int MAX_SEQUENCE_LENGTH = 7;
+
+    /**
+      Tries to replace the sequence starting at the given cell by a
+      superinstruction.
+      */
+    void fuse(Atom cell);
+
+    /**
+      Prefixes the function body stored in the car of the given cell with
+      #ENTRY 0.
+      */
+    void addEntry(Atom body);
+
+    /**
+      Returns the cell which is the given number of cells behind the given
+      one, or NIL if the list is too short.
+      */
+    Atom skip(Atom cell, int count);
+
+    /**
+      Determines if the given op code is a relation like #LT or #EQ.
+      */
+    bool isRelation(Atom opcode);
+
+    /**
+      Returns the number of arguments taken from the stack by the given
+      #AP1 .. #AP4 op code or 0 for any other op code.
+      */
+    int stackArguments(Atom opcode);
+
+public:
+    PeepholeOptimizer(Storage* storage) : storage(storage) {}
+
+    /**
+      Optimizes the given code list, including all nested functions
+      and branches.
+      */
+    void optimize(Atom code);
+};
+
+#endif // PEEPHOLE_H
@@ -0,0 +1,314 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+
+#include "verifier.h"
+
+bool Verifier::verify(Atom code) {
+    bool accepted = true;
+    std::vector<PendingCode> functions;
+    PendingCode topLevel;
+    topLevel.code = code;
+    topLevel.depth = 0;
+    functions.push_back(topLevel);
+    while(!functions.empty()) {
+        PendingCode function = functions.back();
+        functions.pop_back();
+        std::vector<Atom> cells;
+        if (verifyFunction(function.code, function.depth, cells, functions)) {
+            for(std::vector<Atom>::iterator i = cells.begin();
+                i != cells.end();
+                i++)
+            {
+                Atom cell = *i;
+                storage->setCAR(cell,
+                                uncheckedOpCode(storage->getCons(cell).car));
+            }
+        } else {
+            accepted = false;
+        }
+    }
+    return accepted;
+}
+
+bool Verifier::verifyFunction(Atom body,
+                              int envDepth,
+                              std::vector<Atom>& cells,
+                              std::vector<PendingCode>& functions)
+{
+    std::vector<PendingCode> paths;
+    PendingCode start;
+    start.code = body;
+    start.depth = 0;
+    paths.push_back(start);
+    while(!paths.empty()) {
+        PendingCode path = paths.back();
+        paths.pop_back();
+        if (!verifyPath(path.code,
+                        path.depth,
+                        envDepth,
+                        cells,
+                        paths,
+                        functions))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Verifier::isPosition(Atom pos, int envDepth) {
+    if (!isCons(pos)) {
+        return false;
+    }
+    Cell cell = storage->getCons(pos);
+    return isSmallNumber(cell.car) &&
+            isSmallNumber(cell.cdr) &&
+            untagSmallNumber(cell.car) >= 1 &&
+            untagSmallNumber(cell.car) <= envDepth &&
+            untagSmallNumber(cell.cdr) >= 1;
+}
+
+bool Verifier::isCount(Atom atom) {
+    return isSmallNumber(atom) && untagSmallNumber(atom) >= 0;
+}
+
+bool Verifier::verifyPath(Atom cell,
+                          int stackDepth,
+                          int envDepth,
+                          std::vector<Atom>& cells,
+                          std::vector<PendingCode>& paths,
+                          std::vector<PendingCode>& functions)
+{
+    while(isCons(cell)) {
+        Cell current = storage->getCons(cell);
+        Atom opcode = current.car;
+        Atom operands[4];
+        Atom next = current.cdr;
+        for(int n = 0; n < countOperands(opcode); n++) {
+            if (!isCons(next)) {
+                return false;
+            }
+            Cell operand = storage->getCons(next);
+            operands[n] = operand.car;
+            next = operand.cdr;
+        }
+        // Number of values taken from and put onto the stack...
+        int taken = 0;
+        int produced = 0;
+        switch(opcode) {
+        case SYMBOL_OP_RTN:
+        case SYMBOL_OP_STOP:
+            return true;
+        case SYMBOL_OP_NIL:
+        case SYMBOL_OP_LDC:
+            produced = 1;
+            break;
+        case SYMBOL_OP_LD:
+            if (!isPosition(operands[0], envDepth)) {
+                return false;
+            }
+            produced = 1;
+            break;
+        case SYMBOL_OP_ST:
+            if (!isPosition(operands[0], envDepth)) {
+                return false;
+            }
+            taken = 1;
+            produced = 1;
+            break;
+        case SYMBOL_OP_LDADDC:
+        case SYMBOL_OP_LDSUBC:
+            if (!isPosition(operands[0], envDepth)) {
+                return false;
+            }
+            produced = 1;
+            break;
+        case SYMBOL_OP_LDG:
+            if (!isGlobal(operands[0])) {
+                return false;
+            }
+            produced = 1;
+            break;
+        case SYMBOL_OP_STG:
+            if (!isGlobal(operands[0])) {
+                return false;
+            }
+            taken = 1;
+            produced = 1;
+            break;
+        case SYMBOL_OP_LDF: {
+            if (!isCons(operands[0])) {
+                return false;
+            }
+            PendingCode function;
+            function.code = operands[0];
+            function.depth = envDepth + 1;
+            functions.push_back(function);
+            produced = 1;
+            break;
+        }
+        case SYMBOL_OP_BT: {
+            if (!isCons(operands[0]) || stackDepth < 1) {
+                return false;
+            }
+            PendingCode branch;
+            branch.code = operands[0];
+            branch.depth = stackDepth - 1;
+            paths.push_back(branch);
+            taken = 1;
+            break;
+        }
+        case SYMBOL_OP_TESTC: {
+            if (!isPosition(operands[0], envDepth) || !isCons(operands[3])) {
+                return false;
+            }
+            switch(operands[2]) {
+            case SYMBOL_OP_EQ:
+            case SYMBOL_OP_NE:
+            case SYMBOL_OP_LT:
+            case SYMBOL_OP_GT:
+            case SYMBOL_OP_LTQ:
+            case SYMBOL_OP_GTQ:
+                break;
+            default:
+                return false;
+            }
+            PendingCode branch;
+            branch.code = operands[3];
+            branch.depth = stackDepth;
+            paths.push_back(branch);
+            break;
+        }
+        case SYMBOL_OP_AP:
+            taken = 2;
+            produced = 1;
+            break;
+        case SYMBOL_OP_AP0:
+            taken = 1;
+            produced = 1;
+            break;
+        case SYMBOL_OP_AP1:
+            taken = 2;
+            produced = 1;
+            break;
+        case SYMBOL_OP_AP2:
+            taken = 3;
+            produced = 1;
+            break;
+        case SYMBOL_OP_AP3:
+            taken = 4;
+            produced = 1;
+            break;
+        case SYMBOL_OP_AP4:
+            taken = 5;
+            produced = 1;
+            break;
+        case SYMBOL_OP_APV:
+            if (!isCount(operands[0])) {
+                return false;
+            }
+            taken = 1 + untagSmallNumber(operands[0]);
+            produced = 1;
+            break;
+        case SYMBOL_OP_CALLG:
+            if (!isGlobal(operands[0]) ||
+                    !isCount(operands[2]) ||
+                    !isCons(operands[3]))
+            {
+                return false;
+            }
+            taken = untagSmallNumber(operands[2]);
+            produced = 1;
+            break;
+        case SYMBOL_OP_CALLG0:
+            if (!isGlobal(operands[0]) || !isCons(operands[2])) {
+                return false;
+            }
+            produced = 1;
+            break;
+        case SYMBOL_OP_SPLIT:
+            for(int n = 0; n < 2; n++) {
+                if (!isNil(operands[n]) &&
+                        !isGlobal(operands[n]) &&
+                        !isPosition(operands[n], envDepth))
+                {
+                    return false;
+                }
+            }
+            taken = 1;
+            produced = 1;
+            break;
+        case SYMBOL_OP_LINE:
+        case SYMBOL_OP_ENTRY:
+            if (!isSmallNumber(operands[0])) {
+                return false;
+            }
+            break;
+        case SYMBOL_OP_FILE:
+            if (!isSymbol(operands[0])) {
+                return false;
+            }
+            break;
+        case SYMBOL_OP_NOOP:
+            break;
+        case SYMBOL_OP_CAR:
+        case SYMBOL_OP_CDR:
+        case SYMBOL_OP_NOT:
+        case SYMBOL_OP_CHAIN_END:
+            taken = 1;
+            produced = 1;
+            break;
+        case SYMBOL_OP_CONS:
+        case SYMBOL_OP_EQ:
+        case SYMBOL_OP_NE:
+        case SYMBOL_OP_LT:
+        case SYMBOL_OP_GT:
+        case SYMBOL_OP_LTQ:
+        case SYMBOL_OP_GTQ:
+        case SYMBOL_OP_ADD:
+        case SYMBOL_OP_SUB:
+        case SYMBOL_OP_MUL:
+        case SYMBOL_OP_DIV:
+        case SYMBOL_OP_REM:
+        case SYMBOL_OP_AND:
+        case SYMBOL_OP_OR:
+        case SYMBOL_OP_CONCAT:
+        case SYMBOL_OP_CHAIN:
+        case SYMBOL_OP_RPLCAR:
+        case SYMBOL_OP_RPLCDR:
+            taken = 2;
+            produced = 1;
+            break;
+        default:
+            // Unknown op codes, #JIT and unchecked variants are never
+            // generated by the compiler.
+            return false;
+        }
+        if (stackDepth < taken) {
+            return false;
+        }
+        stackDepth += produced - taken;
+        if (uncheckedOpCode(opcode) != opcode) {
+            cells.push_back(cell);
+        }
+        cell = next;
+    }
+    // The end of the list was reached without #RTN or #STOP
+    return false;
+}
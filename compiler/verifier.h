@@ -0,0 +1,117 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+/**
+  ---------------------------------------------------------------------------
+  Contains the verifier which checks the generated bytecode.
+  ---------------------------------------------------------------------------
+  */
+
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include "vm/env.h"
+#include "vm/storage.h"
+
+#include <vector>
+
+/**
+  Checks compiled code, so that the engine can skip redundant checks when
+  executing it.
+
+  Each function body (and the top level code) is verified on its own by
+  following all paths through it - the fall through and the branch taken
+  by #BT and #TESTC. A function body is accepted if:
+
+  - all paths end in #RTN or #STOP
+  - each op code is known and followed by all of its operands
+  - no op code takes more values from the stack than are present on it.
+    Each body starts with an empty stack.
+  - all positions (i . j) consist of two small numbers, where i refers to
+    an enclosing function and j is positive
+  - all operands of #LDG, #STG, #CALLG and #CALLG0 are globals and all
+    operands of #LINE and #ENTRY are small numbers
+  - all branch targets and nested function bodies are lists
+
+  The op codes of an accepted body are replaced by their unchecked variants
+  (see uncheckedOpCode). Rejected bodies remain on the checked path, as do
+  hand written code lists (like setHead in lib/pimii.pi), since they are
+  never passed through the compiler (unless engine::verify is called).
+
+  The verifier runs after the PeepholeOptimizer and doesn't allocate any
+  memory.
+  */
+class Verifier
+{
+private:
+    /**
+      Contains the storage which contains the code.
+      */
+    Storage* storage;
+
+    /**
+      Describes a code list which is still to be verified.
+      */
+    struct PendingCode {
+        Atom code;
+        int depth;
+    };
+
+    /**
+      Verifies the given function body, which is nested in envDepth
+      functions. Cells which can be replaced by unchecked variants are added
+      to cells, nested function bodies are added to functions.
+      */
+    bool verifyFunction(Atom body,
+                        int envDepth,
+                        std::vector<Atom>& cells,
+                        std::vector<PendingCode>& functions);
+
+    /**
+      Verifies the path starting at the given cell with the given stack
+      depth until the next #RTN or #STOP. Branch targets are added to paths.
+      */
+    bool verifyPath(Atom cell,
+                    int stackDepth,
+                    int envDepth,
+                    std::vector<Atom>& cells,
+                    std::vector<PendingCode>& paths,
+                    std::vector<PendingCode>& functions);
+
+    /**
+      Determines if the given atom is a valid position (i . j) within a
+      function nested in envDepth functions.
+      */
+    bool isPosition(Atom pos, int envDepth);
+
+    /**
+      Determines if the given atom is a small number which isn't negative.
+      */
+    bool isCount(Atom atom);
+
+public:
+    Verifier(Storage* storage) : storage(storage) {}
+
+    /**
+      Verifies the given code list and all nested functions. Returns true if
+      all of them were accepted.
+      */
+    bool verify(Atom code);
+};
+
+#endif // VERIFIER_H
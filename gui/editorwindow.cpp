@@ -26,6 +26,13 @@ EditorWindow::EditorWindow(Engine* engine, QWidget *parent) :
 }
 
 void EditorWindow::append(const QString& msg, const QString&) {
+    QMetaObject::invokeMethod(this,
+                              "appendToConsole",
+                              Qt::QueuedConnection,
+                              Q_ARG(QString, msg));
+}
+
+void EditorWindow::appendToConsole(const QString& msg) {
     ui->console->insertPlainText(msg);
     ui->console->insertPlainText("\n");
     ui->console->verticalScrollBar()->setSliderPosition(
@@ -90,6 +97,11 @@ void EditorWindow::on_action_Quit_triggered()
     qApp->quit();
 }
 
+void EditorWindow::on_action_Terminate_Execution_triggered()
+{
+    engine->fullstop();
+}
+
 void EditorWindow::on_action_Save_triggered()
 {
     if (!currentFile.isEmpty()) {
@@ -172,3 +184,20 @@ void EditorWindow::on_actionLaTex_triggered()
     append(output,"");
     QApplication::clipboard()->setText(output);
 }
+
+void EditorWindow::on_actionSample_Profile_toggled(bool checked)
+{
+    SamplingProfiler* profiler = engine->getSamplingProfiler();
+    if (checked) {
+        profiler->start(TUNING_PARAM_SAMPLING_INTERVAL);
+        return;
+    }
+    profiler->stop();
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                    tr("Save Profile"),
+                                                    "",
+                                                    "Folded Stacks (*.folded)");
+    if (!fileName.isEmpty()) {
+        profiler->writeFoldedStacks(fileName);
+    }
+}
@@ -45,6 +45,16 @@ private slots:
 
     void on_actionLaTex_triggered();
 
+    void on_actionSample_Profile_toggled(bool checked);
+
+    void on_action_Terminate_Execution_triggered();
+
+    /**
+      Appends the given message to the console. Invoked via a queued
+      connection, as log messages are also created by the engine thread.
+      */
+    void appendToConsole(const QString& msg);
+
 private:
     Ui::EditorWindow* ui;
     Highlighter* highlighter;
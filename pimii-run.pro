@@ -0,0 +1,18 @@
+#-------------------------------------------------
+#
+# Command line runner: Executes pimii scripts without any UI.
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = pimii-run
+TEMPLATE = app
+
+CONFIG   += console
+CONFIG   -= app_bundle
+
+include(pimii.pri)
+
+SOURCES += runner/main.cpp
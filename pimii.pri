@@ -0,0 +1,81 @@
+#-------------------------------------------------
+#
+# Contains the VM, compiler and built-in functions which are shared by
+# pimii.pro (the editor) and pimii-run.pro (the command line runner).
+#
+#-------------------------------------------------
+
+QMAKE_CXXFLAGS += -Wall
+
+# Build with "qmake CONFIG+=profiling" to enable the op profiler
+# (see #PROFILE_OPS and #OP_PROFILE).
+profiling {
+    DEFINES += OP_PROFILING
+}
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/vm/engine.cpp \
+    $$PWD/vm/storage.cpp \
+    $$PWD/compiler/tokenizer.cpp \
+    $$PWD/compiler/compiler.cpp \
+    $$PWD/bif/coreextension.cpp \
+    $$PWD/bif/filesextension.cpp \
+    $$PWD/bif/coroutineextension.cpp \
+    $$PWD/bif/parallelextension.cpp \
+    $$PWD/bif/dataextension.cpp \
+    $$PWD/bif/regexextension.cpp \
+    $$PWD/bif/vectorextension.cpp \
+    $$PWD/tools/logger.cpp \
+    $$PWD/vm/profiler.cpp \
+    $$PWD/vm/jit.cpp \
+    $$PWD/vm/symboltable.cpp \
+    $$PWD/vm/submissionqueue.cpp \
+    $$PWD/vm/enginethread.cpp \
+    $$PWD/vm/coroutine.cpp \
+    $$PWD/vm/copier.cpp \
+    $$PWD/vm/isolatepool.cpp \
+    $$PWD/vm/asyncoperation.cpp \
+    $$PWD/vm/mappedfile.cpp \
+    $$PWD/vm/jsonparser.cpp \
+    $$PWD/vm/csvparser.cpp \
+    $$PWD/compiler/peephole.cpp \
+    $$PWD/compiler/verifier.cpp
+
+HEADERS += \
+    $$PWD/vm/engine.h \
+    $$PWD/vm/lookuptable.h \
+    $$PWD/vm/valuetable.h \
+    $$PWD/vm/storage.h \
+    $$PWD/vm/env.h \
+    $$PWD/compiler/tokenizer.h \
+    $$PWD/compiler/compiler.h \
+    $$PWD/vm/reference.h \
+    $$PWD/bif/coreextension.h \
+    $$PWD/bif/filesextension.h \
+    $$PWD/bif/coroutineextension.h \
+    $$PWD/bif/parallelextension.h \
+    $$PWD/bif/dataextension.h \
+    $$PWD/bif/regexextension.h \
+    $$PWD/bif/vectorextension.h \
+    $$PWD/bif/engineextension.h \
+    $$PWD/bif/callcontext.h \
+    $$PWD/tools/logger.h \
+    $$PWD/tools/average.h \
+    $$PWD/vm/array.h \
+    $$PWD/vm/profiler.h \
+    $$PWD/vm/jit.h \
+    $$PWD/vm/symboltable.h \
+    $$PWD/vm/submissionqueue.h \
+    $$PWD/vm/enginethread.h \
+    $$PWD/vm/coroutine.h \
+    $$PWD/vm/copier.h \
+    $$PWD/vm/isolatepool.h \
+    $$PWD/vm/asyncoperation.h \
+    $$PWD/vm/mappedfile.h \
+    $$PWD/vm/sequence.h \
+    $$PWD/vm/jsonparser.h \
+    $$PWD/vm/csvparser.h \
+    $$PWD/compiler/peephole.h \
+    $$PWD/compiler/verifier.h
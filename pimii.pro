@@ -6,41 +6,19 @@
 
 QT       += core gui
 
-QMAKE_CXXFLAGS += -Wall
-
 TARGET = pimii
 TEMPLATE = app
 
+include(pimii.pri)
+
 SOURCES += main.cpp \
-    vm/engine.cpp \
-    vm/storage.cpp \
-    compiler/tokenizer.cpp \
-    compiler/compiler.cpp \
     gui/highlighter.cpp \
-    bif/coreextension.cpp \
-    bif/filesextension.cpp \
-    tools/logger.cpp \
     gui/editorwindow.cpp \
     gui/codeedit.cpp
 
 HEADERS += \
-    vm/engine.h \
-    vm/lookuptable.h \
-    vm/valuetable.h \
-    vm/storage.h \
-    vm/env.h \
-    compiler/tokenizer.h \
-    compiler/compiler.h \
     gui/highlighter.h \
-    vm/reference.h \
-    bif/coreextension.h \
-    bif/filesextension.h \
-    bif/engineextension.h \
-    bif/callcontext.h \
-    tools/logger.h \
-    tools/average.h \
     gui/editorwindow.h \
-    vm/array.h \
     gui/codeedit.h
 
 OTHER_FILES += \
@@ -66,36 +44,3 @@ RESOURCES += \
     gui/resources.qrc
 
 ICON = gui/pimii.icns
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
@@ -0,0 +1,295 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+/**
+  ---------------------------------------------------------------------------
+  Contains the command line runner "pimii-run" which executes scripts without
+  any UI:
+
+    pimii-run [--stats] [--no-start] [--parallel]
+              [-e expression | script.pi]...
+
+  Scripts and expressions are executed in the given order, after the
+  startup script (start.pi) unless --no-start is given. The results of
+  expressions are logged. All log output is written to stdout.
+
+  With --parallel, each script or expression is executed in its own
+  isolate (an engine with its own storage, started with a fresh start.pi).
+  The isolates are run by one thread per core.
+
+  The exit code is 0 if everything was executed, 1 if a compilation error
+  or a panic occurred (remaining scripts of the isolate are skipped) and 2
+  for invalid arguments or unreadable files.
+
+  With --stats, the number of executed op codes, garbage collections and
+  the time spent are printed to stderr on exit, one "KEY: value" pair per
+  line, so that stdout only contains the output of the scripts. The values
+  are summed up over all isolates.
+  ---------------------------------------------------------------------------
+  */
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QThread>
+#include <QAtomicInt>
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include "vm/engine.h"
+#include "tools/logger.h"
+
+const int EXIT_PANIC = 1;
+const int EXIT_USAGE = 2;
+
+/**
+  Represents a script or an expression given on the command line.
+  */
+struct Task {
+    QString filename;
+    QString source;
+    bool printStackTop;
+};
+
+/**
+  Collects the statistics reported by --stats.
+  */
+struct Statistics {
+    Word isolates;
+    Word opCount;
+    Word gcCount;
+    qint64 gcTime;
+    Word totalCells;
+    Word cellsUsed;
+};
+
+void printUsage() {
+    std::cerr << "Usage: pimii-run [--stats] [--no-start] [--parallel] "
+              << "[-e expression | script.pi]..." << std::endl;
+}
+
+/**
+  Executes everything submitted to the engine, including the continuations
+  of pending asynchronous operations, and reports if this completed without
+  a panic.
+  */
+bool runEngine(Engine& engine) {
+    Word panics = engine.getPanicCount();
+    while (engine.isRunnable() || engine.hasPendingOperations()) {
+        if (engine.isRunnable()) {
+            engine.interpret();
+        } else {
+            engine.waitForSubmissions();
+        }
+    }
+    return engine.getPanicCount() == panics;
+}
+
+/**
+  Executes the given tasks in a new isolate and adds its statistics to the
+  given ones. Returns the exit code.
+  */
+int execute(const std::vector<Task>& tasks,
+            bool startScript,
+            Statistics* stats)
+{
+    QSettings settings("pimii","pimii");
+    Engine engine(&settings);
+    engine.setHeadless(true);
+    engine.initialize();
+
+    int result = 0;
+    if (startScript) {
+        engine.loadStartupScript();
+        if (!runEngine(engine)) {
+            result = EXIT_PANIC;
+        }
+    }
+    for (std::vector<Task>::const_iterator i = tasks.begin();
+         result == 0 && i != tasks.end();
+         ++i)
+    {
+        // Compiled here (instead of using eval) so that compilation errors
+        // can be detected.
+        Atom code = engine.compileSource(i->filename, i->source, true, false);
+        if (code == NIL) {
+            result = EXIT_PANIC;
+        } else {
+            engine.evalFn(i->filename, code, i->printStackTop);
+            if (!runEngine(engine)) {
+                result = EXIT_PANIC;
+            }
+        }
+    }
+
+    Storage* storage = engine.getStorage();
+    stats->isolates++;
+    stats->opCount += engine.getInstructionCount();
+    stats->gcCount += storage->statusNumGC();
+    stats->gcTime += storage->statusGCTime();
+    stats->totalCells += storage->statusTotalCells();
+    stats->cellsUsed += storage->statusCellsUsed();
+    return result;
+}
+
+/**
+  Executes tasks in isolates, as long as there are tasks left. Each task
+  gets its own isolate. Several workers share the list of tasks.
+  */
+class Worker : public QThread
+{
+private:
+    const std::vector<Task>* tasks;
+    QAtomicInt* nextTask;
+    bool startScript;
+
+    Q_DISABLE_COPY(Worker)
+public:
+    int result;
+    Statistics stats;
+
+    Worker(const std::vector<Task>* tasks,
+           QAtomicInt* nextTask,
+           bool startScript) :
+        tasks(tasks), nextTask(nextTask), startScript(startScript), result(0)
+    {
+        Statistics empty = {0, 0, 0, 0, 0, 0};
+        stats = empty;
+    }
+
+protected:
+    virtual void run() {
+        int index = nextTask->fetchAndAddOrdered(1);
+        while (index < static_cast<int>(tasks->size())) {
+            std::vector<Task> isolated(1, tasks->at(index));
+            int code = execute(isolated, startScript, &stats);
+            if (code > result) {
+                result = code;
+            }
+            index = nextTask->fetchAndAddOrdered(1);
+        }
+    }
+};
+
+double toMillis(qint64 nanos) {
+    return nanos / 1000000.0;
+}
+
+void printStats(const Statistics& stats, qint64 elapsed) {
+    std::cerr << std::fixed << std::setprecision(3)
+              << "ISOLATES: " << stats.isolates << std::endl
+              << "OP_COUNT: " << stats.opCount << std::endl
+              << "GC_COUNT: " << stats.gcCount << std::endl
+              << "GC_TIME_MS: " << toMillis(stats.gcTime) << std::endl
+              << "NUM_TOTAL_CELLS: " << stats.totalCells << std::endl
+              << "NUM_CELLS_USED: " << stats.cellsUsed << std::endl
+              << "TOTAL_TIME_MS: " << toMillis(elapsed) << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QStringList arguments = a.arguments();
+    arguments.removeFirst();
+
+    bool stats = false;
+    bool startScript = true;
+    bool parallel = false;
+    std::vector<Task> tasks;
+    for (int i = 0; i < arguments.size(); ++i) {
+        QString arg = arguments.at(i);
+        if (arg == "--stats") {
+            stats = true;
+        } else if (arg == "--no-start") {
+            startScript = false;
+        } else if (arg == "--parallel") {
+            parallel = true;
+        } else if (arg == "-e") {
+            if (++i >= arguments.size()) {
+                printUsage();
+                return EXIT_USAGE;
+            }
+            Task task;
+            task.filename = "-e";
+            task.source = arguments.at(i);
+            task.printStackTop = true;
+            tasks.push_back(task);
+        } else if (arg.startsWith("-")) {
+            printUsage();
+            return EXIT_USAGE;
+        } else {
+            QFile file(arg);
+            if (!file.open(QFile::ReadOnly | QFile::Text)) {
+                std::cerr << "Cannot open: " << arg.toStdString()
+                          << std::endl;
+                return EXIT_USAGE;
+            }
+            Task task;
+            task.filename = QFileInfo(arg).fileName();
+            task.source = file.readAll();
+            task.printStackTop = false;
+            tasks.push_back(task);
+        }
+    }
+    if (tasks.empty()) {
+        printUsage();
+        return EXIT_USAGE;
+    }
+
+    Logger::setLevel(INFO);
+    QElapsedTimer watch;
+    watch.start();
+    int result = 0;
+    Statistics total = {0, 0, 0, 0, 0, 0};
+    if (!parallel) {
+        result = execute(tasks, startScript, &total);
+    } else {
+        QAtomicInt nextTask(0);
+        int numWorkers = qMin(QThread::idealThreadCount(),
+                              static_cast<int>(tasks.size()));
+        std::vector<Worker*> workers;
+        for (int i = 0; i < numWorkers; ++i) {
+            workers.push_back(new Worker(&tasks, &nextTask, startScript));
+            workers.back()->start();
+        }
+        for (std::vector<Worker*>::iterator i = workers.begin();
+             i != workers.end();
+             ++i)
+        {
+            Worker* worker = *i;
+            worker->wait();
+            result = qMax(result, worker->result);
+            total.isolates += worker->stats.isolates;
+            total.opCount += worker->stats.opCount;
+            total.gcCount += worker->stats.gcCount;
+            total.gcTime += worker->stats.gcTime;
+            total.totalCells += worker->stats.totalCells;
+            total.cellsUsed += worker->stats.cellsUsed;
+            delete worker;
+        }
+    }
+
+    if (stats) {
+        printStats(total, watch.nsecsElapsed());
+    }
+    return result;
+}
@@ -18,13 +18,17 @@
  */
 
 #include "logger.h"
+
+#include <QMutexLocker>
 #include <sstream>
 #include <string>
 #include <iostream>
 
 std::set<Appender*> Logger::appenders;
+QMutex Logger::lock;
 Level Logger::level;
 void Logger::log(const QString& msg, const QString& pos) {
+    QMutexLocker locker(&lock);
     for(std::set<Appender*>::iterator
         iter = appenders.begin();
         iter != appenders.end();
@@ -39,10 +43,12 @@ void Logger::log(const QString& msg, const QString& pos) {
 
 
 void Logger::addAppender(Appender* a) {
+    QMutexLocker locker(&lock);
     appenders.insert(a);
 }
 
 void Logger::removeAppender(Appender* a) {
+    QMutexLocker locker(&lock);
     appenders.erase(a);
 }
 
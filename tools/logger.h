@@ -32,6 +32,7 @@
 
 #include <QString>
 #include <QTextStream>
+#include <QMutex>
 #include <iostream>
 #include <set>
 #include <map>
@@ -85,6 +86,12 @@ private:
       */
     static std::set<Appender*> appenders;
 
+    /**
+      Protects the appenders and the console output, as several engines
+      might log concurrently.
+      */
+    static QMutex lock;
+
     /**
       A Logger cannot be copied.
       */
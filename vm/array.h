@@ -26,25 +26,89 @@
 
 #include "env.h"
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include <vector>
 
 #include <QSharedPointer>
+#include <QSharedData>
+
+/**
+  Contains the elements of one or more arrays. An array and its slices
+  (see Array::slice) share one buffer until one of them is modified.
+  */
+class ArrayBuffer : public QSharedData {
+private:
+    Q_DISABLE_COPY(ArrayBuffer)
+public:
+    int length;
+    Atom* data;
+
+    ArrayBuffer(int size) {
+        data = (Atom*)malloc(size * sizeof(Atom));
+        for(int i = 0; i < size; i++) {
+            data[i] = NIL;
+        }
+        length = size;
+    }
+
+    ~ArrayBuffer() {
+        free(data);
+    }
+};
 
 /**
   Represents an array of Atoms with fast random access. In contrast to C arrays
   this class uses 1 for the first index of the array!
+
+  An array can also be a slice of another array. In this case it is a window
+  (offset and length) on the buffer of the parent, so that no elements are
+  copied. The first write to either of them copies the affected range into
+  a buffer of its own (copy on write). Therefore a slice behaves as if it
+  were a copy of the parent, and the buffer is kept alive as long as it is
+  in use.
   */
 class Array {
 private:
+    QExplicitlySharedDataPointer<ArrayBuffer> buffer;
+    int _offset;
     int _length;
-    Atom* _data;
 
-    void ensureSize(int minSize) {
-        if (_length <= minSize) {
-            _data = (Atom*)realloc(_data, minSize * sizeof(Atom));
-            for(int i = _length; i < minSize; i++) {
-                _data[i] = NIL;
+    /**
+      Makes sure that the array has its own buffer with at least the given
+      size, by copying its elements if necessary.
+      */
+    void detach(int minSize) {
+        int size = std::max(minSize, _length);
+        if (buffer->ref == 1 && _offset == 0 && buffer->length == _length) {
+            if (size > _length) {
+                buffer->data = (Atom*)realloc(buffer->data,
+                                              size * sizeof(Atom));
+                for(int i = _length; i < size; i++) {
+                    buffer->data[i] = NIL;
+                }
+                buffer->length = size;
+                _length = size;
             }
-            _length = minSize;
+            return;
+        }
+        ArrayBuffer* copy = new ArrayBuffer(size);
+        memcpy(copy->data, buffer->data + _offset, _length * sizeof(Atom));
+        buffer = QExplicitlySharedDataPointer<ArrayBuffer>(copy);
+        _offset = 0;
+        _length = size;
+    }
+
+    /**
+      Points to the list of arrays which were written after they were
+      checked by the garbage collector. See put.
+      */
+    std::vector<Array*>* dirtyArrays;
+
+    void ensureSize(int minSize) {
+        if (_length < minSize) {
+            detach(minSize);
         }
     }
 /**
@@ -56,31 +120,55 @@ sys::log(x);
 public:
     /**
       Used by the garbage collector to avoid double-checking of arrays.
+      This is reset by the first write after the array was checked.
       */
     bool checked;
 
-    Array(int size) {
-        _data = (Atom*)malloc(size* sizeof(Atom));
-        for(int i = 0; i < size; i++) {
-            _data[i] = NIL;
-        }
-        _length = size;
-    }
+    /**
+      Creates an array with the given size. Arrays which are written after
+      they were checked by the garbage collector are appended to the given
+      list, so that a minor GC can check them again.
+      */
+    Array(int size, std::vector<Array*>* dirtyArrays) :
+        buffer(new ArrayBuffer(size)),
+        _offset(0),
+        _length(size),
+        dirtyArrays(dirtyArrays),
+        checked(false) {}
 
-    ~Array() {
-        delete _data;
+    /**
+      Creates a slice of the given array which contains length elements,
+      starting at the given position (starting at 1). The range must be
+      within the given array.
+      */
+    Array(Array* parent, int pos, int length) : buffer(parent->buffer),
+        _offset(parent->_offset + pos - 1),
+        _length(length),
+        dirtyArrays(parent->dirtyArrays),
+        checked(false)
+    {
+        assert(pos >= 1 && length >= 0 && pos - 1 + length <= parent->_length);
     }
 
     Atom at(int pos) {
         assert(pos >= 1);
         ensureSize(pos);
-        return _data[pos - 1];
+        return buffer->data[_offset + pos - 1];
     }
 
     void put(int pos, Atom value) {
         assert(pos >= 1);
-        ensureSize(pos);
-        _data[pos - 1] = value;
+        if (buffer->ref != 1 || _length < pos) {
+            detach(pos);
+        }
+        buffer->data[_offset + pos - 1] = value;
+        // A minor GC doesn't revisit checked cells and arrays. Therefore
+        // the value would be invisible to it, unless this array is checked
+        // again.
+        if (checked) {
+            checked = false;
+            dirtyArrays->push_back(this);
+        }
     }
 
     int length() {
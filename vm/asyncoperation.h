@@ -0,0 +1,89 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+/**
+  ---------------------------------------------------------------------------
+  Contains the base class of blocking operations which are performed in the
+  background.
+  ---------------------------------------------------------------------------
+  */
+#ifndef ASYNCOPERATION_H
+#define ASYNCOPERATION_H
+
+#include "vm/env.h"
+#include "vm/storage.h"
+
+#include <QRunnable>
+
+class Engine;
+
+/**
+  A blocking operation of a built in function, like reading a file. It is
+  performed by a thread of the async pool of the engine (see
+  Engine::runAsync), so that the engine continues to execute other work
+  meanwhile.
+
+  Once perform() is done, the operation is passed back to the engine via
+  its SubmissionQueue. The engine thread then calls makeArguments() and
+  applies the continuation (the function given to the built in function)
+  to them. Therefore only makeArguments() may access the storage.
+  */
+class AsyncOperation : public QRunnable
+{
+private:
+    Engine* engine;
+
+    /**
+      Contains the function to apply once the operation is completed.
+      */
+    AtomRef* continuation;
+
+    /**
+      Contains the generation of the engine when the operation was started.
+      */
+    Word generation;
+
+    friend class Engine;
+
+    Q_DISABLE_COPY(AsyncOperation)
+public:
+    AsyncOperation() : engine(NULL), continuation(NULL), generation(0) {
+        // Deleted by the engine once the continuation was scheduled.
+        setAutoDelete(false);
+    }
+
+    virtual ~AsyncOperation() {}
+
+    /**
+      Performs the operation. Called by a thread of the async pool.
+      */
+    virtual void perform() = 0;
+
+    /**
+      Creates the list of arguments for the continuation. Called by the
+      engine thread.
+      */
+    virtual Atom makeArguments(Storage* storage) = 0;
+
+    /**
+      Performs the operation and passes it back to the engine.
+      */
+    virtual void run();
+};
+
+#endif // ASYNCOPERATION_H
@@ -0,0 +1,121 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+#include "vm/copier.h"
+
+Copier::Copier(Storage* source, Storage* target) :
+    source(source), target(target)
+{
+    target->invalidateForeignCaches(source);
+}
+
+bool Copier::copy(Atom atom, AtomRef* result) {
+    schedule(atom, NIL, 0);
+    // Each copy is stored in its (already referenced) parent right after it
+    // was created. Therefore a GC in the target never frees a partial copy.
+    while(!pending.empty()) {
+        Pending entry = pending.back();
+        pending.pop_back();
+        Atom copy = NIL;
+        if (!translate(entry.value, &copy)) {
+            pending.clear();
+            return false;
+        }
+        store(entry, copy, result);
+    }
+    return true;
+}
+
+void Copier::schedule(Atom value, Atom parent, Word slot) {
+    Pending entry;
+    entry.value = value;
+    entry.parent = parent;
+    entry.slot = slot;
+    pending.push_back(entry);
+}
+
+bool Copier::translate(Atom value, Atom* result) {
+    std::map<Atom, Atom>::iterator iter = copies.find(value);
+    if (iter != copies.end()) {
+        *result = iter->second;
+        return true;
+    }
+    if (isCons(value)) {
+        *result = target->makeCons(NIL, NIL);
+        copies[value] = *result;
+        Cell cell = source->getCons(value);
+        // Native code is specific to the JIT of the source engine. Therefore
+        // a block prefixed by #JIT index is copied in its interpreted form
+        // and the counter of an #ENTRY is reset...
+        while(cell.car == SYMBOL_OP_JIT && isCons(cell.cdr)) {
+            cell = source->getCons(source->getCons(cell.cdr).cdr);
+        }
+        if (cell.car == SYMBOL_OP_ENTRY && isCons(cell.cdr)) {
+            counters.insert(cell.cdr);
+        }
+        if (counters.find(value) != counters.end()) {
+            cell.car = target->makeNumber(0);
+        }
+        schedule(cell.cdr, *result, SLOT_CDR);
+        schedule(cell.car, *result, SLOT_CAR);
+    } else if (isGlobal(value)) {
+        *result = target->findGlobal(source->getGlobalSymbol(value));
+        copies[value] = *result;
+        Atom globalValue = source->readGlobal(value);
+        if (globalValue != NIL) {
+            schedule(globalValue, *result, 0);
+        }
+    } else if (isString(value)) {
+        *result = target->makeString(source->getString(value));
+    } else if (isLargeNumber(value)) {
+        *result = target->makeNumber(source->getNumber(value));
+    } else if (isDecimalNumber(value)) {
+        *result = target->makeDecimal(source->getDecimal(value));
+    } else if (isArray(value)) {
+        Array* array = source->getArray(value);
+        *result = target->makeArray(array->length());
+        copies[value] = *result;
+        for(int i = array->length(); i >= 1; i--) {
+            schedule(array->at(i), *result, i);
+        }
+    } else if (isReference(value)) {
+        error = QString("A reference cannot be copied: %1").
+                arg(source->getReference(value)->toString());
+        return false;
+    } else {
+        // NIL, symbols, small numbers and built in functions are the same
+        // in each storage.
+        *result = value;
+    }
+    return true;
+}
+
+void Copier::store(const Pending& entry, Atom copy, AtomRef* result) {
+    if (entry.parent == NIL) {
+        result->atom(copy);
+    } else if (isGlobal(entry.parent)) {
+        target->writeGlobal(entry.parent, copy);
+    } else if (isArray(entry.parent)) {
+        Array* array = target->getArray(entry.parent);
+        array->put(entry.slot, copy);
+    } else if (entry.slot == SLOT_CAR) {
+        target->setCAR(entry.parent, copy);
+    } else {
+        target->setCDR(entry.parent, copy);
+    }
+}
@@ -0,0 +1,131 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+/**
+  ---------------------------------------------------------------------------
+  Contains the copier which transfers data from one storage to another.
+  ---------------------------------------------------------------------------
+  */
+#ifndef COPIER_H
+#define COPIER_H
+
+#include "vm/env.h"
+#include "vm/storage.h"
+
+#include <QString>
+
+#include <map>
+#include <set>
+#include <vector>
+
+/**
+  Deep-copies atoms from one storage (isolate) into another.
+
+  Cells, strings, large and decimal numbers and arrays are duplicated in the
+  target storage. Shared structures (and cycles) remain shared within the
+  copy, as long as the same copier is used. Symbols and built in functions
+  are the same in all storages and therefore not copied.
+
+  A global is mapped to the global with the same name in the target. Its
+  value is copied along, so that a closure finds the functions and values
+  it refers to. References cannot be copied, as they are not thread safe.
+  Code which was compiled by the JIT of the source engine is copied in its
+  interpreted form.
+
+  A copier must only be used while no other thread accesses one of both
+  storages.
+  */
+class Copier
+{
+private:
+    /**
+      Represents a value which is still to be copied. Once the copy is
+      created, it is stored in the given slot of the parent.
+      */
+    struct Pending {
+        Atom value;
+        Atom parent;
+        Word slot;
+    };
+
+    /**
+      Selects the car or cdr of a parent cell. For a parent array, the
+      slot contains the index (starting with 1). It is ignored for a parent
+      global and for the result itself (parent is NIL).
+      */
+    enum Slot { SLOT_CAR, SLOT_CDR };
+
+    Storage* source;
+    Storage* target;
+
+    /**
+      Maps already copied cells, arrays and globals to their copies.
+      */
+    std::map<Atom, Atom> copies;
+
+    /**
+      Contains the counter cells of #ENTRY op codes.
+      */
+    std::set<Atom> counters;
+
+    /**
+      Contains the values which are still to be copied.
+      */
+    std::vector<Pending> pending;
+
+    /**
+      Contains the error of the last failed copy.
+      */
+    QString error;
+
+    /**
+      Schedules the given value to be copied into the given slot.
+      */
+    void schedule(Atom value, Atom parent, Word slot);
+
+    /**
+      Creates the (still empty) copy of the given value and schedules its
+      contents to be copied.
+      */
+    bool translate(Atom value, Atom* result);
+
+    /**
+      Stores a copied value in its slot.
+      */
+    void store(const Pending& entry, Atom copy, AtomRef* result);
+
+    Q_DISABLE_COPY(Copier)
+public:
+    Copier(Storage* source, Storage* target);
+
+    /**
+      Copies the given atom. The copy is stored in result, so that it is
+      kept referenced. Returns false if the value cannot be copied, see
+      getError().
+      */
+    bool copy(Atom atom, AtomRef* result);
+
+    /**
+      Returns the reason why the last copy failed.
+      */
+    QString getError() {
+        return error;
+    }
+};
+
+#endif // COPIER_H
@@ -0,0 +1,133 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+
+#include "vm/coroutine.h"
+#include "vm/engine.h"
+
+Coroutine::Coroutine(Storage* storage, bool root) :
+    storage(storage),
+    s(storage->ref(NIL)),
+    e(storage->ref(NIL)),
+    c(storage->ref(NIL)),
+    d(storage->ref(NIL)),
+    p(storage->ref(NIL)),
+    a(storage->ref(NIL)),
+    currentFile(NIL),
+    currentLine(0),
+    root(root),
+    finished(false),
+    result(storage->ref(NIL)),
+    hasResumeValue(false),
+    resumeValue(storage->ref(NIL)),
+    blockedOn(NULL)
+{
+}
+
+Coroutine::~Coroutine() {
+    delete s;
+    delete e;
+    delete c;
+    delete d;
+    delete p;
+    delete a;
+    delete result;
+    delete resumeValue;
+}
+
+void Coroutine::clearRegisters() {
+    s->atom(NIL);
+    e->atom(NIL);
+    c->atom(NIL);
+    d->atom(NIL);
+    p->atom(NIL);
+    a->atom(NIL);
+    resumeValue->atom(NIL);
+    hasResumeValue = false;
+}
+
+Channel::~Channel() {
+    clear();
+}
+
+void Channel::clear() {
+    for(std::deque<AtomRef*>::iterator i = values.begin();
+        i != values.end();
+        ++i)
+    {
+        delete *i;
+    }
+    values.clear();
+    for(std::deque< QSharedPointer<Coroutine> >::iterator
+        i = senders.begin();
+        i != senders.end();
+        ++i)
+    {
+        (*i)->blockedOn = NULL;
+    }
+    senders.clear();
+    for(std::deque< QSharedPointer<Coroutine> >::iterator
+        i = receivers.begin();
+        i != receivers.end();
+        ++i)
+    {
+        (*i)->blockedOn = NULL;
+    }
+    receivers.clear();
+}
+
+void Channel::send(Engine* engine, Atom value) {
+    if (!receivers.empty()) {
+        QSharedPointer<Coroutine> receiver = receivers.front();
+        receivers.pop_front();
+        receiver->blockedOn = NULL;
+        engine->resume(receiver, value);
+        return;
+    }
+    values.push_back(storage->ref(value));
+    if (values.size() > capacity) {
+        senders.push_back(engine->getCurrentCoroutine());
+        senders.back()->blockedOn = this;
+        engine->suspend();
+    }
+}
+
+bool Channel::receive(Engine* engine, Atom* result) {
+    if (values.empty()) {
+        receivers.push_back(engine->getCurrentCoroutine());
+        receivers.back()->blockedOn = this;
+        engine->suspend();
+        return false;
+    }
+    AtomRef* value = values.front();
+    values.pop_front();
+    *result = value->atom();
+    delete value;
+    // The value of the oldest waiting sender now fits into the buffer...
+    if (!senders.empty()) {
+        QSharedPointer<Coroutine> sender = senders.front();
+        senders.pop_front();
+        sender->blockedOn = NULL;
+        engine->resume(sender, NIL);
+    }
+    return true;
+}
+
+QString Channel::toString() {
+    return QString("<Channel: %1 values>").arg(values.size());
+}
@@ -0,0 +1,197 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+/**
+  ---------------------------------------------------------------------------
+  Contains coroutines (green threads) and channels, which are used to
+  exchange values between coroutines.
+  ---------------------------------------------------------------------------
+  */
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include "vm/env.h"
+#include "vm/storage.h"
+#include "vm/reference.h"
+
+#include <QSharedPointer>
+
+#include <deque>
+#include <vector>
+
+class Engine;
+class Channel;
+
+/**
+  Contains the register set of a coroutine which is currently not executed
+  by the engine.
+
+  All coroutines of an engine share its heap. The registers of the running
+  coroutine are kept in the engine itself, the ones stored here are only
+  valid while the coroutine is suspended. The first coroutine of an
+  execution is its root - the execution completes once the root executes
+  #STOP.
+  */
+class Coroutine
+{
+private:
+    Storage* storage;
+
+    Q_DISABLE_COPY(Coroutine)
+public:
+    /**
+      The saved registers (see Engine).
+      */
+    AtomRef* s;
+    AtomRef* e;
+    AtomRef* c;
+    AtomRef* d;
+    AtomRef* p;
+    AtomRef* a;
+
+    /**
+      The saved position within the source code.
+      */
+    Atom currentFile;
+    Word currentLine;
+
+    /**
+      Determines if this is the root coroutine of an execution.
+      */
+    const bool root;
+
+    /**
+      Determines if the coroutine has completed. Its result is then
+      available in result.
+      */
+    bool finished;
+    AtomRef* result;
+
+    /**
+      A coroutine which was suspended within a built in function has its
+      result pushed onto its stack. If it is resumed with a value (e.g. a
+      received message), this value replaces the one on the stack.
+      */
+    bool hasResumeValue;
+    AtomRef* resumeValue;
+
+    /**
+      Contains the coroutines which wait for this one to complete.
+      */
+    std::vector< QSharedPointer<Coroutine> > joiners;
+
+    /**
+      Contains the channel on which the coroutine waits to send or receive
+      a value, or NULL. This is maintained by the channel.
+      */
+    Channel* blockedOn;
+
+    Coroutine(Storage* storage, bool root);
+    ~Coroutine();
+
+    /**
+      Resets all saved registers, so that nothing is kept alive by accident.
+      */
+    void clearRegisters();
+};
+
+/**
+  Makes a coroutine accessible in pimii (as returned by spawn).
+  */
+class CoroutineReference : public Reference
+{
+private:
+    CoroutineReference(const QSharedPointer<Coroutine>& coroutine) :
+        coroutine(coroutine) {}
+public:
+    const QSharedPointer<Coroutine> coroutine;
+
+    static Reference* make(const QSharedPointer<Coroutine>& coroutine) {
+        return new CoroutineReference(coroutine);
+    }
+
+    virtual QString toString() {
+        return coroutine->finished ? "<Coroutine: finished>" : "<Coroutine>";
+    }
+};
+
+/**
+  A channel passes values from one coroutine to another in FIFO order.
+
+  Up to capacity values are buffered, a sender is suspended if it exceeds
+  this limit until its value was received. Therefore a channel with a
+  capacity of 0 hands each value over directly. A receiver is suspended
+  until a value is available.
+  */
+class Channel : public Reference
+{
+private:
+    Storage* storage;
+    const Word capacity;
+
+    /**
+      Contains the values sent but not yet received.
+      */
+    std::deque<AtomRef*> values;
+
+    /**
+      Contains the coroutines which wait until their value is received.
+      */
+    std::deque< QSharedPointer<Coroutine> > senders;
+
+    /**
+      Contains the coroutines which wait for a value.
+      */
+    std::deque< QSharedPointer<Coroutine> > receivers;
+
+    Channel(Storage* storage, Word capacity) :
+        storage(storage), capacity(capacity) {}
+
+    Q_DISABLE_COPY(Channel)
+public:
+    static Reference* make(Storage* storage, Word capacity) {
+        return new Channel(storage, capacity);
+    }
+
+    virtual ~Channel();
+
+    /**
+      Sends the given value. Suspends the current coroutine of the engine
+      if the capacity is exceeded.
+      */
+    void send(Engine* engine, Atom value);
+
+    /**
+      Receives the next value and stores it in result. Returns false if no
+      value was available, the current coroutine is then suspended and
+      resumed with the value once one is sent.
+      */
+    bool receive(Engine* engine, Atom* result);
+
+    /**
+      Drops all buffered values and waiting coroutines. This is used once
+      the execution, which the waiting coroutines belong to, is discarded.
+      Otherwise the values and the registers of the coroutines would keep
+      each other alive, as they are GC roots.
+      */
+    void clear();
+
+    virtual QString toString();
+};
+
+#endif // COROUTINE_H
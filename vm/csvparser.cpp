@@ -0,0 +1,118 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+#include "vm/csvparser.h"
+
+#include <cstring>
+
+CsvParser::CsvParser(Storage* storage,
+                     const char* data,
+                     qint64 size,
+                     char separator) :
+    storage(storage),
+    data(data),
+    size(size),
+    position(0),
+    separator(separator)
+{
+    // Skip a UTF-8 byte order mark...
+    if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        position = 3;
+    }
+}
+
+bool CsvParser::parseQuoted(QByteArray* field) {
+    position++;
+    while (true) {
+        // Copy everything up to the next quote at once...
+        const char* start = data + position;
+        const char* quote = static_cast<const char*>(
+                    memchr(start, '"', size - position));
+        if (quote == NULL) {
+            error = QString("Unterminated quoted field at offset %1").
+                    arg(position);
+            return false;
+        }
+        field->append(start, quote - start);
+        position = quote - data + 1;
+        if (position < size && data[position] == '"') {
+            field->append('"');
+            position++;
+        } else {
+            return true;
+        }
+    }
+}
+
+bool CsvParser::nextRow(AtomRef* row) {
+    if (position >= size || !error.isEmpty()) {
+        return false;
+    }
+    AtomRef list(storage, NIL);
+    AtomRef tail(storage, NIL);
+    QByteArray quoted;
+    while (true) {
+        Atom value;
+        qint64 start = position;
+        if (position < size && data[position] == '"') {
+            quoted.clear();
+            if (!parseQuoted(&quoted)) {
+                return false;
+            }
+            value = storage->makeString(QString::fromUtf8(quoted.constData(),
+                                                          quoted.size()));
+        } else {
+            // Unquoted fields are scanned with a tight loop over the raw
+            // bytes and decoded at once...
+            while (position < size) {
+                char ch = data[position];
+                if (ch == separator || ch == '\n' || ch == '\r') {
+                    break;
+                }
+                position++;
+            }
+            value = storage->makeString(
+                        QString::fromUtf8(data + start, position - start));
+        }
+        if (isNil(list.atom())) {
+            tail.atom(storage->makeCons(value, NIL));
+            list.atom(tail.atom());
+        } else {
+            tail.atom(storage->append(tail.atom(), value));
+        }
+        if (position >= size) {
+            break;
+        }
+        char ch = data[position++];
+        if (ch == separator) {
+            continue;
+        }
+        if (ch == '\r' && position < size && data[position] == '\n') {
+            position++;
+            break;
+        }
+        if (ch == '\n' || ch == '\r') {
+            break;
+        }
+        error = QString("Unexpected character after quoted field at offset %1").
+                arg(position - 1);
+        return false;
+    }
+    row->atom(list.atom());
+    return true;
+}
@@ -0,0 +1,71 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+/**
+  ---------------------------------------------------------------------------
+  Contains the parser which reads CSV data (RFC 4180) row by row.
+  ---------------------------------------------------------------------------
+  */
+#ifndef CSVPARSER_H
+#define CSVPARSER_H
+
+#include "vm/env.h"
+#include "vm/storage.h"
+
+/**
+  Parses CSV (UTF-8) directly into the given storage. Each row becomes a
+  list of strings. Fields may be enclosed in double quotes, in which case
+  they may contain separators, line breaks and escaped quotes (""). Rows
+  are terminated by LF or CRLF.
+
+  The input is not copied, therefore it must remain valid as long as the
+  parser is used.
+  */
+class CsvParser
+{
+private:
+    Storage* storage;
+    const char* data;
+    qint64 size;
+    qint64 position;
+    char separator;
+    QString error;
+
+    bool parseQuoted(QByteArray* field);
+public:
+    CsvParser(Storage* storage,
+              const char* data,
+              qint64 size,
+              char separator);
+
+    /**
+      Parses the next row. Returns false at the end of the input or if an
+      error occurred (see hasError()).
+      */
+    bool nextRow(AtomRef* row);
+
+    bool hasError() {
+        return !error.isEmpty();
+    }
+
+    QString getError() {
+        return error;
+    }
+};
+
+#endif // CSVPARSER_H
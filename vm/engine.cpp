@@ -22,10 +22,19 @@
 #include "bif/engineextension.h"
 #include "bif/coreextension.h"
 #include "bif/filesextension.h"
+#include "bif/coroutineextension.h"
+#include "bif/parallelextension.h"
+#include "bif/dataextension.h"
+#include "bif/regexextension.h"
+#include "bif/vectorextension.h"
 #include "compiler/compiler.h"
+#include "vm/mappedfile.h"
+#include "vm/sequence.h"
 
 #include <QFile>
+#include <QFileInfo>
 #include <QPluginLoader>
+#include <QMutexLocker>
 
 #include <sstream>
 #include <exception>
@@ -33,6 +42,10 @@
 
 Logger Engine::log("EXEC");
 
+LookupTable <Word, BIF, Word> Engine::bifTable;
+QMutex Engine::bifLock;
+bool Engine::bifTableFrozen = false;
+
 void Engine::push(AtomRef* reg, Atom atom) {
    reg->atom(storage.makeCons(atom, reg->atom()));
 }
@@ -53,9 +66,24 @@ Engine::Engine(QSettings* settings) :
     e(storage.ref(NIL)),
     c(storage.ref(NIL)),
     d(storage.ref(NIL)),
-    p(storage.ref(NIL))
+    p(storage.ref(NIL)),
+    a(storage.ref(NIL)),
+    jit(this, &storage)
 {
-    running = false;
+    running.fetchAndStoreOrdered(false);
+    stopRequested.fetchAndStoreOrdered(false);
+    switchRequested = false;
+    coroutinesPruneLimit = TUNING_PARAM_MIN_COROUTINES_PRUNE_LIMIT;
+    headless = false;
+    opsPerClockCheck = TUNING_PARAM_INITIAL_OPS_PER_CLOCK_CHECK;
+    instructionCounter = 0;
+    panicCounter = 0;
+    currentFile = NIL;
+    currentLine = 0;
+    profileSequences = false;
+    profileOps = false;
+    generation = 0;
+    asyncPool.setMaxThreadCount(TUNING_PARAM_MAX_ASYNC_THREADS);
     initializeSourceLookup();
 }
 
@@ -78,15 +106,22 @@ void Engine::initializeSourceLookup() {
 }
 
 Engine::~Engine() {
+    // Completed operations are deleted along with the submissions.
+    asyncPool.waitForDone();
     delete s;
     delete e;
     delete c;
     delete d;
     delete p;
+    delete a;
 }
 
 void Engine::initialize() {
-    this->initializeBIF();
+    QMutexLocker locker(&bifLock);
+    if (!bifTableFrozen) {
+        this->initializeBIF();
+        bifTableFrozen = true;
+    }
 }
 
 Atom Engine::makeBuiltInFunction(Atom nameSymbol, BIF value) {
@@ -94,6 +129,10 @@ Atom Engine::makeBuiltInFunction(Atom nameSymbol, BIF value) {
            "nameSymbol is not a symbol",
            __FILE__,
            __LINE__);
+    expect(!bifTableFrozen,
+           "built in functions can only be registered by initialize()",
+           __FILE__,
+           __LINE__);
     Word result = bifTable.add(nameSymbol, value);
     assert(result < MAX_INDEX_SIZE);
     return tagIndex(result, TAG_TYPE_BIF);
@@ -144,36 +183,45 @@ void Engine::opNIL() {
     push(s, NIL);
 }
 
-void Engine::opLD() {
-    push(s, locate(pop(c)));
+void Engine::opLD(bool checked) {
+    Atom pos = pop(c);
+    push(s, checked ? locate(pos) : locateUnchecked(pos));
 }
 
 void Engine::opLDC() {
     push(s, pop(c));
 }
 
-void Engine::opST() {
+void Engine::opST(bool checked) {
    AtomRef val(&storage, pop(s));
-   store(pop(c), val.atom());
+   if (checked) {
+       store(pop(c), val.atom());
+   } else {
+       storeUnchecked(pop(c), val.atom());
+   }
    push(s, val.atom());
 }
 
-void Engine::opLDG() {
+void Engine::opLDG(bool checked) {
     Atom gobal = pop(c);
-    expect(isGlobal(gobal),
-           "#LDG: code top was not a global",
-           __FILE__,
-           __LINE__);
+    if (checked) {
+        expect(isGlobal(gobal),
+               "#LDG: code top was not a global",
+               __FILE__,
+               __LINE__);
+    }
     push(s, storage.readGlobal(gobal));
 }
 
-void Engine::opSTG() {
+void Engine::opSTG(bool checked) {
     Atom gobal = pop(c);
     Atom val = pop(s);
-    expect(isGlobal(gobal),
-           "#STG: code top was not a global",
-           __FILE__,
-           __LINE__);
+    if (checked) {
+        expect(isGlobal(gobal),
+               "#STG: code top was not a global",
+               __FILE__,
+               __LINE__);
+    }
     storage.writeGlobal(gobal, val);
     push(s, val);
 }
@@ -211,36 +259,40 @@ Atom Engine::head(AtomRef* list) {
 }
 
 void Engine::opAP(bool hasArguments) {
-    AtomRef name(&storage, pop(c));
+    Atom name = pop(c);
     AtomRef fun(&storage, pop(s));
     AtomRef v(&storage, NIL);
     if (hasArguments) {
         v.atom(pop(s));
     }
-    if (isBIF(fun.atom())) {
-        BIF bif = getBuiltInFunction(fun.atom());
-        CallContext ctx(this, &storage, v.atom());
-        bif(ctx);
+    apply(name, fun.atom(), v.atom());
+}
+
+void Engine::apply(Atom name, Atom fun, Atom args) {
+    if (isBIF(fun)) {
+        CallContext ctx(this, &storage, args);
+        invokeBuiltInFunction(fun, ctx);
         push(s, ctx.getResult());
     } else {
-        if (!isCons(fun.atom())) {
+        if (!isCons(fun)) {
          panic(
            QString("'%1' is neither a closure nor a built in function (%2:%3)")
-                        .arg(storage.getSymbolName(name.atom()),
+                        .arg(storage.getSymbolName(name),
                              QString(__FILE__),
                              numberToString(__LINE__)));
         }
-        Cell funPair = storage.getCons(fun.atom());
-        if ((head(c) == SYMBOL_OP_RTN) && (funPair.car == head(d))) {
-
-            //            INFO(log, storage.getSymbolName(name.atom()));
-
-            // We have a tail recursion -> don't push useless stuff on the
-            // dump-stack, only flush stack, restart code and environment
-            // (with new args)
+        Cell funPair = storage.getCons(fun);
+        if ((head(c) == SYMBOL_OP_RTN) && isCons(d->atom())) {
+            // We have a tail call -> the current frame is no longer needed.
+            // Don't push useless stuff on the dump-stack, only flush stack,
+            // restart code and environment (with new args). This also
+            // works for mutually recursive functions or calls into other
+            // closures. The code marker on top of the dump is replaced, so
+            // that it still reflects the currently executed function.
             s->atom(NIL);
             c->atom(funPair.car);
-            e->atom(storage.makeCons(v.atom(), funPair.cdr));
+            storage.setCAR(d->atom(), funPair.car);
+            e->atom(storage.makeCons(args, funPair.cdr));
         } else {
             push(d, e->atom());
             push(d, s->atom());
@@ -248,7 +300,7 @@ void Engine::opAP(bool hasArguments) {
             s->atom(NIL);
             c->atom(funPair.car);
             push(d, c->atom());
-            e->atom(storage.makeCons(v.atom(), funPair.cdr));
+            e->atom(storage.makeCons(args, funPair.cdr));
             push(p, storage.makeCons(currentFile,
                                      storage.makeNumber(currentLine)));
         }
@@ -322,30 +374,59 @@ void Engine::opSPLIT() {
     AtomRef element(&storage, pop(s));
     AtomRef l1(&storage, pop(c));
     AtomRef l2(&storage, pop(c));
+    AtomRef head(&storage, NIL);
+    Atom tail;
     if (isCons(element.atom())) {
         Cell c = storage.getCons(element.atom());
-        if (isGlobal(l1.atom())) {
-            storage.writeGlobal(l1.atom(), c.car);
-        } else if (isCons(l1.atom())) {
-            store(l1.atom(), c.car);
-        }
-        if (isGlobal(l2.atom())) {
-            storage.writeGlobal(l2.atom(), c.cdr);
-        } else if (isCons(l2.atom())) {
-            store(l2.atom(), c.cdr);
-        }
-        push(s, SYMBOL_TRUE);
-    } else {
+        head.atom(c.car);
+        tail = c.cdr;
+    } else if (!nextElement(element.atom(), &head)) {
         push(s, SYMBOL_FALSE);
+        return;
+    } else {
+        // A sequence remains its own tail...
+        tail = element.atom();
+    }
+    if (isGlobal(l1.atom())) {
+        storage.writeGlobal(l1.atom(), head.atom());
+    } else if (isCons(l1.atom())) {
+        store(l1.atom(), head.atom());
+    }
+    if (isGlobal(l2.atom())) {
+        storage.writeGlobal(l2.atom(), tail);
+    } else if (isCons(l2.atom())) {
+        store(l2.atom(), tail);
+    }
+    push(s, SYMBOL_TRUE);
+}
+
+bool Engine::nextElement(Atom sequence, AtomRef* value) {
+    if (!isReference(sequence)) {
+        return false;
+    }
+    Sequence* seq = dynamic_cast<Sequence*>(storage.getReference(sequence));
+    if (seq == NULL) {
+        return false;
     }
+    if (seq->next(&storage, value)) {
+        return true;
+    }
+    QString error = seq->getError();
+    if (!error.isEmpty()) {
+        panic(error);
+    }
+    return false;
 }
 
 void Engine::opCHAIN() {
     Atom element = pop(s);
-    Atom cell = pop(s);
+    // The (head . tail) pair is left on the stack, so that the list remains
+    // referenced while the new element is appended.
+    Atom cell = head(s);
     if (isNil(cell)) {
-        Atom a = storage.makeCons(element, NIL);
-        push(s, storage.makeCons(a, a));
+        pop(s);
+        Atom list = storage.makeCons(element, NIL);
+        push(s, storage.makeCons(list, list));
     } else {
         expect(isCons(cell),
                "#CHAIN: stack top was not a cons!",
@@ -353,7 +434,6 @@ void Engine::opCHAIN() {
                __LINE__);
         Cell c = storage.getCons(cell);
         storage.setCDR(cell, storage.append(c.cdr, element));
-        push(s, cell);
     }
 }
 
@@ -368,6 +448,14 @@ void Engine::opCHAINEND() {
 }
 
 Relation Engine::compare(Atom a, Atom b) {
+    if (isSmallNumber(a) && isSmallNumber(b)) {
+        return compareSmallNumbers(a, b);
+    }
+    if (isNumber(a) && isNumber(b)) {
+        // Small and large numbers have different tags, but are still
+        // ordered exactly.
+        return compareNumerics(a, b);
+    }
     if (getType(a) != getType(b)) {
         return NE;
     }
@@ -409,11 +497,10 @@ Relation Engine::compareLists(Atom a, Atom b) {
 }
 
 Relation Engine::compareStrings(Atom a, Atom b) {
-    QString as = storage.getString(a);
-    QString bs = storage.getString(b);
-    if (as < bs) {
+    int result = storage.compareStrings(a, b);
+    if (result < 0) {
         return LT;
-    } else if (as > bs) {
+    } else if (result > 0) {
         return GT;
     } else {
         return EQ;
@@ -421,6 +508,17 @@ Relation Engine::compareStrings(Atom a, Atom b) {
 }
 
 Relation Engine::compareNumerics(Atom a, Atom b) {
+    if (isNumber(a) && isNumber(b)) {
+        Number na = storage.getNumber(a);
+        Number nb = storage.getNumber(b);
+        if (na < nb) {
+            return LT;
+        } else if (na > nb) {
+            return GT;
+        } else {
+            return EQ;
+        }
+    }
     double da;
     double db;
     convertNumeric(a, b, &da, &db);
@@ -434,66 +532,46 @@ Relation Engine::compareNumerics(Atom a, Atom b) {
     }
 }
 
-void Engine::opEQ() {
-    Atom b = pop(s);
-    Atom a = pop(s);
-    push(s, compare(a, b) == EQ ? SYMBOL_TRUE : SYMBOL_FALSE);
-}
-
-void Engine::opNE() {
+void Engine::dispatchRelation(Atom opcode) {
     Atom b = pop(s);
     Atom a = pop(s);
-    push(s, compare(a, b) != EQ ? SYMBOL_TRUE : SYMBOL_FALSE);
+    push(s, evaluateRelation(opcode, a, b));
 }
 
-void Engine::opLT() {
-    Atom b = pop(s);
-    Atom a = pop(s);
-    Relation result = compare(a, b);
-    if (result == NE) {
-        panic(QString("Cannot order values of different types: %1, %2").
-              arg(toString(a), toString(b)));
+Atom Engine::evaluateRelation(Atom opcode, Atom a, Atom b) {
+    if (isSmallNumber(a) && isSmallNumber(b)) {
+        return evaluateSmallRelation(opcode, a, b);
     }
-    push(s, result == LT ? SYMBOL_TRUE : SYMBOL_FALSE);
-}
-
-void Engine::opLTQ() {
-    Atom b = pop(s);
-    Atom a = pop(s);
     Relation result = compare(a, b);
-    if (result == NE) {
-        panic(QString("Cannot order values of different types: %1, %2").
-              arg(toString(a), toString(b)));
+    if (opcode == SYMBOL_OP_EQ) {
+        return result == EQ ? SYMBOL_TRUE : SYMBOL_FALSE;
+    } else if (opcode == SYMBOL_OP_NE) {
+        return result != EQ ? SYMBOL_TRUE : SYMBOL_FALSE;
     }
-    push(s, result == LT || result == EQ ? SYMBOL_TRUE : SYMBOL_FALSE);
-}
-
-void Engine::opGT() {
-    Atom b = pop(s);
-    Atom a = pop(s);
-    Relation result = compare(a, b);
     if (result == NE) {
         panic(QString("Cannot order values of different types: %1, %2").
               arg(toString(a), toString(b)));
     }
-    push(s, result == GT ? SYMBOL_TRUE : SYMBOL_FALSE);
-}
-
-void Engine::opGTQ() {
-    Atom b = pop(s);
-    Atom a = pop(s);
-    Relation result = compare(a, b);
-    if (result == NE) {
-        panic(QString("Cannot order values of different types: %1, %2").
-              arg(toString(a), toString(b)));
+    switch(opcode) {
+    case SYMBOL_OP_LT:
+        return result == LT ? SYMBOL_TRUE : SYMBOL_FALSE;
+    case SYMBOL_OP_LTQ:
+        return result == LT || result == EQ ? SYMBOL_TRUE : SYMBOL_FALSE;
+    case SYMBOL_OP_GT:
+        return result == GT ? SYMBOL_TRUE : SYMBOL_FALSE;
+    case SYMBOL_OP_GTQ:
+        return result == GT || result == EQ ? SYMBOL_TRUE : SYMBOL_FALSE;
+    default:
+        panic(QString("Invalid relation: ") + toString(opcode));
+        return SYMBOL_FALSE;
     }
-    push(s, result == GT || result == EQ ? SYMBOL_TRUE : SYMBOL_FALSE);
-
 }
 
 void Engine::opCONCAT() {
     Atom b = pop(s);
-    Atom a = pop(s);
+    // The first list is left on the stack, so that it remains referenced
+    // while the new cells are allocated.
+    Atom a = head(s);
     if (isCons(a)) {
         Cell cell = storage.getCons(a);
         Atom tail = a;
@@ -506,18 +584,21 @@ void Engine::opCONCAT() {
         } else {
             storage.setCDR(tail, storage.makeCons(b, NIL));
         }
-        push(s, a);
         return;
     }
     if (isNil(a)) {
+        pop(s);
         push(s, storage.makeCons(b, NIL));
         return;
     }
     if (isNil(b)) {
+        pop(s);
         push(s, storage.makeCons(a, NIL));
         return;
     }
-    push(s, storage.makeCons(a, storage.makeCons(b, NIL)));
+    Atom list = storage.makeCons(b, NIL);
+    pop(s);
+    push(s, storage.makeCons(a, list));
 }
 
 void Engine::opAND() {
@@ -555,9 +636,25 @@ void Engine::convertNumeric(Word atoma, Word atomb, double* a, double* b) {
 void Engine::dispatchArithmetic(Atom opcode) {
     Atom atomb = pop(s);
     Atom atoma = pop(s);
-    if (opcode == SYMBOL_OP_ADD && (isString(atoma) || isString(atomb))) {
-        push(s, storage.makeString(toSimpleString(atoma) + toSimpleString(atomb)));
-        return;
+    push(s, evaluateArithmetic(opcode, atoma, atomb));
+}
+
+Atom Engine::evaluateArithmetic(Atom opcode, Atom atoma, Atom atomb) {
+    if (isSmallNumber(atoma) && isSmallNumber(atomb)) {
+        Number result;
+        if (computeIntegers(opcode,
+                            untagSmallNumber(atoma),
+                            untagSmallNumber(atomb),
+                            &result)) {
+            return fitsSmallNumber(result) ?
+                        tagSmallNumber(result) : storage.makeNumber(result);
+        }
+    }
+    if (opcode == SYMBOL_OP_ADD && isString(atoma)) {
+        return storage.appendString(atoma, toSimpleString(atomb));
+    }
+    if (opcode == SYMBOL_OP_ADD && isString(atomb)) {
+        return storage.makeString(toSimpleString(atoma) + toSimpleString(atomb));
     }
     expect(isNumeric(atomb),
            "Arithmetic: 1st stack top was not a number!",
@@ -570,22 +667,36 @@ void Engine::dispatchArithmetic(Atom opcode) {
     if (isNumber(atomb) && isNumber(atoma)) {
         Number b = storage.getNumber(atomb);
         Number a = storage.getNumber(atoma);
+        Number result;
+        if (computeIntegers(opcode, a, b, &result)) {
+            return storage.makeNumber(result);
+        }
+        if (b == 0) {
+            panic(QString("Division by zero: ") +
+                  toSimpleString(atoma) +
+                  " " +
+                  toString(opcode) +
+                  " " +
+                  toSimpleString(atomb));
+            return NIL;
+        }
+        // The only remainder which cannot be computed is MIN % -1
+        if (opcode == SYMBOL_OP_REM) {
+            return storage.makeNumber(0);
+        }
+        // The result doesn't fit into a Number, therefore we fall back to
+        // a decimal result.
+        double da = static_cast<double>(a);
+        double db = static_cast<double>(b);
         switch(opcode) {
         case SYMBOL_OP_ADD:
-            push(s, storage.makeNumber(a + b));
-            return;
+            return storage.makeDecimal(da + db);
         case SYMBOL_OP_MUL:
-            push(s, storage.makeNumber(a * b));
-            return;
+            return storage.makeDecimal(da * db);
         case SYMBOL_OP_DIV:
-            push(s, storage.makeNumber(a / b));
-            return;
-        case SYMBOL_OP_REM:
-            push(s, storage.makeNumber(a % b));
-            return;
+            return storage.makeDecimal(da / db);
         case SYMBOL_OP_SUB:
-            push(s, storage.makeNumber(a - b));
-            return;
+            return storage.makeDecimal(da - db);
         }
     } else {
         double a;
@@ -594,25 +705,22 @@ void Engine::dispatchArithmetic(Atom opcode) {
 
         switch(opcode) {
         case SYMBOL_OP_ADD:
-            push(s, storage.makeDecimal(a + b));
-            return;
+            return storage.makeDecimal(a + b);
         case SYMBOL_OP_MUL:
-            push(s, storage.makeDecimal(a * b));
-            return;
+            return storage.makeDecimal(a * b);
         case SYMBOL_OP_DIV:
-            push(s, storage.makeDecimal(a / b));
-            return;
+            return storage.makeDecimal(a / b);
         case SYMBOL_OP_REM:
             panic(QString("Cannot compute modulo of decimal values: ") +
                   toSimpleString(atoma) +
                   " and " +
                   toSimpleString(atomb));
-            return;
+            return NIL;
         case SYMBOL_OP_SUB:
-            push(s, storage.makeDecimal(a - b));
-            return;
+            return storage.makeDecimal(a - b);
         }
     }
+    return NIL;
 }
 
 Atom Engine::locate(Atom pos) {
@@ -631,6 +739,10 @@ Atom Engine::locate(Atom pos) {
            __FILE__,
            __LINE__);
     Number j = storage.getNumber(cons.cdr);
+    return locate(i, j);
+}
+
+Atom Engine::locate(Number i, Number j) {
     Atom env = e->atom();
     while (i > 1) {
         if (!isCons(env)) {
@@ -676,6 +788,10 @@ void Engine::store(Atom pos, Atom value) {
            __FILE__,
            __LINE__);
     Number j = storage.getNumber(cons.cdr);
+    store(i, j, value);
+}
+
+void Engine::store(Number i, Number j, Atom value) {
     AtomRef env(&storage, e->atom());
     while (i > 1) {
         if (!isCons(env.atom())) {
@@ -712,8 +828,12 @@ void Engine::store(Atom pos, Atom value) {
     storage.setCAR(env.atom(), value);
 }
 
-void Engine::opLine() {
+void Engine::opLine(bool checked) {
     Atom line = pop(c);
+    if (!checked) {
+        currentLine = untagSmallNumber(line);
+        return;
+    }
     expect(isNumber(line),
            "#LINE: code top is not a number!",
            __FILE__,
@@ -730,8 +850,210 @@ void Engine::opFile() {
     currentFile = symbol;
 }
 
+void Engine::opLDArithmeticC(Atom opcode) {
+    Atom pos = pop(c);
+    Atom value = opcode == SYMBOL_OP_LDADDC || opcode == SYMBOL_OP_LDSUBC ?
+                locate(pos) : locateUnchecked(pos);
+    Atom constant = pop(c);
+    push(s, evaluateArithmetic(checkedOpCode(opcode) == SYMBOL_OP_LDADDC ?
+                                   SYMBOL_OP_ADD : SYMBOL_OP_SUB,
+                               value,
+                               constant));
+}
+
+void Engine::opTESTC(bool checked) {
+    Atom pos = pop(c);
+    Atom value = checked ? locate(pos) : locateUnchecked(pos);
+    Atom constant = pop(c);
+    Atom relation = pop(c);
+    Atom branch = pop(c);
+    if (evaluateRelation(relation, value, constant) == SYMBOL_TRUE) {
+        c->atom(branch);
+    }
+}
+
+void Engine::opENTRY() {
+    Atom counter = c->atom();
+    Number count = storage.getNumber(pop(c));
+    if (count < 0) {
+        // The body behind a compiled #ENTRY is still intact and simply
+        // interpreted if the compiler was disabled...
+        if (jit.isEnabled()) {
+            c->atom(jit.execute(-1 - count));
+        }
+        return;
+    }
+    if (static_cast<Word>(count) < jit.getThreshold()) {
+        count++;
+        storage.setCAR(counter, storage.makeNumber(count));
+        if (static_cast<Word>(count) == jit.getThreshold()) {
+            jit.compileFunction(counter);
+        }
+    }
+}
+
+void Engine::opJIT() {
+    Word index = storage.getNumber(pop(c));
+    // If the compiler was disabled, the interpreter continues with the
+    // first op code of the block, which was moved behind the index...
+    if (jit.isEnabled()) {
+        c->atom(jit.execute(index));
+    }
+}
+
+void Engine::opAPN(int count) {
+    Atom name = pop(c);
+    // The function is on top of the stack, followed by the arguments. It
+    // stays there until the call is set up, so that it remains referenced.
+    expect(isCons(s->atom()),
+           "#AP: stack top was not a function!",
+           __FILE__,
+           __LINE__);
+    Cell top = storage.getCons(s->atom());
+    applyStackArguments(name, top.car, top.cdr, count);
+}
+
+void Engine::applyStackArguments(Atom name, Atom fun, Atom stack, int count) {
+    Atom rest = stack;
+    for(int i = 0; i < count; i++) {
+        expect(isCons(rest),
+               "#AP: not enough arguments on the stack!",
+               __FILE__,
+               __LINE__);
+        rest = storage.getCons(rest).cdr;
+    }
+    if (isBIF(fun)) {
+        Atom previousArguments = a->atom();
+        a->atom(stack);
+        s->atom(rest);
+        if (count <= MAX_STACK_ARGUMENTS) {
+            Atom argv[MAX_STACK_ARGUMENTS];
+            Atom cell = stack;
+            for(int i = count - 1; i >= 0; i--) {
+                Cell cons = storage.getCons(cell);
+                argv[i] = cons.car;
+                cell = cons.cdr;
+            }
+            CallContext ctx(this, &storage, argv, count);
+            invokeBuiltInFunction(fun, ctx);
+            a->atom(previousArguments);
+            push(s, ctx.getResult());
+        } else {
+            Atom args = reverseStackArguments(stack, rest);
+            a->atom(args);
+            CallContext ctx(this, &storage, args);
+            invokeBuiltInFunction(fun, ctx);
+            a->atom(previousArguments);
+            push(s, ctx.getResult());
+        }
+        return;
+    }
+    if (!isCons(fun)) {
+        panic(
+          QString("'%1' is neither a closure nor a built in function (%2:%3)")
+                       .arg(storage.getSymbolName(name),
+                            QString(__FILE__),
+                            numberToString(__LINE__)));
+    }
+    Cell funPair = storage.getCons(fun);
+    bool tailCall = (head(c) == SYMBOL_OP_RTN) && isCons(d->atom());
+    if (!tailCall) {
+        push(d, e->atom());
+        push(d, rest);
+        push(d, c->atom());
+    }
+    // From here on, the cells of the arguments are only reachable via the
+    // environment - therefore no memory must be allocated before the new
+    // environment is created.
+    Atom frame = reverseStackArguments(stack, rest);
+    e->atom(storage.makeCons(frame, funPair.cdr));
+    s->atom(NIL);
+    c->atom(funPair.car);
+    if (tailCall) {
+        storage.setCAR(d->atom(), funPair.car);
+    } else {
+        push(d, c->atom());
+        push(p, storage.makeCons(currentFile,
+                                 storage.makeNumber(currentLine)));
+    }
+}
+
+Atom Engine::reverseStackArguments(Atom stack, Atom rest) {
+    Atom list = NIL;
+    Atom cell = stack;
+    while(cell != rest) {
+        Atom next = storage.getCons(cell).cdr;
+        storage.setCDR(cell, list);
+        list = cell;
+        cell = next;
+    }
+    return list;
+}
+
+Atom Engine::resolveCallTarget(Atom global, Atom cache) {
+    Cell entry = storage.getCons(cache);
+    Atom version = storage.getGlobalsVersion();
+    if (entry.car == version) {
+        // Monomorphic call site which still points to the same function.
+        // The cache is part of the code and therefore keeps fun referenced.
+        return entry.cdr;
+    }
+    expect(isGlobal(global),
+           "#CALLG: code top was not a global",
+           __FILE__,
+           __LINE__);
+    Atom fun = storage.readGlobal(global);
+    if (isCons(fun) || isBIF(fun)) {
+        storage.setCAR(cache, version);
+        storage.setCDR(cache, fun);
+    }
+    return fun;
+}
+
+void Engine::opCALLG(bool hasArguments) {
+    Atom global = pop(c);
+    Atom name = pop(c);
+    if (hasArguments) {
+        int count = storage.getNumber(pop(c));
+        Atom fun = resolveCallTarget(global, pop(c));
+        applyStackArguments(name, fun, s->atom(), count);
+    } else {
+        Atom fun = resolveCallTarget(global, pop(c));
+        apply(name, fun, NIL);
+    }
+}
+
+void Engine::invokeBuiltInFunction(Atom fun, const CallContext& ctx) {
+    BIF bif = getBuiltInFunction(fun);
+#ifdef OP_PROFILING
+    if (profileOps) {
+        Word start = readCycleCounter();
+        bif(ctx);
+        opProfiler.recordBuiltInFunction(untagIndex(fun),
+                                         readCycleCounter() - start);
+        return;
+    }
+#endif
+    bif(ctx);
+}
+
 void Engine::dispatch(Atom opcode) {
     instructionCounter++;
+    if (profileSequences) {
+        sequenceProfiler.record(opcode);
+    }
+#ifdef OP_PROFILING
+    if (profileOps) {
+        Word start = readCycleCounter();
+        execute(opcode);
+        opProfiler.recordOp(opcode, readCycleCounter() - start);
+        return;
+    }
+#endif
+    execute(opcode);
+}
+
+void Engine::execute(Atom opcode) {
     switch (opcode) {
     case SYMBOL_OP_NIL:
         opNIL();
@@ -740,16 +1062,28 @@ void Engine::dispatch(Atom opcode) {
         opLDC();
         return;
     case SYMBOL_OP_LD:
-        opLD();
+        opLD(true);
+        return;
+    case SYMBOL_OP_LDU:
+        opLD(false);
         return;
     case SYMBOL_OP_ST:
-        opST();
+        opST(true);
+        return;
+    case SYMBOL_OP_STU:
+        opST(false);
         return;
     case SYMBOL_OP_LDG:
-        opLDG();
+        opLDG(true);
+        break;
+    case SYMBOL_OP_LDGU:
+        opLDG(false);
         break;
     case SYMBOL_OP_STG:
-        opSTG();
+        opSTG(true);
+        break;
+    case SYMBOL_OP_STGU:
+        opSTG(false);
         break;
     case SYMBOL_OP_BT:
         opBT();
@@ -763,26 +1097,37 @@ void Engine::dispatch(Atom opcode) {
     case SYMBOL_OP_AP:
         opAP(true);
         return;
+    case SYMBOL_OP_AP1:
+        opAPN(1);
+        return;
+    case SYMBOL_OP_AP2:
+        opAPN(2);
+        return;
+    case SYMBOL_OP_AP3:
+        opAPN(3);
+        return;
+    case SYMBOL_OP_AP4:
+        opAPN(4);
+        return;
+    case SYMBOL_OP_APV:
+        opAPN(storage.getNumber(pop(c)));
+        return;
+    case SYMBOL_OP_ENTRY:
+        opENTRY();
+        return;
+    case SYMBOL_OP_JIT:
+        opJIT();
+        return;
     case SYMBOL_OP_RTN:
         opRTN();
         return;
     case SYMBOL_OP_EQ:
-        opEQ();
-        return;
     case SYMBOL_OP_NE:
-        opNE();
-        return;
     case SYMBOL_OP_LT:
-        opLT();
-        return;
     case SYMBOL_OP_LTQ:
-        opLTQ();
-        return;
     case SYMBOL_OP_GT:
-        opGT();
-        return;
     case SYMBOL_OP_GTQ:
-        opGTQ();
+        dispatchRelation(opcode);
         return;
     case SYMBOL_OP_NOOP:
         return;
@@ -833,7 +1178,28 @@ void Engine::dispatch(Atom opcode) {
         opFile();
         return;
     case SYMBOL_OP_LINE:
-        opLine();
+        opLine(true);
+        return;
+    case SYMBOL_OP_LINEU:
+        opLine(false);
+        return;
+    case SYMBOL_OP_LDADDC:
+    case SYMBOL_OP_LDSUBC:
+    case SYMBOL_OP_LDADDCU:
+    case SYMBOL_OP_LDSUBCU:
+        opLDArithmeticC(opcode);
+        return;
+    case SYMBOL_OP_TESTC:
+        opTESTC(true);
+        return;
+    case SYMBOL_OP_TESTCU:
+        opTESTC(false);
+        return;
+    case SYMBOL_OP_CALLG:
+        opCALLG(true);
+        return;
+    case SYMBOL_OP_CALLG0:
+        opCALLG(false);
         return;
     default:
         panic(QString("Invalid op-code: ")+toString(opcode));
@@ -843,11 +1209,13 @@ void Engine::dispatch(Atom opcode) {
 
 
 bool Engine::loadNextExecution() {
+    discardCoroutines();
     s->atom(NIL);
     e->atom(NIL);
     c->atom(NIL);
     d->atom(NIL);
     p->atom(NIL);
+    a->atom(NIL);
 
     if (executionStack.empty()) {
         return false;
@@ -859,53 +1227,316 @@ bool Engine::loadNextExecution() {
 }
 
 bool Engine::isRunnable() {
-    return running;
+    return running || stopRequested || !submissions.isEmpty();
+}
+
+void Engine::waitForSubmissions() {
+    submissions.waitForSubmissions();
 }
 
 void Engine::eval(const QString& source,
                   const QString& filename,
                   bool printStackTop)
 {
-    Atom code = compileSource(filename, source, true, false);
-    if (code != NIL) {
-        Execution exe;
-        exe.filename = filename;
-        exe.fn = storage.ref(code);
-        exe.printStackTop = printStackTop;
-        executionStack.push_back(exe);
-        if (!running) {
-            running = true;
-            emit onEngineStarted();
-        }
-    }
+    Submission* submission = new Submission();
+    submission->source = source;
+    submission->filename = filename;
+    submission->fn = NULL;
+    submission->operation = NULL;
+    submission->printStackTop = printStackTop;
+    submissions.push(submission);
 }
 
-void Engine::evalFn(const QString& filename, Atom fn)
+void Engine::evalFn(const QString& filename, Atom fn, bool printStackTop)
 {
-    Atom code = fn;
-    if (code != NIL) {
+    if (fn != NIL) {
+        Submission* submission = new Submission();
+        submission->filename = filename;
+        submission->fn = storage.ref(fn);
+        submission->operation = NULL;
+        submission->printStackTop = printStackTop;
+        submissions.push(submission);
+    }
+}
+
+void Engine::runAsync(AsyncOperation* operation, Atom continuation) {
+    operation->engine = this;
+    operation->continuation = storage.ref(continuation);
+    operation->generation = generation;
+    pendingOperations.fetchAndAddOrdered(1);
+    asyncPool.start(operation);
+}
+
+void Engine::completeAsync(AsyncOperation* operation) {
+    Submission* submission = new Submission();
+    submission->filename = "async";
+    submission->fn = operation->continuation;
+    submission->operation = operation;
+    submission->printStackTop = false;
+    submissions.push(submission);
+    // Only decremented once the submission is visible, so that no one
+    // concludes that there is no more work in between. As the engine
+    // might already wait again, as it saw the submission but not the
+    // decrement, we wake it up once more...
+    pendingOperations.fetchAndAddOrdered(-1);
+    submissions.wakeUp();
+}
+
+bool Engine::hasPendingOperations() {
+    return pendingOperations != 0;
+}
+
+bool Engine::call(Atom fn, Atom args, AtomRef* result) {
+    Execution exe;
+    exe.filename = "call";
+    exe.fn = storage.ref(makeApplyCode(fn, args, "call"));
+    exe.printStackTop = false;
+    exe.result = result;
+    executionStack.push_back(exe);
+    if (!running) {
+        running.fetchAndStoreOrdered(true);
+        emit onEngineStarted();
+    }
+    Word panics = panicCounter;
+    while (running) {
+        interpret();
+    }
+    return panicCounter == panics;
+}
+
+void Engine::acceptSubmissions() {
+    Submission* submission = submissions.takeAll();
+    while(submission != NULL) {
         Execution exe;
-        exe.filename = filename;
-        exe.fn = storage.ref(code);
-        exe.printStackTop = false;
-        executionStack.push_back(exe);
-        if (!running) {
-            running = true;
-            emit onEngineStarted();
+        exe.filename = submission->filename;
+        exe.fn = submission->fn;
+        exe.printStackTop = submission->printStackTop;
+        exe.result = NULL;
+        if (submission->operation != NULL) {
+            AsyncOperation* operation = submission->operation;
+            if (operation->generation == generation) {
+                Atom args = operation->makeArguments(&storage);
+                exe.fn = storage.ref(makeApplyCode(submission->fn->atom(),
+                                                   args,
+                                                   "continuation"));
+            } else {
+                // Started by an execution which was terminated since...
+                exe.fn = NULL;
+            }
+            delete submission->fn;
+            delete operation;
+        } else if (exe.fn == NULL) {
+            Atom code = compileSource(submission->filename,
+                                      submission->source,
+                                      true,
+                                      false);
+            if (code != NIL) {
+                exe.fn = storage.ref(code);
+            }
+        }
+        if (exe.fn != NULL) {
+            executionStack.push_back(exe);
         }
+        Submission* next = submission->next;
+        delete submission;
+        submission = next;
+    }
+    if (!running && !executionStack.empty()) {
+        running.fetchAndStoreOrdered(true);
+        emit onEngineStarted();
     }
 }
 
 void Engine::fullstop() {
-    executionStack.clear();
-    stopEngine();
+    stopRequested.fetchAndStoreOrdered(true);
+    submissions.wakeUp();
+}
+
+void Engine::discardExecutions() {
+    generation++;
+    discardCoroutines();
+    while(!executionStack.empty()) {
+        delete executionStack.front().fn;
+        executionStack.pop_front();
+    }
+}
+
+void Engine::discardCoroutines() {
+    for(std::vector< QSharedPointer<Coroutine> >::iterator
+        i = coroutines.begin();
+        i != coroutines.end();
+        ++i)
+    {
+        Coroutine* coroutine = i->data();
+        if (coroutine->blockedOn != NULL) {
+            coroutine->blockedOn->clear();
+        }
+        coroutine->clearRegisters();
+        coroutine->joiners.clear();
+    }
+    coroutines.clear();
+    coroutinesPruneLimit = TUNING_PARAM_MIN_COROUTINES_PRUNE_LIMIT;
+    currentCoroutine.clear();
+    runQueue.clear();
+    switchRequested = false;
+}
+
+QSharedPointer<Coroutine> Engine::getCurrentCoroutine() {
+    if (currentCoroutine.isNull()) {
+        currentCoroutine = QSharedPointer<Coroutine>(
+                    new Coroutine(&storage, true));
+        trackCoroutine(currentCoroutine);
+    }
+    return currentCoroutine;
+}
+
+Atom Engine::makeApplyCode(Atom fn, Atom args, const char* name) {
+    AtomRef fnRef(&storage, fn);
+    AtomRef argsRef(&storage, args);
+    AtomRef code(&storage, storage.makeCons(SYMBOL_OP_STOP, NIL));
+    code.atom(storage.makeCons(storage.makeSymbol(name), code.atom()));
+    code.atom(storage.makeCons(SYMBOL_OP_AP, code.atom()));
+    code.atom(storage.makeCons(fnRef.atom(), code.atom()));
+    code.atom(storage.makeCons(SYMBOL_OP_LDC, code.atom()));
+    code.atom(storage.makeCons(argsRef.atom(), code.atom()));
+    code.atom(storage.makeCons(SYMBOL_OP_LDC, code.atom()));
+    return code.atom();
+}
+
+QSharedPointer<Coroutine> Engine::spawn(Atom fn, Atom args) {
+    // Ensure that there is a root coroutine which can be switched away from.
+    getCurrentCoroutine();
+    QSharedPointer<Coroutine> coroutine(new Coroutine(&storage, false));
+    coroutine->c->atom(makeApplyCode(fn, args, "spawn"));
+    coroutine->currentFile = currentFile;
+    coroutine->currentLine = currentLine;
+    runQueue.push_back(coroutine);
+    trackCoroutine(coroutine);
+    return coroutine;
+}
+
+void Engine::trackCoroutine(const QSharedPointer<Coroutine>& coroutine) {
+    if (coroutines.size() >= coroutinesPruneLimit) {
+        std::vector< QSharedPointer<Coroutine> > unfinished;
+        for(std::vector< QSharedPointer<Coroutine> >::iterator
+            i = coroutines.begin();
+            i != coroutines.end();
+            ++i)
+        {
+            if (!(*i)->finished) {
+                unfinished.push_back(*i);
+            }
+        }
+        coroutines.swap(unfinished);
+        coroutinesPruneLimit = std::max(2 * coroutines.size(),
+                            (size_t)TUNING_PARAM_MIN_COROUTINES_PRUNE_LIMIT);
+    }
+    coroutines.push_back(coroutine);
+}
+
+void Engine::yield() {
+    if (runQueue.empty()) {
+        return;
+    }
+    runQueue.push_back(getCurrentCoroutine());
+    switchRequested = true;
+}
+
+void Engine::suspend() {
+    getCurrentCoroutine();
+    switchRequested = true;
+}
+
+void Engine::resume(const QSharedPointer<Coroutine>& coroutine, Atom value) {
+    coroutine->resumeValue->atom(value);
+    coroutine->hasResumeValue = true;
+    runQueue.push_back(coroutine);
+}
+
+void Engine::finishCoroutine() {
+    Atom result = pop(s);
+    currentCoroutine->finished = true;
+    currentCoroutine->result->atom(result);
+    for(std::vector< QSharedPointer<Coroutine> >::iterator
+        i = currentCoroutine->joiners.begin();
+        i != currentCoroutine->joiners.end();
+        ++i)
+    {
+        resume(*i, result);
+    }
+    currentCoroutine->joiners.clear();
+    switchRequested = true;
+}
+
+void Engine::switchCoroutine() {
+    switchRequested = false;
+    if (runQueue.empty()) {
+        panic("Deadlock: All coroutines are waiting");
+    }
+    QSharedPointer<Coroutine> next = runQueue.front();
+    runQueue.pop_front();
+    if (next.data() == currentCoroutine.data()) {
+        return;
+    }
+    if (currentCoroutine->finished) {
+        currentCoroutine->clearRegisters();
+    } else {
+        currentCoroutine->s->atom(s->atom());
+        currentCoroutine->e->atom(e->atom());
+        currentCoroutine->c->atom(c->atom());
+        currentCoroutine->d->atom(d->atom());
+        currentCoroutine->p->atom(p->atom());
+        currentCoroutine->a->atom(a->atom());
+        currentCoroutine->currentFile = currentFile;
+        currentCoroutine->currentLine = currentLine;
+    }
+    s->atom(next->s->atom());
+    e->atom(next->e->atom());
+    c->atom(next->c->atom());
+    d->atom(next->d->atom());
+    p->atom(next->p->atom());
+    a->atom(next->a->atom());
+    currentFile = next->currentFile;
+    currentLine = next->currentLine;
+    if (next->hasResumeValue) {
+        // Replace the result of the built in function which suspended
+        // the coroutine...
+        storage.setCAR(s->atom(), next->resumeValue->atom());
+    }
+    next->clearRegisters();
+    currentCoroutine = next;
+}
+
+void Engine::terminate() {
+    stopRequested.fetchAndStoreOrdered(false);
+    discardExecutions();
+    loadNextExecution();
+    if (running) {
+        running.fetchAndStoreOrdered(false);
+        emit onEngineStopped();
+    }
 }
 
 void Engine::stopEngine() {
+    if (!currentCoroutine.isNull()) {
+        if (!currentCoroutine->root) {
+            finishCoroutine();
+            return;
+        }
+        if (!runQueue.empty()) {
+            // The execution is only complete, once all runnable coroutines
+            // are finished. Therefore we execute #STOP again later...
+            push(c, SYMBOL_OP_STOP);
+            yield();
+            return;
+        }
+    }
     Execution exe = executionStack.front();
     // Check if we should print the execution result...
     if (exe.printStackTop) {
         INFO(log, toString(pop(s)));
+    } else if (exe.result != NULL) {
+        exe.result->atom(pop(s));
     }
 
     // Remove execution...
@@ -913,49 +1544,133 @@ void Engine::stopEngine() {
     delete exe.fn;
 
     TRACE(log, "STOP requested. Loading next execution.");
+    if (executionStack.empty()) {
+        acceptSubmissions();
+    }
     if (!loadNextExecution()) {
         TRACE(log, "Nothing to do. Halting engine.");
-        running = false;
+        running.fetchAndStoreOrdered(false);
         emit onEngineStopped();
         return;
     }
 }
 
 void Engine::interpret() {
-    if (!running) {
-        return;
-    }
     TRACE(log, "Entering Interpert...");
-    if (c->atom() == NIL) {
-        TRACE(log, "Loading next execution...");
-        if (!loadNextExecution()) {
-            TRACE(log, "Nothing to do. Halting engine.");
-            running = false;
-            emit onEngineStopped();
+    try {
+        if (stopRequested) {
+            terminate();
+        }
+        acceptSubmissions();
+        if (!running) {
             return;
         }
-    }
-    try {
-        Word maxOpCodes = TUNING_PARAM_MAX_OP_CODES_IN_INTERPRET;
-        while (running && maxOpCodes > 0) {
+        if (c->atom() == NIL) {
+            TRACE(log, "Loading next execution...");
+            if (!loadNextExecution()) {
+                TRACE(log, "Nothing to do. Halting engine.");
+                running.fetchAndStoreOrdered(false);
+                emit onEngineStopped();
+                return;
+            }
+        }
+        // The clock is only checked every opsPerClockCheck op codes, as
+        // reading it costs more than most op codes...
+        QElapsedTimer clock;
+        clock.start();
+        qint64 quantum = static_cast<qint64>(TUNING_PARAM_INTERPRET_QUANTUM) *
+                1000000;
+        qint64 lastCheck = 0;
+        Word remainingOpCodes = headless ? TUNING_PARAM_COROUTINE_SLICE :
+                                           opsPerClockCheck;
+        while (running) {
+            if (samplingProfiler.isSampleRequested()) {
+                recordSample();
+            }
             Atom op = pop(c);
             if (op == SYMBOL_OP_STOP) {
                 stopEngine();
             } else {
                 dispatch(op);
             }
-            maxOpCodes--;
+            if (switchRequested) {
+                switchCoroutine();
+            }
+            if (--remainingOpCodes == 0) {
+                // Preempt the current coroutine if others are waiting...
+                if (!runQueue.empty()) {
+                    runQueue.push_back(currentCoroutine);
+                    switchCoroutine();
+                }
+                if (headless) {
+                    remainingOpCodes = TUNING_PARAM_COROUTINE_SLICE;
+                    continue;
+                }
+                qint64 now = clock.nsecsElapsed();
+                calibrateClockChecks(now - lastCheck);
+                if (now >= quantum) {
+                    break;
+                }
+                lastCheck = now;
+                remainingOpCodes = opsPerClockCheck;
+            }
         }
         TRACE(log, "Leaving interpret...");
     } catch(PanicException* ex) {
-        running = false;
+        panicCounter++;
+        running.fetchAndStoreOrdered(false);
         emit onEngineStopped();
-        executionStack.clear();
-        emit onEnginePanic(currentFile, currentLine, lastError, stackDump());
+        discardExecutions();
+        QString status = stackDump();
+        if (headless) {
+            // There is no UI which would report the error...
+            ERROR(log, QString("PANIC: ") + lastError + "\n" + status);
+        }
+        emit onEnginePanic(currentFile, currentLine, lastError, status);
         c->atom(NIL);
     }
 }
 
+void Engine::calibrateClockChecks(qint64 elapsed) {
+    qint64 target = static_cast<qint64>(TUNING_PARAM_INTERPRET_QUANTUM) *
+            1000000 / TUNING_PARAM_CLOCK_CHECKS_PER_QUANTUM;
+    if (elapsed <= 0) {
+        elapsed = 1;
+    }
+    // Move half way towards the number of op codes which would have hit the
+    // target, so that a single expensive op code doesn't reset everything.
+    double ideal = static_cast<double>(opsPerClockCheck) * target / elapsed;
+    double next = (opsPerClockCheck + ideal) / 2;
+    if (next < TUNING_PARAM_MIN_OPS_PER_CLOCK_CHECK) {
+        opsPerClockCheck = TUNING_PARAM_MIN_OPS_PER_CLOCK_CHECK;
+    } else if (next > TUNING_PARAM_MAX_OPS_PER_CLOCK_CHECK) {
+        opsPerClockCheck = TUNING_PARAM_MAX_OPS_PER_CLOCK_CHECK;
+    } else {
+        opsPerClockCheck = static_cast<Word>(next);
+    }
+}
+
+void Engine::recordSample() {
+    QString stack = toSimpleString(currentFile) +
+                    ":" +
+                    numberToString(currentLine);
+    Atom pos = p->atom();
+    while(isCons(pos)) {
+        Cell cell = storage.getCons(pos);
+        if (!isCons(cell.car)) {
+            break;
+        }
+        Cell location = storage.getCons(cell.car);
+        stack = toSimpleString(location.car) +
+                ":" +
+                toSimpleString(location.cdr) +
+                ";" +
+                stack;
+        pos = cell.cdr;
+    }
+    samplingProfiler.record(stack);
+}
+
 QString Engine::stackDump() {
     QString buffer;
     buffer += "Stacktrace:\n";
@@ -1015,9 +1730,14 @@ QString Engine::lookupSource(const QString& fileName) {
 
 Atom Engine::compileFile(const QString& file, bool insertStop) {
     QString path = lookupSource(file);
-    QFile f(path);
-    if (f.open(QFile::ReadOnly | QFile::Text)) {
-        return compileSource(path, f.readAll(), insertStop, false);
+    // The source is decoded directly from the mapped file, instead of
+    // being copied into a QByteArray first...
+    MappedFile f(path);
+    if (f.isValid()) {
+        return compileSource(path,
+                             f.decode(0, f.size()),
+                             insertStop,
+                             false);
     } else {
         panic(QString("Cannot compile: ") +
               path +
@@ -1026,6 +1746,19 @@ Atom Engine::compileFile(const QString& file, bool insertStop) {
     }
 }
 
+void Engine::loadStartupScript() {
+    QFileInfo startScript = QFileInfo(home().absoluteFilePath("start.pi"));
+    if (!startScript.exists()) {
+        startScript =  QFileInfo("start.pi");
+    }
+    if (startScript.exists()) {
+        MappedFile file(startScript.absoluteFilePath());
+        if (file.isValid()) {
+            eval(file.decode(0, file.size()), startScript.fileName(), false);
+        }
+    }
+}
+
 Atom Engine::compileSource(const QString& file,
                            const QString& source,
                            bool insertStop,
@@ -1061,6 +1794,9 @@ void Engine::call(Atom list) {
     if (!isCons(list)) {
         return;
     }
+    // The given code might only be referenced by the caller (e.g. a freshly
+    // compiled file) and must survive the allocations below.
+    AtomRef code(&storage, list);
     push(d, e->atom());
     push(d, s->atom());
     push(d, c->atom());
@@ -1078,7 +1814,7 @@ void Engine::call(Atom list) {
     }
     //If not, append an RTN.
     if (cell.car != SYMBOL_OP_RTN) {
-        cell.cdr = storage.makeCons(SYMBOL_OP_RTN, NIL);
+        storage.setCDR(tmp, storage.makeCons(SYMBOL_OP_RTN, NIL));
     }
     c->atom(list);
     push(d, c->atom());
@@ -1218,10 +1954,119 @@ QString Engine::toSimpleString(std::set<Atom>& visitedCells, Atom atom) {
 void Engine::initializeBIF() {
     CoreExtension::INSTANCE->registerBuiltInFunctions(this);
     FilesExtension::INSTANCE->registerBuiltInFunctions(this);
+    CoroutineExtension::INSTANCE->registerBuiltInFunctions(this);
+    ParallelExtension::INSTANCE->registerBuiltInFunctions(this);
+    DataExtension::INSTANCE->registerBuiltInFunctions(this);
+    RegexExtension::INSTANCE->registerBuiltInFunctions(this);
+    VectorExtension::INSTANCE->registerBuiltInFunctions(this);
+}
+
+void Engine::setValue(Atom name, Atom value) {
+    if (name == SYMBOL_VALUE_PROFILE_OP_SEQUENCES) {
+        profileSequences = (value == SYMBOL_TRUE);
+        if (profileSequences) {
+            sequenceProfiler.reset();
+        }
+    }
+    if (name == SYMBOL_VALUE_PROFILE_OPS) {
+#ifdef OP_PROFILING
+        profileOps = (value == SYMBOL_TRUE);
+        if (profileOps) {
+            opProfiler.reset();
+        }
+#else
+        if (value == SYMBOL_TRUE) {
+            ERROR(log, "The op profiler requires a build with OP_PROFILING");
+        }
+#endif
+    }
+    if (name == SYMBOL_VALUE_JIT_ENABLED) {
+        if (isNumber(value) && storage.getNumber(value) > 0) {
+            jit.setThreshold(storage.getNumber(value));
+            jit.setEnabled(true);
+        } else {
+            jit.setEnabled(value == SYMBOL_TRUE);
+        }
+    }
+    if (name == SYMBOL_VALUE_JIT_PERF_MAP) {
+        jit.setPerfMapEnabled(value == SYMBOL_TRUE);
+    }
+    if (name == SYMBOL_VALUE_PROFILE_SAMPLES) {
+        if (isNumber(value) && storage.getNumber(value) > 0) {
+            samplingProfiler.start(storage.getNumber(value));
+        } else if (value == SYMBOL_TRUE) {
+            samplingProfiler.start(TUNING_PARAM_SAMPLING_INTERVAL);
+        } else {
+            samplingProfiler.stop();
+        }
+    }
 }
 
-void Engine::setValue(Atom, Atom) {
+Atom Engine::reportOpSequences() {
+    std::vector< std::pair<Word, Word> > sequences =
+            sequenceProfiler.mostFrequent(
+                TUNING_PARAM_NUM_REPORTED_OP_SEQUENCES);
+    ListBuilder result(&storage);
+    for(std::vector< std::pair<Word, Word> >::iterator
+        i = sequences.begin();
+        i != sequences.end();
+        ++i)
+    {
+        ListBuilder entry(&storage);
+        entry.append(storage.makeNumber(i->first));
+        std::vector<Atom> ops = SequenceProfiler::decode(i->second);
+        for(std::vector<Atom>::iterator
+            op = ops.begin();
+            op != ops.end();
+            ++op)
+        {
+            entry.append(*op);
+        }
+        result.append(entry.getResult());
+    }
+    return result.getResult();
+}
+
+Atom Engine::reportOpProfile() {
+    std::vector<ProfileEntry> entries = opProfiler.report();
+    ListBuilder result(&storage);
+    for(std::vector<ProfileEntry>::iterator
+        i = entries.begin();
+        i != entries.end();
+        ++i)
+    {
+        ListBuilder entry(&storage);
+        entry.append(i->name);
+        entry.append(storage.makeNumber(i->count));
+        entry.append(storage.makeNumber(i->cycles));
+        result.append(entry.getResult());
+    }
+    return result.getResult();
+}
+
+Atom Engine::reportSamples() {
+    std::vector< std::pair<Word, QString> > samples =
+            samplingProfiler.report();
+    ListBuilder result(&storage);
+    for(std::vector< std::pair<Word, QString> >::iterator
+        i = samples.begin();
+        i != samples.end();
+        ++i)
+    {
+        ListBuilder entry(&storage);
+        entry.append(storage.makeString(i->second));
+        entry.append(storage.makeNumber(i->first));
+        result.append(entry.getResult());
+    }
+    return result.getResult();
+}
+
+SamplingProfiler* Engine::getSamplingProfiler() {
+    return &samplingProfiler;
+}
 
+Storage* Engine::getStorage() {
+    return &storage;
 }
 
 Atom Engine::getValue(Atom name) {
@@ -1263,6 +2108,24 @@ Atom Engine::getValue(Atom name) {
         return storage.makeNumber(storage.statusArraysUsed());
     } else if (name == SYMBOL_VALUE_HOME_PATH) {
         return storage.makeString(homeDir.absolutePath());
+    } else if (name == SYMBOL_VALUE_PROFILE_OP_SEQUENCES) {
+        return profileSequences ? SYMBOL_TRUE : SYMBOL_FALSE;
+    } else if (name == SYMBOL_VALUE_OP_SEQUENCES) {
+        return reportOpSequences();
+    } else if (name == SYMBOL_VALUE_PROFILE_OPS) {
+        return profileOps ? SYMBOL_TRUE : SYMBOL_FALSE;
+    } else if (name == SYMBOL_VALUE_OP_PROFILE) {
+        return reportOpProfile();
+    } else if (name == SYMBOL_VALUE_PROFILE_SAMPLES) {
+        return samplingProfiler.isRunning() ? SYMBOL_TRUE : SYMBOL_FALSE;
+    } else if (name == SYMBOL_VALUE_SAMPLES) {
+        return reportSamples();
+    } else if (name == SYMBOL_VALUE_JIT_ENABLED) {
+        return jit.isEnabled() ? SYMBOL_TRUE : SYMBOL_FALSE;
+    } else if (name == SYMBOL_VALUE_JIT_BLOCKS) {
+        return storage.makeNumber(jit.getNumberOfBlocks());
+    } else if (name == SYMBOL_VALUE_JIT_PERF_MAP) {
+        return jit.isPerfMapEnabled() ? SYMBOL_TRUE : SYMBOL_FALSE;
     }
 
     return NIL;
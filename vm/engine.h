@@ -27,6 +27,11 @@
 
 #include "vm/env.h"
 #include "vm/storage.h"
+#include "vm/profiler.h"
+#include "vm/jit.h"
+#include "vm/submissionqueue.h"
+#include "vm/coroutine.h"
+#include "vm/asyncoperation.h"
 #include "tools/logger.h"
 
 #include <deque>
@@ -36,6 +41,9 @@
 #include <QElapsedTimer>
 #include <QSettings>
 #include <QDir>
+#include <QMutex>
+#include <QThreadPool>
+#include <QAtomicInt>
 
 /**
    Forward reference - see: callcontext.h
@@ -57,6 +65,11 @@ struct Execution {
     QString filename;
     AtomRef* fn;
     bool printStackTop;
+    /**
+      If not NULL, receives the stack top once the execution completes
+      (see Engine::call()).
+      */
+    AtomRef* result;
 };
 
 
@@ -106,18 +119,126 @@ private:
     /**
       Used to interrupt the current execution.
       */
-    volatile bool running;
+    QAtomicInt running;
 
     /**
-      Keeps items to be executed.
+      Keeps items to be executed. This is only accessed by the thread which
+      runs the engine - other threads submit work via submissions.
       */
     std::deque<Execution> executionStack;
 
+    /**
+      Receives work submitted via eval or evalFn, which is moved to the
+      executionStack by acceptSubmissions().
+      */
+    SubmissionQueue submissions;
+
+    /**
+      Performs the AsyncOperations started via runAsync().
+      */
+    QThreadPool asyncPool;
+
+    /**
+      Contains the number of AsyncOperations which are not yet completed.
+      */
+    QAtomicInt pendingOperations;
+
+    /**
+      Incremented by discardExecutions(), so that continuations of
+      operations which were started before are discarded.
+      */
+    Word generation;
+
+    /**
+      Set by fullstop() (usually from another thread) and handled by the
+      next call of interpret().
+      */
+    QAtomicInt stopRequested;
+
+    /**
+      Contains the running coroutine. This is only created once the current
+      execution spawns its first coroutine.
+      */
+    QSharedPointer<Coroutine> currentCoroutine;
+
+    /**
+      Contains the coroutines which are ready to run, in the order they are
+      scheduled.
+      */
+    std::deque< QSharedPointer<Coroutine> > runQueue;
+
+    /**
+      Contains all coroutines created by the current execution, so that
+      they can be released once it is discarded - including the ones which
+      wait on a channel forever. Finished coroutines are removed once the
+      list reaches coroutinesPruneLimit.
+      */
+    std::vector< QSharedPointer<Coroutine> > coroutines;
+    size_t coroutinesPruneLimit;
+
+    /**
+      Set if the current coroutine was suspended by a built in function.
+      The next coroutine is loaded once the current op code is completed.
+      */
+    bool switchRequested;
+
+    /**
+      Determines if interpret() runs until the engine stops, instead of
+      returning after TUNING_PARAM_INTERPRET_QUANTUM.
+      */
+    bool headless;
+
+    /**
+      Contains the calibrated number of op codes which are executed between
+      two checks of the clock in interpret().
+      */
+    Word opsPerClockCheck;
+
+    /**
+      Adapts opsPerClockCheck, given the number of nanoseconds the last
+      opsPerClockCheck op codes took.
+      */
+    void calibrateClockChecks(qint64 elapsed);
+
     /**
       Conts the total instructions executed.
       */
     Word instructionCounter;
 
+    /**
+      Counts the panics which aborted an execution.
+      */
+    Word panicCounter;
+
+    /**
+      Determines if the executed op code sequences are recorded by the
+      sequenceProfiler.
+      */
+    bool profileSequences;
+
+    /**
+      Records the executed op code sequences if profileSequences is true.
+      */
+    SequenceProfiler sequenceProfiler;
+
+    /**
+      Determines if the cycles spent per op code and per built in function
+      are recorded by the opProfiler. Can only be enabled if the engine was
+      built with OP_PROFILING defined.
+      */
+    bool profileOps;
+
+    /**
+      Records executions and cycles per op code and built in function if
+      profileOps is true.
+      */
+    OpProfiler opProfiler;
+
+    /**
+      Records the call stack whenever its timer requests a sample.
+      */
+    SamplingProfiler samplingProfiler;
+
     /**
       Represents the stack register on which most of the computations are
       performed.
@@ -148,6 +269,17 @@ private:
       */
     AtomRef* const p;
 
+    /**
+      Represents the argument register. Keeps the arguments of a built in
+      function referenced, while it is executed.
+      */
+    AtomRef* const a;
+
+    /**
+      Compiles hot functions into native code.
+      */
+    JitCompiler jit;
+
     /**
       Returns the nth item of the given list or register.
       */
@@ -179,9 +311,22 @@ private:
     Word currentLine;
 
     /**
-      Maps symbols to unique BIF indices
+      Maps symbols to unique BIF indices. The table is shared by all engines.
+      It is filled by the first call of initialize() and only read
+      afterwards, therefore lookups don't need any locking.
+      */
+    static LookupTable <Word, BIF, Word> bifTable;
+
+    /**
+      Guards the initialization of the bifTable.
       */
-    LookupTable <Word, BIF, Word> bifTable;
+    static QMutex bifLock;
+
+    /**
+      Determines if the bifTable is completely initialized and must no
+      longer be modified.
+      */
+    static bool bifTableFrozen;
 
     /**
       Contains the path to the pimii installation.
@@ -198,6 +343,17 @@ private:
       */
     inline void dispatch(Atom opcode);
 
+    /**
+      Executes the given bytecode, without any bookkeeping.
+      */
+    inline void execute(Atom opcode);
+
+    /**
+      Invokes the given built in function. If the op profiler is active, the
+      cycles spent are recorded.
+      */
+    inline void invokeBuiltInFunction(Atom fun, const CallContext& ctx);
+
     /**
       * Converts two numeric atoms into double values.
       */
@@ -208,30 +364,112 @@ private:
       */
     void dispatchArithmetic(Atom opcode);
 
+    /**
+      Computes the given arithmetic operation for the two given values.
+      */
+    Atom evaluateArithmetic(Atom opcode, Atom atoma, Atom atomb);
+
+    /**
+      Invokes the appropriate comparison for the given bytecode.
+      */
+    void dispatchRelation(Atom opcode);
+
+    /**
+      Evaluates the given relation (#EQ, #NE, #LT...) for the two given
+      values and returns either #TRUE or #FALSE.
+      */
+    Atom evaluateRelation(Atom opcode, Atom a, Atom b);
+
+    /**
+      Evaluates the given relation for two small numbers. As both share
+      the same tag, the tagged atoms are ordered like their values and can
+      be compared directly.
+      */
+    inline Atom evaluateSmallRelation(Atom opcode, Atom a, Atom b) {
+        Number na = static_cast<Number>(a);
+        Number nb = static_cast<Number>(b);
+        bool result;
+        switch(opcode) {
+        case SYMBOL_OP_EQ:
+            result = na == nb;
+            break;
+        case SYMBOL_OP_NE:
+            result = na != nb;
+            break;
+        case SYMBOL_OP_LT:
+            result = na < nb;
+            break;
+        case SYMBOL_OP_LTQ:
+            result = na <= nb;
+            break;
+        case SYMBOL_OP_GT:
+            result = na > nb;
+            break;
+        case SYMBOL_OP_GTQ:
+            result = na >= nb;
+            break;
+        default:
+            panic(QString("Invalid relation: ") + toString(opcode));
+            return SYMBOL_FALSE;
+        }
+        return result ? SYMBOL_TRUE : SYMBOL_FALSE;
+    }
+
     /**
       Used to lookup a location on the environment stack.
       */
     Atom locate(Atom pos);
 
+    /**
+      Used to lookup the location with the given (already decoded) indices
+      on the environment stack.
+      */
+    Atom locate(Number i, Number j);
+
+    /**
+      Looks up a location which was already checked by the Verifier. The
+      position is decoded without any further checks.
+      */
+    inline Atom locateUnchecked(Atom pos) {
+        Cell cons = storage.getCons(pos);
+        return locate(untagSmallNumber(cons.car), untagSmallNumber(cons.cdr));
+    }
+
     /**
       Used to wrtie a value on the environment stack.
       */
     void store(Atom pos, Atom value);
 
+    /**
+      Used to write a value to the location with the given (already
+      decoded) indices on the environment stack.
+      */
+    void store(Number i, Number j, Atom value);
+
+    /**
+      Writes to a location which was already checked by the Verifier (see
+      locateUnchecked).
+      */
+    inline void storeUnchecked(Atom pos, Atom value) {
+        Cell cons = storage.getCons(pos);
+        store(untagSmallNumber(cons.car), untagSmallNumber(cons.cdr), value);
+    }
+
     /**
       Pushes NIL onto the stack.
       */
     inline void opNIL();
 
     /**
-      Loads a given location on the stack.
+      Loads a given location on the stack. If checked is false, the code
+      was verified and the position is used without any checks (#LDU).
       */
-    inline void opLD();
+    inline void opLD(bool checked);
 
     /**
-      Stores the stack top on a location.
+      Stores the stack top on a location (see opLD).
       */
-    inline void opST();
+    inline void opST(bool checked);
 
     /**
       Loads a constant onto the stack.
@@ -248,6 +486,36 @@ private:
       */
     void opAP(bool hasArguments);
 
+    /**
+      Invokes the given closure or built in function with the given
+      arguments. The caller has to make sure, that fun and args are
+      referenced, as the GC might run while the call is set up. The name is
+      only used for error messages.
+      */
+    void apply(Atom name, Atom fun, Atom args);
+
+    /**
+      Invokes a function with the given number of arguments which are
+      taken from the stack. The given stack cell contains the last
+      argument, the cells below contain the preceeding ones. These cells are
+      re-used as environment frame of a closure, therefore no argument list
+      needs to be created. The stack cells must still be referenced by s
+      and fun has to be referenced, as the GC might run while the call is
+      set up.
+      */
+    void applyStackArguments(Atom name, Atom fun, Atom stack, int count);
+
+    /**
+      Invokes a function with the given number of arguments on the stack.
+      */
+    void opAPN(int count);
+
+    /**
+      Reverses the stack cells from stack up to (excluding) rest in place,
+      so that they form the list of arguments in the order of declaration.
+      */
+    Atom reverseStackArguments(Atom stack, Atom rest);
+
     /**
       Returns from a function.
       */
@@ -259,14 +527,15 @@ private:
     inline void opBT();
 
     /**
-      Loads a global onto the stack.
+      Loads a global onto the stack. If checked is false, the code was
+      verified and the operand is known to be a global (#LDGU).
       */
-    void opLDG();
+    void opLDG(bool checked);
 
     /**
-      Stores the stack top in a global.
+      Stores the stack top in a global (see opLDG).
       */
-    void opSTG();
+    void opSTG(bool checked);
 
     /**
       Returns the CAR field of the stack top.
@@ -294,10 +563,17 @@ private:
     void opCONS();
 
     /**
-      Splits a given cons cell.
+      Splits a given cons cell. A Sequence is split into its next element
+      and itself.
       */
     void opSPLIT();
 
+    /**
+      Fetches the next element of the given Sequence. Returns false if the
+      atom is no sequence or if it is exhausted.
+      */
+    bool nextElement(Atom sequence, AtomRef* value);
+
     /**
       Pops a list and a value from the stack,
       and appends the value to the list.
@@ -327,29 +603,22 @@ private:
     Relation compareNumerics(Atom a, Atom b);
 
     /**
-      Compares two atoms pointing to list values.
+      Compares two small numbers without decoding them.
       */
-    Relation compareLists(Atom a, Atom b);
-
-    /**
-      Implements the equals operation for numbers, strings, symbols
-      and cons-cells. This does not work with complete lists (yet)!
-      */
-    void opEQ();
-
-    /**
-      Opposite of EQ
-      */
-    void opNE();
+    inline Relation compareSmallNumbers(Atom a, Atom b) {
+        if (static_cast<Number>(a) < static_cast<Number>(b)) {
+            return LT;
+        } else if (a == b) {
+            return EQ;
+        } else {
+            return GT;
+        }
+    }
 
     /**
-      Compares two given elements with natural order
-      (everything except lists)
+      Compares two atoms pointing to list values.
       */
-    void opLT();
-    void opGT();
-    void opLTQ();
-    void opGTQ();
+    Relation compareLists(Atom a, Atom b);
 
     /**
       Concatenates lists or strings. Therefore at least on argument
@@ -371,9 +640,75 @@ private:
     void opFile();
 
     /**
-      Sets the line info of the interpreter.
+      Sets the line info of the interpreter. If checked is false, the
+      operand is known to be a small number (#LINEU).
+      */
+    void opLine(bool checked);
+
+    /**
+      Superinstruction: Loads a location, combines it with a constant using
+      the given arithmetic operation and pushes the result. Also handles
+      the unchecked variants #LDADDCU and #LDSUBCU.
+      */
+    void opLDArithmeticC(Atom opcode);
+
+    /**
+      Superinstruction: Compares a location with a constant and branches if
+      the relation holds. If checked is false, the position is used without
+      any checks (#TESTCU).
+      */
+    void opTESTC(bool checked);
+
+    /**
+      Counts the invocations of a function. Once it is hot, it is compiled
+      by the JIT and its native code is executed from then on.
+      */
+    void opENTRY();
+
+    /**
+      Executes a block compiled by the JIT.
+      */
+    void opJIT();
+
+    /**
+      Superinstruction: Loads a global and invokes it either without
+      arguments or with the given number of arguments on the stack (see
+      #AP1). Each call site carries
+      an inline cache (version . fun) which remembers the resolved closure or
+      built in function as long as the version of the globals table doesn't
+      change.
+      */
+    void opCALLG(bool hasArguments);
+
+    /**
+      Returns the function to call for the given global. Uses and updates
+      the given inline cache of the call site.
+      */
+    Atom resolveCallTarget(Atom global, Atom cache);
+
+    /**
+      Returns the most frequent op code sequences recorded by the
+      sequenceProfiler.
+      */
+    Atom reportOpSequences();
+
+    /**
+      Returns the executions and cycles recorded by the opProfiler as list
+      of (name count cycles) entries.
+      */
+    Atom reportOpProfile();
+
+    /**
+      Records the current position and all positions on the call stack (p)
+      as sample in the samplingProfiler.
+      */
+    void recordSample();
+
+    /**
+      Returns the stacks recorded by the samplingProfiler as list of
+      (stack count) entries.
       */
-    void opLine();
+    Atom reportSamples();
 
     /**
       Converts the given list into a string.
@@ -416,6 +751,44 @@ private:
       */
     void stopEngine();
 
+    /**
+      Moves all pending submissions to the executionStack. Source code is
+      compiled at this point.
+      */
+    void acceptSubmissions();
+
+    /**
+      Removes all executions from the executionStack.
+      */
+    void discardExecutions();
+
+    /**
+      Saves the registers of the current coroutine and loads the next one
+      of the runQueue.
+      */
+    void switchCoroutine();
+
+    /**
+      Called if a coroutine, which is not a root, executes #STOP.
+      */
+    void finishCoroutine();
+
+    /**
+      Drops all coroutines of the current execution.
+      */
+    void discardCoroutines();
+
+    /**
+      Adds the given coroutine to the coroutines of the current execution.
+      */
+    void trackCoroutine(const QSharedPointer<Coroutine>& coroutine);
+
+    /**
+      Generates the code which applies fn to the given list of arguments
+      and then stops: #LDC args #LDC fn #AP name #STOP
+      */
+    Atom makeApplyCode(Atom fn, Atom args, const char* name);
+
     Q_DISABLE_COPY(Engine)
 
 signals:
@@ -449,20 +822,34 @@ signals:
 
 public slots:
     /**
-      Compiles and loads the given source. Will be pushed on the
-      "executionStack".
+      Submits the given source for execution. It is compiled and pushed on
+      the "executionStack" by the next call of interpret(). Can be called
+      from any thread.
       */
     void eval(const QString& source,
               const QString& filename,
               bool printStackTop);
 
     /**
-      Scheduled the given function for execution.
+      Scheduled the given function for execution. Must only be called by
+      the thread which runs the engine.
+      */
+    void evalFn(const QString& filename, Atom fn, bool printStackTop = false);
+
+    /**
+      Applies fn to the given list of arguments and interprets until this
+      is completed. The result is stored in result. Returns false if a
+      panic occurred (see getLastError()).
+
+      This is used to run code in an isolate which is owned by the calling
+      thread and otherwise idle.
       */
-    void evalFn(const QString& filename, Atom fn);
+    bool call(Atom fn, Atom args, AtomRef* result);
 
     /**
-      Terminates the current and all pending executions.
+      Terminates the current and all pending executions. Can be called from
+      any thread, the executions are terminated by the next call of
+      interpret().
       */
     void fullstop();
 
@@ -515,6 +902,12 @@ public:
         return homeDir;
     }
 
+    /**
+      Submits "start.pi" for execution. This is searched in the current
+      directory first and then in the home directory.
+      */
+    void loadStartupScript();
+
     /**
       Compiles the given file and returns the given bytecode. If an error
       occures during compilation an appropriate message is shown and the
@@ -540,12 +933,14 @@ public:
     void call(Atom list);
 
     /**
-      Registers a built in function.
+      Registers a built in function. This is only permitted while
+      initialize() registers the extensions, as the table is shared by all
+      engines.
       */
     Atom makeBuiltInFunction(Atom nameSymbol, BIF value);
 
     /**
-      Registers a built in function.
+      Registers a built in function (see above).
       */
     Atom makeBuiltInFunction(const char* name, BIF value);
 
@@ -580,17 +975,116 @@ public:
     QString toSimpleString(Atom atom);
 
     /**
-      Continues the current evaluation.
+      Continues the current evaluation. Returns once the engine stops or
+      TUNING_PARAM_INTERPRET_QUANTUM elapsed, so that the UI can process
+      its events. In headless mode, interpret() only returns once the
+      engine stops.
+
+      If coroutines were spawned, the running one is switched between two
+      op codes, once it waits or after TUNING_PARAM_COROUTINE_SLICE op
+      codes (or a clock check in UI mode), if others are runnable.
       */
     void interpret();
 
+    /**
+      Enables or disables the headless mode (see interpret()).
+      */
+    void setHeadless(bool headless) {
+        this->headless = headless;
+    }
+
+    /**
+      Determines if the engine runs in headless mode.
+      */
+    bool isHeadless() {
+        return headless;
+    }
+
+    /**
+      Returns the total number of executed op codes.
+      */
+    Word getInstructionCount() {
+        return instructionCounter;
+    }
+
+    /**
+      Returns the number of panics which occurred so far.
+      */
+    Word getPanicCount() {
+        return panicCounter;
+    }
+
+    /**
+      Returns the message of the last panic.
+      */
+    QString getLastError() {
+        return lastError;
+    }
+
     /**
       Returns if the engine has executable work to run.
       */
     bool isRunnable();
 
     /**
-      Flushes the execution stack and stops the engine.
+      Blocks until new work is submitted or fullstop() is called.
+      */
+    void waitForSubmissions();
+
+    /**
+      Starts the given operation in the background. Once it is completed,
+      the given continuation is applied to the arguments created by the
+      operation, as a new execution. The engine takes ownership of the
+      operation. Must only be called by the thread which runs the engine.
+      */
+    void runAsync(AsyncOperation* operation, Atom continuation);
+
+    /**
+      Schedules the continuation of the given operation. Called by the
+      thread which performed the operation.
+      */
+    void completeAsync(AsyncOperation* operation);
+
+    /**
+      Returns if there are operations whose continuations are not yet
+      submitted.
+      */
+    bool hasPendingOperations();
+
+    /**
+      Creates a coroutine which applies fn to the given list of arguments.
+      It is appended to the runQueue.
+      */
+    QSharedPointer<Coroutine> spawn(Atom fn, Atom args);
+
+    /**
+      Returns the running coroutine. If the current execution has not yet
+      spawned any coroutines, the root coroutine is created.
+      */
+    QSharedPointer<Coroutine> getCurrentCoroutine();
+
+    /**
+      Lets the other runnable coroutines run, before the current one
+      continues.
+      */
+    void yield();
+
+    /**
+      Suspends the current coroutine once the current built in function
+      returns. The caller has to keep track of the coroutine and resume it
+      later.
+      */
+    void suspend();
+
+    /**
+      Makes the given suspended coroutine runnable again. Its pending built
+      in function call will return the given value.
+      */
+    void resume(const QSharedPointer<Coroutine>& coroutine, Atom value);
+
+    /**
+      Flushes the execution stack and stops the engine. Must only be called
+      by the thread which runs the engine, other threads use fullstop().
       */
     void terminate();
 
@@ -605,7 +1099,8 @@ public:
     void initializeSourceLookup();
 
     /**
-      Initializes the engine.
+      Initializes the engine. The built in functions are only registered
+      by the first engine, as they are shared by all engines.
       */
     void initialize();
 
@@ -625,7 +1120,20 @@ public:
       */
     Atom getValue(Atom name);
 
+    /**
+      Provides access to the sampling profiler, so that it can be controlled
+      outside of scripts.
+      */
+    SamplingProfiler* getSamplingProfiler();
+
+    /**
+      Provides access to the storage, so that its statistics can be reported
+      outside of scripts.
+      */
+    Storage* getStorage();
+
     friend class Compiler;
+    friend class JitCompiler;
 };
 
 #endif // ENGINE_H
@@ -0,0 +1,44 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+
+#include "vm/enginethread.h"
+
+#include <QMetaType>
+
+EngineThread::EngineThread(Engine* engine) : engine(engine), active(true) {
+    // Required to deliver the signals of the engine (e.g. onEnginePanic)
+    // via queued connections.
+    qRegisterMetaType<Atom>("Atom");
+    qRegisterMetaType<Word>("Word");
+}
+
+void EngineThread::shutdown() {
+    active.fetchAndStoreOrdered(false);
+    engine->fullstop();
+}
+
+void EngineThread::run() {
+    while(active) {
+        if (engine->isRunnable()) {
+            engine->interpret();
+        } else {
+            engine->waitForSubmissions();
+        }
+    }
+}
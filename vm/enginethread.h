@@ -0,0 +1,74 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+/**
+  ---------------------------------------------------------------------------
+  Contains the thread which runs the engine in the background.
+  ---------------------------------------------------------------------------
+  */
+
+#ifndef ENGINETHREAD_H
+#define ENGINETHREAD_H
+
+#include <QThread>
+
+#include "vm/engine.h"
+
+/**
+  Runs the given engine in its own thread, so that long computations don't
+  block the UI and the UI doesn't slow down the computation.
+
+  Work is passed in via Engine::eval, which only enqueues the source code
+  in a lock-free SubmissionQueue. Everything else (compiling, executing and
+  accessing the storage) happens within this thread. The signals of the
+  engine, and log messages received by an EditorWindow, are delivered to
+  the UI via queued connections.
+
+  While executing, the engine returns after each quantum (see
+  TUNING_PARAM_INTERPRET_QUANTUM) so that new submissions and stop
+  requests are noticed. If there is nothing to do, the thread sleeps until
+  the next submission arrives.
+  */
+class EngineThread : public QThread
+{
+private:
+    /**
+      Contains the engine which is run by this thread.
+      */
+    Engine* engine;
+
+    /**
+      Determines if the thread should continue to run.
+      */
+    QAtomicInt active;
+
+    Q_DISABLE_COPY(EngineThread)
+public:
+    EngineThread(Engine* engine);
+
+    /**
+      Stops the current execution and requests the thread to terminate.
+      Use wait() to await its termination.
+      */
+    void shutdown();
+
+protected:
+    virtual void run();
+};
+
+#endif // ENGINETHREAD_H
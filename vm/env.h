@@ -27,6 +27,7 @@
 #define ENV_H
 
 #include <cassert>
+#include <limits>
 #include <sstream>
 
 #include <QString>
@@ -432,11 +433,138 @@ const Atom SYMBOL_OP_RPLCAR = SYMBOL(OP_CODE_INDEX + 36);
   */
 const Atom SYMBOL_OP_RPLCDR = SYMBOL(OP_CODE_INDEX + 37);
 
+/**
+  Superinstruction: Short form of: #LD pos #LDC k #ADD
+  */
+const Atom SYMBOL_OP_LDADDC = SYMBOL(OP_CODE_INDEX + 38);
+
+/**
+  Superinstruction: Short form of: #LD pos #LDC k #SUB
+  */
+const Atom SYMBOL_OP_LDSUBC = SYMBOL(OP_CODE_INDEX + 39);
+
+/**
+  Superinstruction: Short form of: #LD pos #LDC k <relation> #BT list.
+  Followed by the location, the constant, the relation op code and the
+  list to branch into.
+  */
+const Atom SYMBOL_OP_TESTC = SYMBOL(OP_CODE_INDEX + 40);
+
+/**
+  Superinstruction: Short form of: #LDG global #AP<n> name or
+  #LDG global #APV n name. Followed by the global, the name, the number of
+  arguments and the inline cache of the call site.
+  */
+const Atom SYMBOL_OP_CALLG = SYMBOL(OP_CODE_INDEX + 41);
+
+/**
+  Superinstruction: Short form of: #LDG global #AP0 name
+  */
+const Atom SYMBOL_OP_CALLG0 = SYMBOL(OP_CODE_INDEX + 42);
+
+/**
+  Op code: Invokes a function with one argument. The argument is taken from
+  the stack, below the function, without creating an argument list.
+  */
+const Atom SYMBOL_OP_AP1 = SYMBOL(OP_CODE_INDEX + 43);
+
+/**
+  Op code: Invokes a function with two arguments (see #AP1).
+  */
+const Atom SYMBOL_OP_AP2 = SYMBOL(OP_CODE_INDEX + 44);
+
+/**
+  Op code: Invokes a function with three arguments (see #AP1).
+  */
+const Atom SYMBOL_OP_AP3 = SYMBOL(OP_CODE_INDEX + 45);
+
+/**
+  Op code: Invokes a function with four arguments (see #AP1).
+  */
+const Atom SYMBOL_OP_AP4 = SYMBOL(OP_CODE_INDEX + 46);
+
+/**
+  Op code: Invokes a function with the given number of arguments, which
+  are taken from the stack (see #AP1). Used for calls with more than
+  MAX_STACK_ARGUMENTS arguments.
+  */
+const Atom SYMBOL_OP_APV = SYMBOL(OP_CODE_INDEX + 47);
+
+/**
+  Op code: Starts each function body. The operand counts the invocations
+  of the function. Once it becomes hot, the function is compiled by the
+  JitCompiler and the operand is replaced by -1 - index of the native
+  block which is then executed instead.
+  */
+const Atom SYMBOL_OP_ENTRY = SYMBOL(OP_CODE_INDEX + 48);
+
+/**
+  Op code: Executes the native block with the given index (see
+  JitCompiler). The interpreted op codes of the block follow, so that
+  the block can bail out to the interpreter at any point.
+  */
+const Atom SYMBOL_OP_JIT = SYMBOL(OP_CODE_INDEX + 49);
+
+/**
+  Unchecked variant of #LD. Only used in code which passed the Verifier,
+  which ensures that the operand is a valid position (i . j).
+  */
+const Atom SYMBOL_OP_LDU = SYMBOL(OP_CODE_INDEX + 50);
+
+/**
+  Unchecked variant of #ST (see #LDU).
+  */
+const Atom SYMBOL_OP_STU = SYMBOL(OP_CODE_INDEX + 51);
+
+/**
+  Unchecked variant of #LDG. The Verifier ensures that the operand is a
+  global.
+  */
+const Atom SYMBOL_OP_LDGU = SYMBOL(OP_CODE_INDEX + 52);
+
+/**
+  Unchecked variant of #STG (see #LDGU).
+  */
+const Atom SYMBOL_OP_STGU = SYMBOL(OP_CODE_INDEX + 53);
+
+/**
+  Unchecked variant of #LINE. The Verifier ensures that the operand is a
+  small number.
+  */
+const Atom SYMBOL_OP_LINEU = SYMBOL(OP_CODE_INDEX + 54);
+
+/**
+  Unchecked variant of #LDADDC (see #LDU).
+  */
+const Atom SYMBOL_OP_LDADDCU = SYMBOL(OP_CODE_INDEX + 55);
+
+/**
+  Unchecked variant of #LDSUBC (see #LDU).
+  */
+const Atom SYMBOL_OP_LDSUBCU = SYMBOL(OP_CODE_INDEX + 56);
+
+/**
+  Unchecked variant of #TESTC (see #LDU).
+  */
+const Atom SYMBOL_OP_TESTCU = SYMBOL(OP_CODE_INDEX + 57);
+
+/**
+  Contains the maximal number of arguments which have a specialized op
+  code (#AP1 .. #AP4).
+  */
+const int MAX_STACK_ARGUMENTS = 4;
+
+/**
+  Contains the number of known op codes. All op codes are within
+  OP_CODE_INDEX and OP_CODE_INDEX + NUMBER_OF_OP_CODES - 1.
+  */
+const Word NUMBER_OF_OP_CODES = 58;
+
 /**
   Can be used to easily set the offset for all value symbols.
   These symbols are used by the setValue/getValue management extensions.
   */
-const Word VALUE_INDEX = OP_CODE_INDEX + 38;
+const Word VALUE_INDEX = OP_CODE_INDEX + NUMBER_OF_OP_CODES;
 
 /**
   Used to set/get the home path of the pimii installation.
@@ -533,17 +661,153 @@ const Atom SYMBOL_VALUE_NUM_TOTAL_ARRAYS = SYMBOL(VALUE_INDEX + 17);
   */
 const Atom SYMBOL_VALUE_NUM_ARRAYS_USED = SYMBOL(VALUE_INDEX + 18);
 
+/**
+  Used to enable (#TRUE) or disable (#FALSE) the op code sequence profiler.
+  */
+const Atom SYMBOL_VALUE_PROFILE_OP_SEQUENCES = SYMBOL(VALUE_INDEX + 19);
+
+/**
+  Used to get the most frequent op code sequences recorded by the profiler.
+  */
+const Atom SYMBOL_VALUE_OP_SEQUENCES = SYMBOL(VALUE_INDEX + 20);
+
+/**
+  Used to enable (#TRUE) or disable (#FALSE) the per op code profiler. This
+  is only available if the engine was built with OP_PROFILING defined.
+  */
+const Atom SYMBOL_VALUE_PROFILE_OPS = SYMBOL(VALUE_INDEX + 21);
+
+/**
+  Used to get the executions and cycles recorded per op code and per built
+  in function.
+  */
+const Atom SYMBOL_VALUE_OP_PROFILE = SYMBOL(VALUE_INDEX + 22);
+
+/**
+  Used to start (#TRUE or the sampling interval in milliseconds) or stop
+  (#FALSE) the sampling profiler.
+  */
+const Atom SYMBOL_VALUE_PROFILE_SAMPLES = SYMBOL(VALUE_INDEX + 23);
+
+/**
+  Used to get the call stacks recorded by the sampling profiler.
+  */
+const Atom SYMBOL_VALUE_SAMPLES = SYMBOL(VALUE_INDEX + 24);
+
+/**
+  Used to enable (#TRUE) or disable (#FALSE) the JIT compiler. A number
+  enables it and sets the number of invocations after which a function is
+  compiled.
+  */
+const Atom SYMBOL_VALUE_JIT_ENABLED = SYMBOL(VALUE_INDEX + 25);
+
+/**
+  Used to get the number of native blocks generated by the JIT compiler.
+  */
+const Atom SYMBOL_VALUE_JIT_BLOCKS = SYMBOL(VALUE_INDEX + 26);
+
+/**
+  Used to enable (#TRUE) or disable (#FALSE) announcing native blocks in
+  /tmp/perf-PID.map, so that perf can symbolize them.
+  */
+const Atom SYMBOL_VALUE_JIT_PERF_MAP = SYMBOL(VALUE_INDEX + 27);
+
 /**
   Determines the epsilon below two given doubles are equal.
   */
 const double DOUBLE_EQUALITY_EPSILON = 0.0000000001;
 
 /**
-  Contains the max. number of op codes, processed in one call to
-  Engine::interpret. This number should be kept in a reasonable range
-  because no UI update are processed during interpret().
+  Contains the time in milliseconds which is spent in one call to
+  Engine::interpret. This should be kept in a reasonable range because new
+  submissions and stop requests are only handled between two calls. Not
+  used in headless mode.
+  */
+const Word TUNING_PARAM_INTERPRET_QUANTUM = 20;
+
+/**
+  Contains the number of times the clock is checked within one quantum.
+  The number of op codes executed between two checks is calibrated, so
+  that this number is reached.
+  */
+const Word TUNING_PARAM_CLOCK_CHECKS_PER_QUANTUM = 10;
+
+/**
+  Contains the number of op codes executed before the clock is checked for
+  the first time.
+  */
+const Word TUNING_PARAM_INITIAL_OPS_PER_CLOCK_CHECK = 1000;
+
+/**
+  Limits the calibrated number of op codes between two clock checks.
+  */
+const Word TUNING_PARAM_MIN_OPS_PER_CLOCK_CHECK = 16;
+const Word TUNING_PARAM_MAX_OPS_PER_CLOCK_CHECK = 1024 * 1024;
+
+/**
+  Contains the number of op codes a coroutine runs in headless mode, before
+  it is preempted in favour of other runnable coroutines. Otherwise
+  coroutines are switched at each clock check.
+  */
+const Word TUNING_PARAM_COROUTINE_SLICE = 10000;
+
+/**
+  Contains the minimal number of coroutines an engine tracks, before the
+  finished ones are removed from the list.
+  */
+const Word TUNING_PARAM_MIN_COROUTINES_PRUNE_LIMIT = 64;
+
+/**
+  Contains the number of chunks per worker thread into which a collection
+  is split by parallel::map and parallel::reduce. Using more chunks than
+  workers permits to balance chunks which take longer than others.
+  */
+const Word TUNING_PARAM_PARALLEL_CHUNKS_PER_WORKER = 4;
+
+/**
+  Contains the max. number of threads per engine which perform blocking
+  operations, like reading files, in the background (see
+  Engine::runAsync).
+  */
+const Word TUNING_PARAM_MAX_ASYNC_THREADS = 4;
+
+/**
+  Contains the number of paths which are passed from the threads scanning
+  directories to a walk sequence (see fs::walk) at once.
+  */
+const Word TUNING_PARAM_WALK_BATCH_SIZE = 256;
+
+/**
+  Contains the number of compiled regular expressions which are kept in the
+  process wide cache of the RegexExtension. The least recently used pattern
+  is evicted once the cache is full.
+  */
+const Word TUNING_PARAM_REGEX_CACHE_SIZE = 64;
+
+/**
+  Contains the minimal length of a substring which shares the characters of
+  the string it was taken from (see Storage::makeSubString). Shorter
+  substrings are copied, as this is cheap and doesn't keep the (maybe much
+  larger) string alive.
+  */
+const Word TUNING_PARAM_MIN_SUBSTRING_SHARING_LENGTH = 32;
+
+/**
+  Contains the minimal length of a string created by + which is kept in an
+  extensible builder (see Storage::appendString). Shorter results are plain
+  strings, as copying them is cheaper than maintaining a builder.
+  */
+const Word TUNING_PARAM_MIN_STRING_BUILDER_LENGTH = 256;
+
+/**
+  Contains the number of entries reported by the op code sequence profiler.
   */
-const Word TUNING_PARAM_MAX_OP_CODES_IN_INTERPRET = 1000;
+const Word TUNING_PARAM_NUM_REPORTED_OP_SEQUENCES = 25;
+
+/**
+  Contains the default interval of the sampling profiler in milliseconds.
+  */
+const Word TUNING_PARAM_SAMPLING_INTERVAL = 1;
 
 /**
   Contains the size of a memory chunk that is allocated, if the storage runs
@@ -562,6 +826,25 @@ const Word TUNING_PARAM_MIN_FREE_SPACE = 1024;
   */
 const Word TUNING_PARAM_MAX_MINOR_GCS = 10;
 
+/**
+  Contains the number of invocations after which a function is compiled
+  to native code.
+  */
+const Word TUNING_PARAM_JIT_THRESHOLD = 1000;
+
+/**
+  Contains the minimal number of op codes a block must contain to be
+  compiled to native code.
+  */
+const Word TUNING_PARAM_JIT_MIN_BLOCK_LENGTH = 2;
+
+/**
+  Contains the initial size of the memory reserved for native code in bytes.
+  It is doubled whenever it is full and releasing unreachable blocks doesn't
+  free enough space.
+  */
+const Word TUNING_PARAM_JIT_CODE_SIZE = 4 * 1024 * 1024;
+
 /**
   Reads the tag of a given atom.
   */
@@ -662,6 +945,78 @@ inline bool isNumeric(Atom atom) {
     return isNumber(atom) || isDecimalNumber(atom);
 }
 
+/**
+  Checks whether the given value can be stored as small number.
+  */
+inline bool fitsSmallNumber(Number value) {
+    return (value & LOST_BITS) == 0 || (value & LOST_BITS) == LOST_BITS;
+}
+
+/**
+  Converts the given value into a small number. The value must fit (see
+  fitsSmallNumber).
+  */
+inline Atom tagSmallNumber(Number value) {
+    return static_cast<Word>(value) << TAG_LENGTH | TAG_TYPE_NUMBER;
+}
+
+/**
+  Reads the value of a small number directly from the tagged atom.
+  */
+inline Number untagSmallNumber(Atom atom) {
+    return static_cast<Number>(atom) >> TAG_LENGTH;
+}
+
+/**
+  Applies the given arithmetic op code (#ADD, #SUB, #MUL, #DIV, #REM) on
+  two integers. Returns false, if the result would overflow or if a
+  division by zero is requested.
+  */
+inline bool computeIntegers(Atom opcode, Number a, Number b, Number* result) {
+    const Number max = std::numeric_limits<Number>::max();
+    const Number min = std::numeric_limits<Number>::min();
+    switch(opcode) {
+    case SYMBOL_OP_ADD:
+        if ((b > 0 && a > max - b) || (b < 0 && a < min - b)) {
+            return false;
+        }
+        *result = a + b;
+        return true;
+    case SYMBOL_OP_SUB:
+        if ((b < 0 && a > max + b) || (b > 0 && a < min + b)) {
+            return false;
+        }
+        *result = a - b;
+        return true;
+    case SYMBOL_OP_MUL:
+        if (a > 0) {
+            if (b > 0 ? a > max / b : b < min / a) {
+                return false;
+            }
+        } else if (a < 0) {
+            if (b > 0 ? a < min / b : b < max / a) {
+                return false;
+            }
+        }
+        *result = a * b;
+        return true;
+    case SYMBOL_OP_DIV:
+        if (b == 0 || (a == min && b == -1)) {
+            return false;
+        }
+        *result = a / b;
+        return true;
+    case SYMBOL_OP_REM:
+        if (b == 0 || (a == min && b == -1)) {
+            return false;
+        }
+        *result = a % b;
+        return true;
+    default:
+        return false;
+    }
+}
+
 /**
   Provides access to the unsigned index stored in the atoms data section.
   */
@@ -676,6 +1031,107 @@ inline Atom tagIndex(Word index, Word type) {
     return (index << TAG_LENGTH) | type;
 }
 
+/**
+  Returns the number of operands which follow the given op code within
+  the code list.
+  */
+inline int countOperands(Atom opcode) {
+    switch(opcode) {
+    case SYMBOL_OP_LD:
+    case SYMBOL_OP_LDC:
+    case SYMBOL_OP_LDF:
+    case SYMBOL_OP_AP:
+    case SYMBOL_OP_AP0:
+    case SYMBOL_OP_AP1:
+    case SYMBOL_OP_AP2:
+    case SYMBOL_OP_AP3:
+    case SYMBOL_OP_AP4:
+    case SYMBOL_OP_BT:
+    case SYMBOL_OP_ST:
+    case SYMBOL_OP_LDG:
+    case SYMBOL_OP_STG:
+    case SYMBOL_OP_FILE:
+    case SYMBOL_OP_LINE:
+    case SYMBOL_OP_ENTRY:
+    case SYMBOL_OP_JIT:
+    case SYMBOL_OP_LDU:
+    case SYMBOL_OP_STU:
+    case SYMBOL_OP_LDGU:
+    case SYMBOL_OP_STGU:
+    case SYMBOL_OP_LINEU:
+        return 1;
+    case SYMBOL_OP_SPLIT:
+    case SYMBOL_OP_LDADDC:
+    case SYMBOL_OP_LDSUBC:
+    case SYMBOL_OP_APV:
+    case SYMBOL_OP_LDADDCU:
+    case SYMBOL_OP_LDSUBCU:
+        return 2;
+    case SYMBOL_OP_CALLG0:
+        return 3;
+    case SYMBOL_OP_CALLG:
+    case SYMBOL_OP_TESTC:
+    case SYMBOL_OP_TESTCU:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+/**
+  Returns the unchecked variant of the given op code, or the op code itself
+  if there is none.
+  */
+inline Atom uncheckedOpCode(Atom opcode) {
+    switch(opcode) {
+    case SYMBOL_OP_LD:
+        return SYMBOL_OP_LDU;
+    case SYMBOL_OP_ST:
+        return SYMBOL_OP_STU;
+    case SYMBOL_OP_LDG:
+        return SYMBOL_OP_LDGU;
+    case SYMBOL_OP_STG:
+        return SYMBOL_OP_STGU;
+    case SYMBOL_OP_LINE:
+        return SYMBOL_OP_LINEU;
+    case SYMBOL_OP_LDADDC:
+        return SYMBOL_OP_LDADDCU;
+    case SYMBOL_OP_LDSUBC:
+        return SYMBOL_OP_LDSUBCU;
+    case SYMBOL_OP_TESTC:
+        return SYMBOL_OP_TESTCU;
+    default:
+        return opcode;
+    }
+}
+
+/**
+  Returns the checked op code for the given unchecked variant, or the op
+  code itself if it isn't an unchecked variant.
+  */
+inline Atom checkedOpCode(Atom opcode) {
+    switch(opcode) {
+    case SYMBOL_OP_LDU:
+        return SYMBOL_OP_LD;
+    case SYMBOL_OP_STU:
+        return SYMBOL_OP_ST;
+    case SYMBOL_OP_LDGU:
+        return SYMBOL_OP_LDG;
+    case SYMBOL_OP_STGU:
+        return SYMBOL_OP_STG;
+    case SYMBOL_OP_LINEU:
+        return SYMBOL_OP_LINE;
+    case SYMBOL_OP_LDADDCU:
+        return SYMBOL_OP_LDADDC;
+    case SYMBOL_OP_LDSUBCU:
+        return SYMBOL_OP_LDSUBC;
+    case SYMBOL_OP_TESTCU:
+        return SYMBOL_OP_TESTC;
+    default:
+        return opcode;
+    }
+}
+
 /**
   Converts an number to a QString
   */
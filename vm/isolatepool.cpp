@@ -0,0 +1,186 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+#include "vm/isolatepool.h"
+
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QSettings>
+
+/**
+  Tracks the completion of the tasks passed to IsolatePool::execute.
+  */
+class IsolateBatch
+{
+public:
+    QMutex lock;
+    QWaitCondition done;
+    int remaining;
+};
+
+IsolatePool* IsolatePool::instance = NULL;
+QMutex IsolatePool::instanceLock;
+
+IsolatePool* IsolatePool::getInstance() {
+    QMutexLocker locker(&instanceLock);
+    if (instance == NULL) {
+        instance = new IsolatePool(qMax(1, QThread::idealThreadCount()));
+        qAddPostRoutine(IsolatePool::shutdown);
+    }
+    return instance;
+}
+
+void IsolatePool::shutdown() {
+    QMutexLocker locker(&instanceLock);
+    if (instance != NULL) {
+        instance->stop();
+        delete instance;
+        instance = NULL;
+    }
+}
+
+IsolatePool::IsolatePool(int numWorkers) :
+    queued(0),
+    stopping(false),
+    nextWorker(0)
+{
+    for(int i = 0; i < numWorkers; i++) {
+        workers.push_back(new IsolateWorker(this, i));
+    }
+    // Workers are only started once all exist, as they steal from each other.
+    for(std::vector<IsolateWorker*>::iterator i = workers.begin();
+        i != workers.end();
+        ++i)
+    {
+        (*i)->start();
+    }
+}
+
+bool IsolatePool::isWorkerThread() {
+    return dynamic_cast<IsolateWorker*>(QThread::currentThread()) != NULL;
+}
+
+void IsolatePool::execute(const std::vector<IsolateTask*>& tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+    IsolateBatch batch;
+    batch.remaining = tasks.size();
+    {
+        QMutexLocker locker(&idleLock);
+        for(std::vector<IsolateTask*>::const_iterator i = tasks.begin();
+            i != tasks.end();
+            ++i)
+        {
+            IsolateTask* task = *i;
+            task->batch = &batch;
+            IsolateWorker* worker = workers[nextWorker];
+            nextWorker = (nextWorker + 1) % workers.size();
+            QMutexLocker workerLocker(&worker->lock);
+            worker->tasks.push_back(task);
+        }
+        queued += tasks.size();
+        workAvailable.wakeAll();
+    }
+    QMutexLocker locker(&batch.lock);
+    while(batch.remaining > 0) {
+        batch.done.wait(&batch.lock);
+    }
+}
+
+bool IsolatePool::waitForWork() {
+    QMutexLocker locker(&idleLock);
+    while(queued == 0 && !stopping) {
+        workAvailable.wait(&idleLock);
+    }
+    return !stopping;
+}
+
+void IsolatePool::stop() {
+    {
+        QMutexLocker locker(&idleLock);
+        stopping = true;
+        workAvailable.wakeAll();
+    }
+    for(std::vector<IsolateWorker*>::iterator i = workers.begin();
+        i != workers.end();
+        ++i)
+    {
+        (*i)->wait();
+        delete *i;
+    }
+    workers.clear();
+}
+
+IsolateTask* IsolatePool::nextTask(IsolateWorker* worker) {
+    IsolateTask* task = worker->take();
+    for(int i = 1; task == NULL && i < size(); i++) {
+        task = workers[(worker->index + i) % size()]->steal();
+    }
+    if (task != NULL) {
+        QMutexLocker locker(&idleLock);
+        queued--;
+    }
+    return task;
+}
+
+void IsolatePool::complete(IsolateTask* task) {
+    IsolateBatch* batch = task->batch;
+    QMutexLocker locker(&batch->lock);
+    if (--batch->remaining == 0) {
+        batch->done.wakeAll();
+    }
+}
+
+IsolateTask* IsolateWorker::take() {
+    QMutexLocker locker(&lock);
+    if (tasks.empty()) {
+        return NULL;
+    }
+    IsolateTask* task = tasks.back();
+    tasks.pop_back();
+    return task;
+}
+
+IsolateTask* IsolateWorker::steal() {
+    QMutexLocker locker(&lock);
+    if (tasks.empty()) {
+        return NULL;
+    }
+    IsolateTask* task = tasks.front();
+    tasks.pop_front();
+    return task;
+}
+
+void IsolateWorker::run() {
+    QSettings settings("pimii", "pimii");
+    // The isolate is not headless, as panics are reported by the engine
+    // which submitted the task (see Engine::call()).
+    Engine isolate(&settings);
+    isolate.initialize();
+    while(pool->waitForWork()) {
+        IsolateTask* task = pool->nextTask(this);
+        if (task != NULL) {
+            task->run(&isolate);
+            pool->complete(task);
+        } else {
+            // Another worker took the task but has not yet updated queued...
+            yieldCurrentThread();
+        }
+    }
+}
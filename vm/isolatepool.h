@@ -0,0 +1,222 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+/**
+  ---------------------------------------------------------------------------
+  Contains the pool of worker threads which run tasks in isolates.
+  ---------------------------------------------------------------------------
+  */
+#ifndef ISOLATEPOOL_H
+#define ISOLATEPOOL_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <deque>
+#include <vector>
+
+#include "vm/engine.h"
+
+class IsolateBatch;
+class IsolateWorker;
+
+/**
+  A unit of work which is executed by the IsolatePool.
+  */
+class IsolateTask
+{
+public:
+    virtual ~IsolateTask() {}
+
+    /**
+      Executes the task within the given isolate (an engine with its own
+      storage), which is owned by the calling worker thread.
+      */
+    virtual void run(Engine* isolate) = 0;
+
+private:
+    /**
+      Contains the batch which the task belongs to.
+      */
+    IsolateBatch* batch;
+
+    friend class IsolatePool;
+    friend class IsolateWorker;
+};
+
+/**
+  Runs tasks using one thread per core. Each worker thread owns an isolate
+  which executes its tasks.
+
+  The pool uses work stealing: The tasks of a batch are distributed among
+  the queues of all workers. A worker takes its tasks from the back of its
+  own queue. Once it runs out of work, it steals tasks from the front of
+  the queues of the other workers. Therefore tasks which take longer than
+  others don't leave workers idle.
+
+  The pool is shared by all engines of the process and created on first
+  use. Its threads are stopped by shutdown(), which is registered as post
+  routine of the application.
+  */
+class IsolatePool
+{
+private:
+    /**
+      Contains the worker threads.
+      */
+    std::vector<IsolateWorker*> workers;
+
+    /**
+      Protects queued and is used to wake up idle workers.
+      */
+    QMutex idleLock;
+    QWaitCondition workAvailable;
+
+    /**
+      Contains the number of tasks which are queued and not yet taken by
+      a worker.
+      */
+    int queued;
+
+    /**
+      Determines if the workers should terminate. Protected by idleLock.
+      */
+    bool stopping;
+
+    /**
+      Contains the worker which receives the next task.
+      */
+    int nextWorker;
+
+    /**
+      Contains the shared pool.
+      */
+    static IsolatePool* instance;
+
+    /**
+      Protects the creation of the shared pool.
+      */
+    static QMutex instanceLock;
+
+    IsolatePool(int numWorkers);
+
+    /**
+      Waits until tasks are available. Called by an idle worker. Returns
+      false if the worker should terminate instead.
+      */
+    bool waitForWork();
+
+    /**
+      Wakes all workers, requests them to terminate and waits until they
+      did so.
+      */
+    void stop();
+
+    /**
+      Takes a task from the given worker or steals one from another worker.
+      Returns NULL if all queues are empty.
+      */
+    IsolateTask* nextTask(IsolateWorker* worker);
+
+    /**
+      Marks the given task as completed.
+      */
+    void complete(IsolateTask* task);
+
+    Q_DISABLE_COPY(IsolatePool)
+
+    friend class IsolateWorker;
+public:
+    /**
+      Returns the pool shared by all engines.
+      */
+    static IsolatePool* getInstance();
+
+    /**
+      Stops the worker threads of the shared pool (if it was created) and
+      destroys it. Tasks which are still queued are not executed.
+      */
+    static void shutdown();
+
+    /**
+      Returns the number of worker threads.
+      */
+    int size() {
+        return workers.size();
+    }
+
+    /**
+      Determines if the calling thread is a worker of the pool. This does
+      not create the pool.
+      */
+    static bool isWorkerThread();
+
+    /**
+      Executes the given tasks and waits until all of them are completed.
+      This must not be called by a worker thread, as it might wait for
+      tasks in its own queue.
+      */
+    void execute(const std::vector<IsolateTask*>& tasks);
+};
+
+/**
+  A worker thread of the IsolatePool.
+  */
+class IsolateWorker : public QThread
+{
+private:
+    IsolatePool* pool;
+
+    /**
+      Contains the position of the worker within the pool.
+      */
+    int index;
+
+    /**
+      Contains the tasks assigned to this worker.
+      */
+    std::deque<IsolateTask*> tasks;
+
+    /**
+      Protects tasks, as other workers steal from it.
+      */
+    QMutex lock;
+
+    /**
+      Takes the task at the back of the queue. Returns NULL if the queue
+      is empty.
+      */
+    IsolateTask* take();
+
+    /**
+      Takes the task at the front of the queue. Returns NULL if the queue
+      is empty.
+      */
+    IsolateTask* steal();
+
+    IsolateWorker(IsolatePool* pool, int index) : pool(pool), index(index) {}
+
+    Q_DISABLE_COPY(IsolateWorker)
+
+    friend class IsolatePool;
+protected:
+    virtual void run();
+};
+
+#endif // ISOLATEPOOL_H
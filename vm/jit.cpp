@@ -0,0 +1,912 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+
+#include "jit.h"
+#include "vm/engine.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef JIT_SUPPORTED
+#include <sys/mman.h>
+#include <unistd.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+/**
+  Register numbers as used by the x86-64 encoding.
+  */
+const int REG_RAX = 0;
+const int REG_RCX = 1;
+const int REG_RDX = 2;
+const int REG_RSI = 6;
+const int REG_R8 = 8;
+
+/**
+  Contains the registers which carry the operands to a helper (System V
+  calling convention, the engine is passed in RDI).
+  */
+static const int OPERAND_REGISTERS[] = { REG_RSI, REG_RDX, REG_RCX, REG_R8 };
+
+/**
+  Contains the maximal number of bytes generated per op code.
+  */
+const Word MAX_INSTRUCTION_SIZE = 96;
+
+JitCompiler::JitCompiler(Engine* engine, Storage* storage) :
+    engine(engine),
+    storage(storage),
+    enabled(true),
+    failed(false),
+    perfMapEnabled(false),
+    threshold(TUNING_PARAM_JIT_THRESHOLD),
+    codeBuffer(NULL),
+    bufferSize(0),
+    codeSize(0),
+    perfMap(NULL)
+{
+#ifndef JIT_SUPPORTED
+    enabled = false;
+#endif
+}
+
+JitCompiler::~JitCompiler() {
+    for(std::vector<NativeBlock>::iterator
+        i = blocks.begin();
+        i != blocks.end();
+        ++i)
+    {
+        delete i->entry;
+    }
+    delete perfMap;
+#ifdef JIT_SUPPORTED
+    if (codeBuffer != NULL) {
+        munmap(codeBuffer, bufferSize);
+    }
+#endif
+}
+
+void JitCompiler::setEnabled(bool enabled) {
+#ifdef JIT_SUPPORTED
+    this->enabled = enabled;
+#else
+    Q_UNUSED(enabled);
+#endif
+}
+
+void JitCompiler::setThreshold(Word threshold) {
+    this->threshold = threshold < 1 ? 1 : threshold;
+}
+
+unsigned char* JitCompiler::allocateBuffer(Word size) {
+#ifdef JIT_SUPPORTED
+    void* buffer = mmap(NULL,
+                        size,
+                        PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS,
+                        -1,
+                        0);
+    if (buffer == MAP_FAILED) {
+        return NULL;
+    }
+    return static_cast<unsigned char*>(buffer);
+#else
+    Q_UNUSED(size);
+    return NULL;
+#endif
+}
+
+void JitCompiler::releaseBlocks() {
+    for(Word index = 0; index < blocks.size(); index++) {
+        NativeBlock& block = blocks[index];
+        if (block.code != NULL && block.entry->atom() == NIL) {
+            delete block.entry;
+            block.entry = NULL;
+            block.code = NULL;
+            block.name.clear();
+            freeIndices.push_back(index);
+        }
+    }
+}
+
+bool JitCompiler::reclaim(Word required) {
+#ifdef JIT_SUPPORTED
+    releaseBlocks();
+    std::vector< std::pair<Word, int> > live;
+    Word used = 0;
+    for(Word index = 0; index < blocks.size(); index++) {
+        if (blocks[index].code != NULL) {
+            live.push_back(std::make_pair(blocks[index].offset,
+                                          static_cast<int>(index)));
+            used += blocks[index].size;
+        }
+    }
+    std::sort(live.begin(), live.end());
+    Word size = bufferSize;
+    while(used + required > size) {
+        size *= 2;
+    }
+    unsigned char* target = codeBuffer;
+    if (size != bufferSize) {
+        target = allocateBuffer(size);
+        if (target == NULL) {
+            return false;
+        }
+    } else if (!protect(0, codeSize, false)) {
+        return false;
+    }
+    // Blocks are sorted by their position, so moving them down never
+    // overwrites a block which still has to be moved...
+    Word position = 0;
+    for(std::vector< std::pair<Word, int> >::iterator
+        i = live.begin();
+        i != live.end();
+        ++i)
+    {
+        NativeBlock& block = blocks[i->second];
+        memmove(target + position, codeBuffer + block.offset, block.size);
+        block.offset = position;
+        block.code = reinterpret_cast<NativeCode>(target + position);
+        position += block.size;
+    }
+    if (target != codeBuffer) {
+        munmap(codeBuffer, bufferSize);
+        codeBuffer = target;
+        bufferSize = size;
+    }
+    codeSize = position;
+    if (codeSize > 0 && !protect(0, codeSize, true)) {
+        return false;
+    }
+    for(std::vector< std::pair<Word, int> >::iterator
+        i = live.begin();
+        i != live.end();
+        ++i)
+    {
+        writePerfMap(i->second);
+    }
+    return true;
+#else
+    Q_UNUSED(required);
+    return false;
+#endif
+}
+
+Word JitCompiler::getNumberOfBlocks() {
+    releaseBlocks();
+    return blocks.size() - freeIndices.size();
+}
+
+bool JitCompiler::protect(Word from, Word to, bool executable) {
+#ifdef JIT_SUPPORTED
+    Word pageSize = sysconf(_SC_PAGESIZE);
+    Word first = from - from % pageSize;
+    Word last = to == from ? first : to - 1 - (to - 1) % pageSize;
+    int protection = executable ? PROT_READ | PROT_EXEC
+                                : PROT_READ | PROT_WRITE;
+    return mprotect(codeBuffer + first,
+                    last - first + pageSize,
+                    protection) == 0;
+#else
+    Q_UNUSED(from);
+    Q_UNUSED(to);
+    Q_UNUSED(executable);
+    return false;
+#endif
+}
+
+void JitCompiler::compileFunction(Atom counterCell) {
+    if (!enabled || failed) {
+        return;
+    }
+    if (codeBuffer == NULL) {
+        codeBuffer = allocateBuffer(TUNING_PARAM_JIT_CODE_SIZE);
+        if (codeBuffer == NULL) {
+            failed = true;
+            return;
+        }
+        bufferSize = TUNING_PARAM_JIT_CODE_SIZE;
+    }
+    releaseBlocks();
+    // The function might only be referenced by the code register, which
+    // already points behind the counter. Keep it alive while compiling...
+    AtomRef function(storage, counterCell);
+    std::vector<Atom> pending;
+    std::set<Atom> visited;
+    Atom start = storage->getCons(counterCell).cdr;
+    bool entry = true;
+    while(true) {
+        if (isCons(start) && visited.find(start) == visited.end()) {
+            visited.insert(start);
+            std::vector<JitInstruction> block;
+            Atom continuation = scanBlock(start, block, pending);
+            if (block.size() >= TUNING_PARAM_JIT_MIN_BLOCK_LENGTH &&
+                    !compileBlock(counterCell,
+                                  start,
+                                  entry,
+                                  block,
+                                  continuation))
+            {
+                failed = true;
+                return;
+            }
+        }
+        entry = false;
+        if (pending.empty()) {
+            return;
+        }
+        start = pending.back();
+        pending.pop_back();
+    }
+}
+
+bool JitCompiler::compileBlock(Atom counterCell,
+                               Atom start,
+                               bool entry,
+                               std::vector<JitInstruction>& block,
+                               Atom continuation)
+{
+    if (entry) {
+        int index = generate(block,
+                             continuation,
+                             counterCell,
+                             describe(block));
+        if (index < 0) {
+            return false;
+        }
+        storage->setCAR(counterCell, storage->makeNumber(-1 - index));
+        return true;
+    }
+    // A block which doesn't start at the function entry is prefixed by
+    // #JIT index. Therefore its first op code is moved into a new cell,
+    // which then also is the cell to deoptimize to.
+    Cell first = storage->getCons(start);
+    Atom moved = storage->makeCons(first.car, first.cdr);
+    Atom header = storage->makeCons(NIL, moved);
+    block[0].cell = moved;
+    int index = generate(block, continuation, start, describe(block));
+    if (index < 0) {
+        return false;
+    }
+    storage->setCAR(header, storage->makeNumber(index));
+    storage->setCAR(start, SYMBOL_OP_JIT);
+    storage->setCDR(start, header);
+    return true;
+}
+
+QString JitCompiler::describe(std::vector<JitInstruction>& block) {
+    Atom file = engine->currentFile;
+    QString line("?");
+    for(std::vector<JitInstruction>::iterator
+        i = block.begin();
+        i != block.end();
+        ++i)
+    {
+        if (i->helper == opFile) {
+            file = i->operands[0];
+        } else if (i->helper == opLine) {
+            line = numberToString(i->operands[0]);
+            break;
+        }
+    }
+    return engine->toSimpleString(file) + ":" + line;
+}
+
+Atom JitCompiler::scanBlock(Atom cell,
+                            std::vector<JitInstruction>& block,
+                            std::vector<Atom>& pending)
+{
+    while(isCons(cell)) {
+        Cell current = storage->getCons(cell);
+        Atom opcode = current.car;
+        JitInstruction instruction;
+        instruction.cell = cell;
+        instruction.target = NIL;
+        instruction.guarded = false;
+        instruction.numberOfOperands = 0;
+        if (!decode(opcode, current.cdr, &instruction)) {
+            // Continue behind calls and other unsupported op codes with a
+            // new block...
+            if (opcode != SYMBOL_OP_RTN &&
+                    opcode != SYMBOL_OP_STOP &&
+                    opcode != SYMBOL_OP_JIT &&
+                    opcode != SYMBOL_OP_ENTRY)
+            {
+                pending.push_back(skipOperands(opcode, current.cdr));
+            }
+            return cell;
+        }
+        if (instruction.target != NIL) {
+            pending.push_back(instruction.target);
+        }
+        block.push_back(instruction);
+        cell = skipOperands(opcode, current.cdr);
+    }
+    return cell;
+}
+
+Atom JitCompiler::skipOperands(Atom opcode, Atom cell) {
+    for(int n = countOperands(opcode); n > 0 && isCons(cell); n--) {
+        cell = storage->getCons(cell).cdr;
+    }
+    return cell;
+}
+
+bool JitCompiler::decode(Atom opcode,
+                         Atom operands,
+                         JitInstruction* instruction)
+{
+    // Unchecked variants are compiled like their checked originals, as
+    // the operands are checked while decoding anyway.
+    opcode = checkedOpCode(opcode);
+    Atom values[4];
+    int count = countOperands(opcode);
+    for(int n = 0; n < count; n++) {
+        if (!isCons(operands)) {
+            return false;
+        }
+        Cell cell = storage->getCons(operands);
+        values[n] = cell.car;
+        operands = cell.cdr;
+    }
+    // Variable positions (i . j) are decoded into two numbers...
+    if (opcode == SYMBOL_OP_LD ||
+            opcode == SYMBOL_OP_ST ||
+            opcode == SYMBOL_OP_LDADDC ||
+            opcode == SYMBOL_OP_LDSUBC ||
+            opcode == SYMBOL_OP_TESTC)
+    {
+        if (!isCons(values[0])) {
+            return false;
+        }
+        Cell pos = storage->getCons(values[0]);
+        if (!isSmallNumber(pos.car) || !isSmallNumber(pos.cdr)) {
+            return false;
+        }
+        instruction->operands[0] = storage->getNumber(pos.car);
+        instruction->operands[1] = storage->getNumber(pos.cdr);
+        instruction->numberOfOperands = 2;
+    }
+    switch(opcode) {
+    case SYMBOL_OP_NIL:
+        instruction->helper = opNIL;
+        return true;
+    case SYMBOL_OP_LD:
+        instruction->helper = opLD;
+        return true;
+    case SYMBOL_OP_ST:
+        instruction->helper = opST;
+        return true;
+    case SYMBOL_OP_LDC:
+        instruction->helper = opLDC;
+        instruction->operands[0] = values[0];
+        instruction->numberOfOperands = 1;
+        return true;
+    case SYMBOL_OP_LDF:
+        instruction->helper = opLDF;
+        instruction->operands[0] = values[0];
+        instruction->numberOfOperands = 1;
+        return true;
+    case SYMBOL_OP_LDG:
+    case SYMBOL_OP_STG:
+        if (!isGlobal(values[0])) {
+            return false;
+        }
+        instruction->helper = opcode == SYMBOL_OP_LDG ? opLDG : opSTG;
+        instruction->operands[0] = values[0];
+        instruction->numberOfOperands = 1;
+        return true;
+    case SYMBOL_OP_BT:
+        instruction->helper = opBT;
+        instruction->guarded = true;
+        instruction->target = values[0];
+        return true;
+    case SYMBOL_OP_CAR:
+        instruction->helper = opCAR;
+        instruction->guarded = true;
+        return true;
+    case SYMBOL_OP_CDR:
+        instruction->helper = opCDR;
+        instruction->guarded = true;
+        return true;
+    case SYMBOL_OP_CONS:
+        instruction->helper = opCONS;
+        return true;
+    case SYMBOL_OP_RPLCAR:
+        instruction->helper = opRPLCAR;
+        instruction->guarded = true;
+        return true;
+    case SYMBOL_OP_RPLCDR:
+        instruction->helper = opRPLCDR;
+        instruction->guarded = true;
+        return true;
+    case SYMBOL_OP_EQ:
+    case SYMBOL_OP_NE:
+    case SYMBOL_OP_LT:
+    case SYMBOL_OP_GT:
+    case SYMBOL_OP_LTQ:
+    case SYMBOL_OP_GTQ:
+        instruction->helper = opRelation;
+        instruction->guarded = true;
+        instruction->operands[0] = opcode;
+        instruction->numberOfOperands = 1;
+        return true;
+    case SYMBOL_OP_ADD:
+    case SYMBOL_OP_SUB:
+    case SYMBOL_OP_MUL:
+    case SYMBOL_OP_DIV:
+    case SYMBOL_OP_REM:
+        instruction->helper = opArithmetic;
+        instruction->guarded = true;
+        instruction->operands[0] = opcode;
+        instruction->numberOfOperands = 1;
+        return true;
+    case SYMBOL_OP_NOT:
+        instruction->helper = opNOT;
+        return true;
+    case SYMBOL_OP_AND:
+        instruction->helper = opAND;
+        return true;
+    case SYMBOL_OP_OR:
+        instruction->helper = opOR;
+        return true;
+    case SYMBOL_OP_NOOP:
+        instruction->helper = opNOOP;
+        return true;
+    case SYMBOL_OP_LINE:
+        if (!isNumber(values[0])) {
+            return false;
+        }
+        instruction->helper = opLine;
+        instruction->operands[0] = storage->getNumber(values[0]);
+        instruction->numberOfOperands = 1;
+        return true;
+    case SYMBOL_OP_FILE:
+        if (!isSymbol(values[0])) {
+            return false;
+        }
+        instruction->helper = opFile;
+        instruction->operands[0] = values[0];
+        instruction->numberOfOperands = 1;
+        return true;
+    case SYMBOL_OP_LDADDC:
+    case SYMBOL_OP_LDSUBC:
+        instruction->helper = opLDArithmeticC;
+        instruction->guarded = true;
+        instruction->operands[2] = values[1];
+        instruction->operands[3] = opcode;
+        instruction->numberOfOperands = 4;
+        return true;
+    case SYMBOL_OP_TESTC:
+        instruction->helper = opTESTC;
+        instruction->guarded = true;
+        instruction->operands[2] = values[1];
+        instruction->operands[3] = values[2];
+        instruction->numberOfOperands = 4;
+        instruction->target = values[3];
+        return true;
+    default:
+        return false;
+    }
+}
+
+void JitCompiler::emitByte(unsigned char value) {
+    codeBuffer[codeSize++] = value;
+}
+
+void JitCompiler::emitWord(Word value) {
+    for(int i = 0; i < 8; i++) {
+        emitByte(static_cast<unsigned char>(value >> (i * 8)));
+    }
+}
+
+void JitCompiler::emitMove(int reg, Word value) {
+    // mov reg, imm64
+    emitByte(reg >= 8 ? 0x49 : 0x48);
+    emitByte(0xB8 + (reg & 7));
+    emitWord(value);
+}
+
+int JitCompiler::generate(std::vector<JitInstruction>& block,
+                          Atom continuation,
+                          Atom entry,
+                          const QString& name)
+{
+    Word required = (block.size() + 1) * MAX_INSTRUCTION_SIZE;
+    if (codeSize + required > bufferSize && !reclaim(required)) {
+        return -1;
+    }
+    Word start = codeSize;
+    Word limit = codeSize + required;
+    // The code buffer is never writable and executable at the same time.
+    // As blocks share pages, the pages of the previous block might have to
+    // become writable again...
+    if (!protect(start, limit, false)) {
+        return -1;
+    }
+    // push r12; mov r12, rdi
+    emitByte(0x41);
+    emitByte(0x54);
+    emitByte(0x49);
+    emitByte(0x89);
+    emitByte(0xFC);
+    // Jumps to the epilogue, which are patched once its position is known
+    std::vector<Word> exits;
+    for(std::vector<JitInstruction>::iterator
+        i = block.begin();
+        i != block.end();
+        ++i)
+    {
+        // mov rdi, r12
+        emitByte(0x4C);
+        emitByte(0x89);
+        emitByte(0xE7);
+        for(int n = 0; n < i->numberOfOperands; n++) {
+            emitMove(OPERAND_REGISTERS[n], i->operands[n]);
+        }
+        emitMove(REG_RAX, reinterpret_cast<Word>(i->helper));
+        // call rax
+        emitByte(0xFF);
+        emitByte(0xD0);
+        if (!i->guarded) {
+            continue;
+        }
+        // cmp eax, JIT_CONTINUE; je next
+        emitByte(0x83);
+        emitByte(0xF8);
+        emitByte(JIT_CONTINUE);
+        emitByte(0x74);
+        Word skip = codeSize;
+        emitByte(0);
+        if (i->target != NIL) {
+            // test eax, eax; jnz branch
+            emitByte(0x85);
+            emitByte(0xC0);
+            emitByte(0x75);
+            emitByte(15);
+        }
+        // mov rax, cell; jmp epilogue
+        emitMove(REG_RAX, i->cell);
+        emitByte(0xE9);
+        exits.push_back(codeSize);
+        codeSize += 4;
+        if (i->target != NIL) {
+            // branch: mov rax, target; jmp epilogue
+            emitMove(REG_RAX, i->target);
+            emitByte(0xE9);
+            exits.push_back(codeSize);
+            codeSize += 4;
+        }
+        codeBuffer[skip] = static_cast<unsigned char>(codeSize - skip - 1);
+    }
+    emitMove(REG_RAX, continuation);
+    Word epilogue = codeSize;
+    // pop r12; ret
+    emitByte(0x41);
+    emitByte(0x5C);
+    emitByte(0xC3);
+    for(std::vector<Word>::iterator i = exits.begin(); i != exits.end(); ++i)
+    {
+        int offset = static_cast<int>(epilogue - (*i + 4));
+        for(int n = 0; n < 4; n++) {
+            codeBuffer[*i + n] = static_cast<unsigned char>(offset >> (n * 8));
+        }
+    }
+    // Align the next block
+    while(codeSize % 16 != 0) {
+        emitByte(0x90);
+    }
+    if (!protect(start, codeSize, true)) {
+        return -1;
+    }
+    NativeBlock native;
+    native.code = reinterpret_cast<NativeCode>(codeBuffer + start);
+    native.offset = start;
+    native.size = codeSize - start;
+    native.name = name;
+    native.entry = storage->weakRef(entry);
+    int index;
+    if (freeIndices.empty()) {
+        index = blocks.size();
+        blocks.push_back(native);
+    } else {
+        index = freeIndices.back();
+        freeIndices.pop_back();
+        blocks[index] = native;
+    }
+    writePerfMap(index);
+    return index;
+}
+
+void JitCompiler::writePerfMap(int index) {
+#ifdef JIT_SUPPORTED
+    if (!perfMapEnabled) {
+        return;
+    }
+    if (perfMap == NULL) {
+        perfMap = new QFile(QString("/tmp/perf-%1.map").arg(getpid()));
+        if (!perfMap->open(QIODevice::WriteOnly | QIODevice::Append)) {
+            return;
+        }
+    }
+    if (!perfMap->isOpen()) {
+        return;
+    }
+    NativeBlock& block = blocks[index];
+    QString line = QString("%1 %2 pimii:%3#%4\n")
+            .arg(reinterpret_cast<Word>(block.code), 0, 16)
+            .arg(block.size, 0, 16)
+            .arg(block.name)
+            .arg(index);
+    perfMap->write(line.toUtf8());
+    perfMap->flush();
+#else
+    Q_UNUSED(index);
+#endif
+}
+
+void JitCompiler::push(Engine* engine, Atom value) {
+    engine->s->atom(engine->storage.makeCons(value, engine->s->atom()));
+}
+
+int JitCompiler::opNIL(Engine* engine, Word, Word, Word, Word) {
+    engine->instructionCounter++;
+    push(engine, NIL);
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opLD(Engine* engine, Word i, Word j, Word, Word) {
+    engine->instructionCounter++;
+    push(engine, engine->locate(i, j));
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opLDC(Engine* engine, Word value, Word, Word, Word) {
+    engine->instructionCounter++;
+    push(engine, value);
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opLDF(Engine* engine, Word code, Word, Word, Word) {
+    engine->instructionCounter++;
+    push(engine, engine->storage.makeCons(code, engine->e->atom()));
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opST(Engine* engine, Word i, Word j, Word, Word) {
+    engine->instructionCounter++;
+    AtomRef val(&engine->storage, engine->pop(engine->s));
+    engine->store(i, j, val.atom());
+    push(engine, val.atom());
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opLDG(Engine* engine, Word global, Word, Word, Word) {
+    engine->instructionCounter++;
+    push(engine, engine->storage.readGlobal(global));
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opSTG(Engine* engine, Word global, Word, Word, Word) {
+    engine->instructionCounter++;
+    Atom val = engine->pop(engine->s);
+    engine->storage.writeGlobal(global, val);
+    push(engine, val);
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opBT(Engine* engine, Word, Word, Word, Word) {
+    engine->instructionCounter++;
+    if (engine->pop(engine->s) == SYMBOL_TRUE) {
+        return JIT_BRANCH;
+    }
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opCAR(Engine* engine, Word, Word, Word, Word) {
+    Atom atom = engine->head(engine->s);
+    if (!isCons(atom)) {
+        return JIT_DEOPTIMIZE;
+    }
+    engine->instructionCounter++;
+    engine->pop(engine->s);
+    push(engine, engine->storage.getCons(atom).car);
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opCDR(Engine* engine, Word, Word, Word, Word) {
+    Atom atom = engine->head(engine->s);
+    if (!isCons(atom)) {
+        return JIT_DEOPTIMIZE;
+    }
+    engine->instructionCounter++;
+    engine->pop(engine->s);
+    push(engine, engine->storage.getCons(atom).cdr);
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opCONS(Engine* engine, Word, Word, Word, Word) {
+    engine->instructionCounter++;
+    Atom b = engine->pop(engine->s);
+    Atom a = engine->pop(engine->s);
+    push(engine, engine->storage.makeCons(a, b));
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opRPLCAR(Engine* engine, Word, Word, Word, Word) {
+    if (!isCons(engine->nth(engine->s->atom(), 1))) {
+        return JIT_DEOPTIMIZE;
+    }
+    engine->instructionCounter++;
+    Atom car = engine->pop(engine->s);
+    Atom atom = engine->pop(engine->s);
+    engine->storage.setCAR(atom, car);
+    push(engine, atom);
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opRPLCDR(Engine* engine, Word, Word, Word, Word) {
+    if (!isCons(engine->nth(engine->s->atom(), 1))) {
+        return JIT_DEOPTIMIZE;
+    }
+    engine->instructionCounter++;
+    Atom cdr = engine->pop(engine->s);
+    Atom atom = engine->pop(engine->s);
+    engine->storage.setCDR(atom, cdr);
+    push(engine, atom);
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opRelation(Engine* engine, Word opcode, Word, Word, Word) {
+    Atom stack = engine->s->atom();
+    if (!isCons(stack)) {
+        return JIT_DEOPTIMIZE;
+    }
+    Cell top = engine->storage.getCons(stack);
+    if (!isSmallNumber(top.car) || !isCons(top.cdr)) {
+        return JIT_DEOPTIMIZE;
+    }
+    Cell second = engine->storage.getCons(top.cdr);
+    if (!isSmallNumber(second.car)) {
+        return JIT_DEOPTIMIZE;
+    }
+    engine->instructionCounter++;
+    engine->s->atom(second.cdr);
+    push(engine,
+         engine->evaluateSmallRelation(opcode, second.car, top.car));
+    return JIT_CONTINUE;
+}
+
+bool JitCompiler::computeSmall(Engine* engine,
+                               Atom opcode,
+                               Atom atoma,
+                               Atom atomb,
+                               Atom* result)
+{
+    if (!isSmallNumber(atoma) || !isSmallNumber(atomb)) {
+        return false;
+    }
+    Number value;
+    if (!computeIntegers(opcode,
+                         untagSmallNumber(atoma),
+                         untagSmallNumber(atomb),
+                         &value)) {
+        return false;
+    }
+    *result = fitsSmallNumber(value) ?
+                tagSmallNumber(value) : engine->storage.makeNumber(value);
+    return true;
+}
+
+int JitCompiler::opArithmetic(Engine* engine, Word opcode, Word, Word, Word)
+{
+    Atom stack = engine->s->atom();
+    if (!isCons(stack)) {
+        return JIT_DEOPTIMIZE;
+    }
+    Cell top = engine->storage.getCons(stack);
+    if (!isCons(top.cdr)) {
+        return JIT_DEOPTIMIZE;
+    }
+    Cell second = engine->storage.getCons(top.cdr);
+    Atom result;
+    if (!computeSmall(engine, opcode, second.car, top.car, &result)) {
+        return JIT_DEOPTIMIZE;
+    }
+    engine->instructionCounter++;
+    engine->s->atom(second.cdr);
+    push(engine, result);
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opNOT(Engine* engine, Word, Word, Word, Word) {
+    engine->instructionCounter++;
+    engine->opNOT();
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opAND(Engine* engine, Word, Word, Word, Word) {
+    engine->instructionCounter++;
+    engine->opAND();
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opOR(Engine* engine, Word, Word, Word, Word) {
+    engine->instructionCounter++;
+    engine->opOR();
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opNOOP(Engine* engine, Word, Word, Word, Word) {
+    engine->instructionCounter++;
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opLine(Engine* engine, Word line, Word, Word, Word) {
+    engine->instructionCounter++;
+    engine->currentLine = line;
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opFile(Engine* engine, Word file, Word, Word, Word) {
+    engine->instructionCounter++;
+    engine->currentFile = file;
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opLDArithmeticC(Engine* engine,
+                                 Word i,
+                                 Word j,
+                                 Word constant,
+                                 Word opcode)
+{
+    Atom result;
+    if (!computeSmall(engine,
+                      opcode == SYMBOL_OP_LDADDC ?
+                          SYMBOL_OP_ADD : SYMBOL_OP_SUB,
+                      engine->locate(i, j),
+                      constant,
+                      &result))
+    {
+        return JIT_DEOPTIMIZE;
+    }
+    engine->instructionCounter++;
+    push(engine, result);
+    return JIT_CONTINUE;
+}
+
+int JitCompiler::opTESTC(Engine* engine,
+                         Word i,
+                         Word j,
+                         Word constant,
+                         Word relation)
+{
+    Atom value = engine->locate(i, j);
+    if (!isSmallNumber(value) || !isSmallNumber(constant)) {
+        return JIT_DEOPTIMIZE;
+    }
+    engine->instructionCounter++;
+    if (engine->evaluateSmallRelation(relation, value, constant) ==
+            SYMBOL_TRUE) {
+        return JIT_BRANCH;
+    }
+    return JIT_CONTINUE;
+}
@@ -0,0 +1,434 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+/**
+  ---------------------------------------------------------------------------
+  Contains the baseline JIT compiler which translates hot functions into
+  x86-64 machine code.
+  ---------------------------------------------------------------------------
+  */
+
+#ifndef JIT_H
+#define JIT_H
+
+#include "vm/env.h"
+#include "vm/storage.h"
+
+#include <set>
+#include <vector>
+
+#include <QFile>
+
+#if defined(__x86_64__) && !defined(_WIN32) && !defined(NO_JIT)
+#define JIT_SUPPORTED
+#endif
+
+/**
+  Forward reference - see: engine.h
+  */
+class Engine;
+
+/**
+  Represents a compiled block. It is invoked with the engine and returns
+  the code cell at which the interpreter continues.
+  */
+typedef Atom (*NativeCode)(Engine* engine);
+
+/**
+  Represents a helper which executes one op code on behalf of a native
+  block. The operands are decoded when the block is compiled and passed in
+  as immediate values. Returns JIT_DEOPTIMIZE if the op code has to be
+  executed by the interpreter, JIT_CONTINUE if the next op code of the
+  block can be executed or JIT_BRANCH if a branch was taken.
+  */
+typedef int (*JitHelper)(Engine* engine, Word a, Word b, Word c, Word d);
+
+const int JIT_DEOPTIMIZE = 0;
+const int JIT_CONTINUE = 1;
+const int JIT_BRANCH = 2;
+
+/**
+  Describes a single op code within a block which is to be compiled.
+  */
+struct JitInstruction {
+    /**
+      Contains the helper which executes the op code.
+      */
+    JitHelper helper;
+
+    /**
+      Contains the decoded operands.
+      */
+    Word operands[4];
+
+    /**
+      Contains the number of operands which are passed to the helper.
+      */
+    int numberOfOperands;
+
+    /**
+      Determines if the helper can return JIT_DEOPTIMIZE.
+      */
+    bool guarded;
+
+    /**
+      Contains the code cell of the op code, which is used to continue in
+      the interpreter if the helper deoptimizes.
+      */
+    Atom cell;
+
+    /**
+      Contains the branch target, if the helper can return JIT_BRANCH or
+      NIL otherwise.
+      */
+    Atom target;
+};
+
+/**
+  Describes a generated native block.
+  */
+struct NativeBlock {
+    /**
+      Contains the entry point of the block or NULL if its index is unused.
+      */
+    NativeCode code;
+
+    /**
+      Contains the position of the block within the code buffer.
+      */
+    Word offset;
+
+    /**
+      Contains the number of bytes occupied in the code buffer.
+      */
+    Word size;
+
+    /**
+      Contains the name used in the perf map.
+      */
+    QString name;
+
+    /**
+      Refers to the cell through which the interpreter enters the block:
+      The #ENTRY counter or the cell patched to #JIT. Once this cell is
+      collected, the block can no longer be reached and is released.
+      */
+    WeakAtomRef* entry;
+};
+
+/**
+  Implements the second tier of the engine: A template JIT which translates
+  hot functions into x86-64 machine code.
+
+  Each function body starts with an #ENTRY op code which counts its
+  invocations. Pimii has no loops - a loop is a recursive (tail) call, which
+  also passes through #ENTRY. Therefore this counter serves as invocation
+  and backedge counter at once. Once it reaches the threshold, the function
+  body is split into blocks. A block is a sequence of op codes which don't
+  transfer control to another function: It starts at the function entry,
+  at a branch target or right behind a call and it ends at the next call,
+  #RTN or any other op code which isn't supported by the compiler.
+
+  Each op code of a block is translated into a call of a helper with its
+  operands as immediate values. This removes the fetching of op codes and
+  operands from the code list, the dispatch via switch and the decoding of
+  variable positions. Helpers of arithmetic and relational op codes only
+  handle small numbers. Everything else (and an empty stack) makes them
+  deoptimize: The native code then returns the code cell of the op code
+  to the interpreter, which executes the remainder of the block.
+
+  The interpreter remains the reference implementation: A helper always
+  leaves the engine in the exact state the interpreter would produce.
+
+  The compiler doesn't keep the code of compiled functions alive: Native
+  code can only be entered through its #ENTRY or #JIT cell and while it
+  runs, the remainder of the block is reachable via the code register. A
+  block whose entry cell was collected (e.g. as the global holding the
+  function was overwritten) is released. Once the code buffer is full,
+  released blocks are squeezed out and if this doesn't suffice, the buffer
+  is doubled. As blocks only contain relative jumps within themselves and
+  absolute addresses of helpers, they can be moved freely.
+
+  If #JIT_PERF_MAP is set to #TRUE, native blocks are announced in
+  /tmp/perf-PID.map so that perf can symbolize them.
+  */
+class JitCompiler
+{
+private:
+    /**
+      Contains the engine for which code is generated.
+      */
+    Engine* engine;
+
+    /**
+      Contains the storage of the engine.
+      */
+    Storage* storage;
+
+    /**
+      Determines if functions are compiled once they become hot and if
+      their native code is executed.
+      */
+    bool enabled;
+
+    /**
+      Determines if the compiler gave up, as no executable memory is
+      available. The existing blocks remain in use.
+      */
+    bool failed;
+
+    /**
+      Determines if generated blocks are announced in the perf map.
+      */
+    bool perfMapEnabled;
+
+    /**
+      Contains the number of invocations after which a function is
+      compiled.
+      */
+    Word threshold;
+
+    /**
+      Contains the executable memory area.
+      */
+    unsigned char* codeBuffer;
+
+    /**
+      Contains the size of the codeBuffer in bytes.
+      */
+    Word bufferSize;
+
+    /**
+      Contains the number of bytes used in the codeBuffer.
+      */
+    Word codeSize;
+
+    /**
+      Contains all generated blocks. The index within this vector is the
+      operand of #JIT or #ENTRY.
+      */
+    std::vector<NativeBlock> blocks;
+
+    /**
+      Contains the indices of released blocks, which are reused first.
+      */
+    std::vector<int> freeIndices;
+
+    /**
+      Contains the perf map or NULL if it isn't open (yet).
+      */
+    QFile* perfMap;
+
+    /**
+      Allocates a code buffer of the given size. Returns NULL if no
+      executable memory is available.
+      */
+    unsigned char* allocateBuffer(Word size);
+
+    /**
+      Releases all blocks whose entry cell was collected.
+      */
+    void releaseBlocks();
+
+    /**
+      Makes room for the given number of bytes behind the used part of the
+      codeBuffer. Released blocks are removed by moving all other blocks
+      down. If this doesn't free enough space, the blocks are moved into a
+      buffer of twice the size. Returns false if no executable memory is
+      available.
+      */
+    bool reclaim(Word required);
+
+    /**
+      Makes the pages of the codeBuffer which contain the bytes from
+      (inclusive) to (exclusive) either writable or executable. Returns
+      false if the protection cannot be changed.
+      */
+    bool protect(Word from, Word to, bool executable);
+
+    /**
+      Collects the op codes of the block starting at the given cell. Branch
+      targets and continuations behind calls are added to pending. Returns
+      the cell behind the block.
+      */
+    Atom scanBlock(Atom cell,
+                   std::vector<JitInstruction>& block,
+                   std::vector<Atom>& pending);
+
+    /**
+      Returns the cell behind the operands of the given op code.
+      */
+    Atom skipOperands(Atom opcode, Atom cell);
+
+    /**
+      Generates the native code for the given block and installs it, either
+      as #ENTRY of the function or by prefixing the block with #JIT. Returns
+      false if no executable memory is available.
+      */
+    bool compileBlock(Atom counterCell,
+                      Atom start,
+                      bool entry,
+                      std::vector<JitInstruction>& block,
+                      Atom continuation);
+
+    /**
+      Returns the source position of the given block, used to name it in
+      the perf map.
+      */
+    QString describe(std::vector<JitInstruction>& block);
+
+    /**
+      Decodes the given op code into the given instruction. Returns false if
+      it cannot be compiled.
+      */
+    bool decode(Atom opcode, Atom operands, JitInstruction* instruction);
+
+    /**
+      Generates the machine code for the given block and returns the index
+      of the new native block or -1 if no executable memory is available.
+      The given entry cell is the cell through which the block is entered.
+      */
+    int generate(std::vector<JitInstruction>& block,
+                 Atom continuation,
+                 Atom entry,
+                 const QString& name);
+
+    /**
+      Announces the block with the given index in /tmp/perf-PID.map
+      */
+    void writePerfMap(int index);
+
+    void emitByte(unsigned char value);
+    void emitWord(Word value);
+    void emitMove(int reg, Word value);
+
+    /**
+      Pushes the given value onto the stack of the given engine.
+      */
+    static void push(Engine* engine, Atom value);
+
+    // Helpers executing the individual op codes...
+    static int opNIL(Engine* engine, Word, Word, Word, Word);
+    static int opLD(Engine* engine, Word i, Word j, Word, Word);
+    static int opLDC(Engine* engine, Word value, Word, Word, Word);
+    static int opLDF(Engine* engine, Word code, Word, Word, Word);
+    static int opST(Engine* engine, Word i, Word j, Word, Word);
+    static int opLDG(Engine* engine, Word global, Word, Word, Word);
+    static int opSTG(Engine* engine, Word global, Word, Word, Word);
+    static int opBT(Engine* engine, Word, Word, Word, Word);
+    static int opCAR(Engine* engine, Word, Word, Word, Word);
+    static int opCDR(Engine* engine, Word, Word, Word, Word);
+    static int opCONS(Engine* engine, Word, Word, Word, Word);
+    static int opRPLCAR(Engine* engine, Word, Word, Word, Word);
+    static int opRPLCDR(Engine* engine, Word, Word, Word, Word);
+    static int opRelation(Engine* engine, Word opcode, Word, Word, Word);
+    static int opArithmetic(Engine* engine, Word opcode, Word, Word, Word);
+    static int opNOT(Engine* engine, Word, Word, Word, Word);
+    static int opAND(Engine* engine, Word, Word, Word, Word);
+    static int opOR(Engine* engine, Word, Word, Word, Word);
+    static int opNOOP(Engine* engine, Word, Word, Word, Word);
+    static int opLine(Engine* engine, Word line, Word, Word, Word);
+    static int opFile(Engine* engine, Word file, Word, Word, Word);
+    static int opLDArithmeticC(Engine* engine,
+                               Word i,
+                               Word j,
+                               Word constant,
+                               Word opcode);
+    static int opTESTC(Engine* engine,
+                       Word i,
+                       Word j,
+                       Word constant,
+                       Word relation);
+
+    /**
+      Computes the given arithmetic op code for two small numbers. Returns
+      false if the result cannot be computed without the interpreter (a
+      division by zero or an overflow).
+      */
+    static bool computeSmall(Engine* engine,
+                             Atom opcode,
+                             Atom a,
+                             Atom b,
+                             Atom* result);
+
+    Q_DISABLE_COPY(JitCompiler)
+public:
+    JitCompiler(Engine* engine, Storage* storage);
+    ~JitCompiler();
+
+    /**
+      Compiles the function whose #ENTRY counter is stored in the given
+      cell. The function body starts behind this cell.
+      */
+    void compileFunction(Atom counterCell);
+
+    /**
+      Executes the native block with the given index and returns the code
+      cell at which the interpreter continues.
+      */
+    inline Atom execute(Word index) {
+        return blocks[index].code(engine);
+    }
+
+    /**
+      Determines if functions are compiled once they become hot and if
+      compiled blocks are executed.
+      */
+    bool isEnabled() {
+        return enabled;
+    }
+
+    /**
+      Enables or disables the compiler. While it is disabled, the blocks
+      which are already compiled are interpreted.
+      */
+    void setEnabled(bool enabled);
+
+    /**
+      Returns the number of invocations after which a function is compiled.
+      */
+    Word getThreshold() {
+        return threshold;
+    }
+
+    /**
+      Sets the number of invocations after which a function is compiled.
+      */
+    void setThreshold(Word threshold);
+
+    /**
+      Determines if generated blocks are announced in /tmp/perf-PID.map
+      */
+    void setPerfMapEnabled(bool enabled) {
+        perfMapEnabled = enabled;
+    }
+
+    /**
+      Determines if generated blocks are announced in /tmp/perf-PID.map
+      */
+    bool isPerfMapEnabled() {
+        return perfMapEnabled;
+    }
+
+    /**
+      Returns the number of native blocks which are in use.
+      */
+    Word getNumberOfBlocks();
+};
+
+#endif // JIT_H
@@ -0,0 +1,576 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+#include "vm/jsonparser.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+
+/**
+  Limits the nesting of arrays and objects, as both parser and writer are
+  recursive.
+  */
+const int MAX_JSON_DEPTH = 512;
+
+/**
+  Names the symbol which represents null, as the empty list NIL is used for
+  empty arrays and objects.
+  */
+const char* const JSON_NULL = "NULL";
+
+JsonParser::JsonParser(Storage* storage, const char* data, qint64 size) :
+    storage(storage),
+    data(data),
+    size(size),
+    position(0),
+    depth(0),
+    inArray(false),
+    started(false)
+{
+    // Skip a UTF-8 byte order mark...
+    if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        position = 3;
+    }
+}
+
+bool JsonParser::fail(const QString& message) {
+    if (error.isEmpty()) {
+        error = QString("%1 at offset %2").arg(message,
+                                               QString::number(position));
+    }
+    return false;
+}
+
+void JsonParser::skipWhitespace() {
+    while (position < size) {
+        char ch = data[position];
+        if (ch != ' ' && ch != '\n' && ch != '\r' && ch != '\t') {
+            return;
+        }
+        position++;
+    }
+}
+
+bool JsonParser::expect(const char* literal) {
+    qint64 length = strlen(literal);
+    if (size - position < length ||
+            memcmp(data + position, literal, length) != 0) {
+        return fail("Invalid literal");
+    }
+    position += length;
+    return true;
+}
+
+bool JsonParser::parse(AtomRef* result) {
+    skipWhitespace();
+    if (!parseValue(result)) {
+        return false;
+    }
+    skipWhitespace();
+    if (position < size) {
+        return fail("Unexpected content after the value");
+    }
+    return true;
+}
+
+bool JsonParser::nextElement(AtomRef* result) {
+    if (!error.isEmpty()) {
+        return false;
+    }
+    skipWhitespace();
+    if (!started) {
+        started = true;
+        if (position < size && data[position] == '[') {
+            inArray = true;
+            position++;
+            skipWhitespace();
+            if (position < size && data[position] == ']') {
+                position++;
+                inArray = false;
+                return false;
+            }
+            return parseValue(result);
+        }
+    }
+    if (!inArray) {
+        if (position >= size) {
+            return false;
+        }
+        return parseValue(result);
+    }
+    if (position >= size) {
+        return fail("Unterminated array");
+    }
+    if (data[position] == ']') {
+        position++;
+        inArray = false;
+        return false;
+    }
+    if (data[position] != ',') {
+        return fail("Expected , or ]");
+    }
+    position++;
+    skipWhitespace();
+    return parseValue(result);
+}
+
+bool JsonParser::parseValue(AtomRef* result) {
+    if (position >= size) {
+        return fail("Unexpected end of input");
+    }
+    switch (data[position]) {
+    case '{':
+        return parseObject(result);
+    case '[':
+        return parseArray(result);
+    case '"': {
+        QString string;
+        if (!parseString(&string)) {
+            return false;
+        }
+        result->atom(storage->makeString(string));
+        return true;
+    }
+    case 't':
+        result->atom(SYMBOL_TRUE);
+        return expect("true");
+    case 'f':
+        result->atom(SYMBOL_FALSE);
+        return expect("false");
+    case 'n':
+        result->atom(storage->makeSymbol(JSON_NULL));
+        return expect("null");
+    default:
+        return parseNumber(result);
+    }
+}
+
+bool JsonParser::parseArray(AtomRef* result) {
+    if (++depth > MAX_JSON_DEPTH) {
+        return fail("Nesting too deep");
+    }
+    position++;
+    AtomRef list(storage, NIL);
+    AtomRef tail(storage, NIL);
+    AtomRef element(storage, NIL);
+    skipWhitespace();
+    if (position < size && data[position] == ']') {
+        position++;
+        depth--;
+        result->atom(NIL);
+        return true;
+    }
+    while (true) {
+        skipWhitespace();
+        if (!parseValue(&element)) {
+            return false;
+        }
+        if (isNil(list.atom())) {
+            tail.atom(storage->makeCons(element.atom(), NIL));
+            list.atom(tail.atom());
+        } else {
+            tail.atom(storage->append(tail.atom(), element.atom()));
+        }
+        skipWhitespace();
+        if (position >= size) {
+            return fail("Unterminated array");
+        }
+        char ch = data[position++];
+        if (ch == ']') {
+            break;
+        }
+        if (ch != ',') {
+            position--;
+            return fail("Expected , or ]");
+        }
+    }
+    depth--;
+    result->atom(list.atom());
+    return true;
+}
+
+bool JsonParser::parseObject(AtomRef* result) {
+    if (++depth > MAX_JSON_DEPTH) {
+        return fail("Nesting too deep");
+    }
+    position++;
+    AtomRef list(storage, NIL);
+    AtomRef tail(storage, NIL);
+    AtomRef value(storage, NIL);
+    skipWhitespace();
+    if (position < size && data[position] == '}') {
+        position++;
+        depth--;
+        result->atom(NIL);
+        return true;
+    }
+    while (true) {
+        skipWhitespace();
+        if (position >= size || data[position] != '"') {
+            return fail("Expected a key");
+        }
+        QString key;
+        if (!parseString(&key)) {
+            return false;
+        }
+        skipWhitespace();
+        if (position >= size || data[position] != ':') {
+            return fail("Expected :");
+        }
+        position++;
+        skipWhitespace();
+        if (!parseValue(&value)) {
+            return false;
+        }
+        value.atom(storage->makeCons(value.atom(), NIL));
+        value.atom(storage->makeCons(storage->makeSymbol(key), value.atom()));
+        if (isNil(list.atom())) {
+            tail.atom(storage->makeCons(value.atom(), NIL));
+            list.atom(tail.atom());
+        } else {
+            tail.atom(storage->append(tail.atom(), value.atom()));
+        }
+        skipWhitespace();
+        if (position >= size) {
+            return fail("Unterminated object");
+        }
+        char ch = data[position++];
+        if (ch == '}') {
+            break;
+        }
+        if (ch != ',') {
+            position--;
+            return fail("Expected , or }");
+        }
+    }
+    depth--;
+    result->atom(list.atom());
+    return true;
+}
+
+bool JsonParser::parseHex(uint* result) {
+    if (size - position < 4) {
+        return fail("Invalid unicode escape");
+    }
+    *result = 0;
+    for (int i = 0; i < 4; i++) {
+        char ch = data[position++];
+        *result <<= 4;
+        if (ch >= '0' && ch <= '9') {
+            *result |= ch - '0';
+        } else if (ch >= 'a' && ch <= 'f') {
+            *result |= ch - 'a' + 10;
+        } else if (ch >= 'A' && ch <= 'F') {
+            *result |= ch - 'A' + 10;
+        } else {
+            return fail("Invalid unicode escape");
+        }
+    }
+    return true;
+}
+
+bool JsonParser::parseString(QString* result) {
+    position++;
+    // Most strings contain no escapes. Therefore we search the closing
+    // quote using memchr and decode the whole string at once...
+    const char* start = data + position;
+    const char* quote = static_cast<const char*>(
+                memchr(start, '"', size - position));
+    if (quote == NULL) {
+        return fail("Unterminated string");
+    }
+    if (memchr(start, '\\', quote - start) == NULL) {
+        *result = QString::fromUtf8(start, quote - start);
+        position = quote - data + 1;
+        return true;
+    }
+    QByteArray buffer;
+    while (true) {
+        if (position >= size) {
+            return fail("Unterminated string");
+        }
+        char ch = data[position++];
+        if (ch == '"') {
+            break;
+        }
+        if (ch != '\\') {
+            buffer.append(ch);
+            continue;
+        }
+        if (position >= size) {
+            return fail("Unterminated string");
+        }
+        ch = data[position++];
+        switch (ch) {
+        case '"':
+        case '\\':
+        case '/':
+            buffer.append(ch);
+            break;
+        case 'b':
+            buffer.append('\b');
+            break;
+        case 'f':
+            buffer.append('\f');
+            break;
+        case 'n':
+            buffer.append('\n');
+            break;
+        case 'r':
+            buffer.append('\r');
+            break;
+        case 't':
+            buffer.append('\t');
+            break;
+        case 'u': {
+            uint code;
+            if (!parseHex(&code)) {
+                return false;
+            }
+            if (code >= 0xD800 && code <= 0xDBFF &&
+                    size - position >= 6 &&
+                    data[position] == '\\' &&
+                    data[position + 1] == 'u') {
+                position += 2;
+                uint low;
+                if (!parseHex(&low)) {
+                    return false;
+                }
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            }
+            // Re-encode as UTF-8, so that the buffer is decoded at once...
+            if (code < 0x80) {
+                buffer.append(static_cast<char>(code));
+            } else if (code < 0x800) {
+                buffer.append(static_cast<char>(0xC0 | (code >> 6)));
+                buffer.append(static_cast<char>(0x80 | (code & 0x3F)));
+            } else if (code < 0x10000) {
+                buffer.append(static_cast<char>(0xE0 | (code >> 12)));
+                buffer.append(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                buffer.append(static_cast<char>(0x80 | (code & 0x3F)));
+            } else {
+                buffer.append(static_cast<char>(0xF0 | (code >> 18)));
+                buffer.append(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+                buffer.append(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                buffer.append(static_cast<char>(0x80 | (code & 0x3F)));
+            }
+            break;
+        }
+        default:
+            position--;
+            return fail("Invalid escape sequence");
+        }
+    }
+    *result = QString::fromUtf8(buffer.constData(), buffer.size());
+    return true;
+}
+
+bool JsonParser::parseNumber(AtomRef* result) {
+    qint64 start = position;
+    bool decimal = false;
+    if (position < size && data[position] == '-') {
+        position++;
+    }
+    qint64 digits = position;
+    while (position < size) {
+        char ch = data[position];
+        if (ch >= '0' && ch <= '9') {
+            position++;
+        } else if (ch == '.' || ch == 'e' || ch == 'E' ||
+                   ch == '+' || ch == '-') {
+            decimal = true;
+            position++;
+        } else {
+            break;
+        }
+    }
+    if (position == digits) {
+        return fail("Unexpected character");
+    }
+    // strtol and strtod need a terminated string...
+    QByteArray number(data + start, position - start);
+    char* end;
+    errno = 0;
+    if (!decimal) {
+        long value = strtol(number.constData(), &end, 10);
+        if (errno == 0 && *end == '\0') {
+            result->atom(storage->makeNumber(value));
+            return true;
+        }
+    }
+    double value = strtod(number.constData(), &end);
+    if (*end != '\0') {
+        position = start;
+        return fail("Invalid number");
+    }
+    result->atom(storage->makeDecimal(value));
+    return true;
+}
+
+JsonWriter::JsonWriter(Storage* storage) :
+    storage(storage),
+    nullSymbol(storage->makeSymbol(JSON_NULL)),
+    depth(0)
+{
+}
+
+bool JsonWriter::write(Atom value) {
+    return writeValue(value);
+}
+
+bool JsonWriter::isObject(Atom list) {
+    while (isCons(list)) {
+        Cell cell = storage->getCons(list);
+        if (!isCons(cell.car)) {
+            return false;
+        }
+        Cell pair = storage->getCons(cell.car);
+        if (!isSymbol(pair.car) || pair.car == SYMBOL_TRUE ||
+                pair.car == SYMBOL_FALSE) {
+            return false;
+        }
+        if (!isCons(pair.cdr) || !isNil(storage->getCons(pair.cdr).cdr)) {
+            return false;
+        }
+        list = cell.cdr;
+    }
+    return true;
+}
+
+void JsonWriter::writeString(const QString& string) {
+    output.append(QChar('"'));
+    for (int i = 0; i < string.length(); i++) {
+        QChar ch = string.at(i);
+        switch (ch.unicode()) {
+        case '"':
+            output.append(QString("\\\""));
+            break;
+        case '\\':
+            output.append(QString("\\\\"));
+            break;
+        case '\n':
+            output.append(QString("\\n"));
+            break;
+        case '\r':
+            output.append(QString("\\r"));
+            break;
+        case '\t':
+            output.append(QString("\\t"));
+            break;
+        default:
+            if (ch.unicode() < 0x20) {
+                // Control characters are escaped as \u00XX...
+                const char* hex = "0123456789abcdef";
+                output.append(QString("\\u00"));
+                output.append(QChar(hex[ch.unicode() >> 4]));
+                output.append(QChar(hex[ch.unicode() & 0xF]));
+            } else {
+                output.append(ch);
+            }
+        }
+    }
+    output.append(QChar('"'));
+}
+
+bool JsonWriter::writeValue(Atom value) {
+    if (isNil(value)) {
+        output.append(QString("[]"));
+    } else if (value == SYMBOL_TRUE) {
+        output.append(QString("true"));
+    } else if (value == SYMBOL_FALSE) {
+        output.append(QString("false"));
+    } else if (value == nullSymbol) {
+        output.append(QString("null"));
+    } else if (isSymbol(value)) {
+        writeString(storage->getSymbolName(value));
+    } else if (isString(value)) {
+        writeString(storage->getString(value));
+    } else if (isNumber(value)) {
+        output.append(QString::number(storage->getNumber(value)));
+    } else if (isDecimalNumber(value)) {
+        double decimal = storage->getDecimal(value);
+        if (decimal != decimal || decimal - decimal != 0) {
+            // NaN and infinity cannot be represented in JSON...
+            output.append(QString("null"));
+        } else {
+            QString number = QString::number(decimal, 'g', 15);
+            if (!number.contains(QChar('.')) && !number.contains(QChar('e'))) {
+                // Keep it a decimal when parsed again...
+                number.append(QString(".0"));
+            }
+            output.append(number);
+        }
+    } else if (isCons(value) || isArray(value)) {
+        if (++depth > MAX_JSON_DEPTH) {
+            error = "Nesting too deep (or cyclic)";
+            return false;
+        }
+        if (isArray(value)) {
+            Array* array = storage->getArray(value);
+            output.append(QChar('['));
+            for (int i = 1; i <= array->length(); i++) {
+                if (i > 1) {
+                    output.append(QChar(','));
+                }
+                if (!writeValue(array->at(i))) {
+                    return false;
+                }
+            }
+            output.append(QChar(']'));
+        } else if (isObject(value)) {
+            output.append(QChar('{'));
+            while (isCons(value)) {
+                Cell cell = storage->getCons(value);
+                Cell pair = storage->getCons(cell.car);
+                writeString(storage->getSymbolName(pair.car));
+                output.append(QChar(':'));
+                if (!writeValue(storage->getCons(pair.cdr).car)) {
+                    return false;
+                }
+                value = cell.cdr;
+                if (isCons(value)) {
+                    output.append(QChar(','));
+                }
+            }
+            output.append(QChar('}'));
+        } else {
+            output.append(QChar('['));
+            while (isCons(value)) {
+                Cell cell = storage->getCons(value);
+                if (!writeValue(cell.car)) {
+                    return false;
+                }
+                value = cell.cdr;
+                if (isCons(value)) {
+                    output.append(QChar(','));
+                }
+            }
+            if (!isNil(value)) {
+                error = "An improper list cannot be written";
+                return false;
+            }
+            output.append(QChar(']'));
+        }
+        depth--;
+    } else {
+        error = "Cannot write a reference or function";
+        return false;
+    }
+    return true;
+}
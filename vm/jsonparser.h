@@ -0,0 +1,145 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+/**
+  ---------------------------------------------------------------------------
+  Contains the parser and the writer which convert between JSON and pimii
+  values.
+  ---------------------------------------------------------------------------
+  */
+#ifndef JSONPARSER_H
+#define JSONPARSER_H
+
+#include "vm/env.h"
+#include "vm/storage.h"
+
+#include <QString>
+
+/**
+  Parses JSON (UTF-8) directly into the given storage:
+
+    - objects become lists of (key value) pairs with a symbol as key
+    - arrays become lists
+    - strings become strings
+    - integers become numbers, all other numbers decimals
+    - true and false become #TRUE and #FALSE
+    - null becomes the symbol #NULL, as NIL is the empty list: both [] and
+      {} become NIL
+
+  The input is not copied, therefore it must remain valid as long as the
+  parser is used. Besides single values, the parser can also read a
+  sequence of values (like JSON lines) or the elements of a top level array
+  one by one (see nextElement()).
+  */
+class JsonParser
+{
+private:
+    Storage* storage;
+    const char* data;
+    qint64 size;
+    qint64 position;
+
+    /**
+      Contains the current nesting depth, which is limited to protect the
+      C++ stack.
+      */
+    int depth;
+
+    /**
+      Used by nextElement. Set once the start of a top level array was
+      consumed.
+      */
+    bool inArray;
+    bool started;
+
+    QString error;
+
+    void skipWhitespace();
+    bool fail(const QString& message);
+    bool expect(const char* literal);
+    bool parseValue(AtomRef* result);
+    bool parseObject(AtomRef* result);
+    bool parseArray(AtomRef* result);
+    bool parseString(QString* result);
+    bool parseNumber(AtomRef* result);
+    bool parseHex(uint* result);
+public:
+    JsonParser(Storage* storage, const char* data, qint64 size);
+
+    /**
+      Parses a single value, which must be the only content of the input.
+      */
+    bool parse(AtomRef* result);
+
+    /**
+      Parses the next element of a top level array or, if the input does not
+      start with an array, the next of the values within the input. Returns
+      false if there are no more elements or if an error occurred (see
+      hasError()).
+      */
+    bool nextElement(AtomRef* result);
+
+    bool hasError() {
+        return !error.isEmpty();
+    }
+
+    /**
+      Returns a description of the error along with its position.
+      */
+    QString getError() {
+        return error;
+    }
+};
+
+/**
+  Converts pimii values into JSON. This is the inverse of the JsonParser: A
+  list of (symbol value) pairs is written as object, all other lists and
+  arrays as arrays. NIL is written as [], #NULL as null and other symbols as
+  strings.
+  */
+class JsonWriter
+{
+private:
+    Storage* storage;
+    Atom nullSymbol;
+    QString output;
+    QString error;
+    int depth;
+
+    bool isObject(Atom list);
+    bool writeValue(Atom value);
+    void writeString(const QString& string);
+public:
+    JsonWriter(Storage* storage);
+
+    /**
+      Appends the given value to the output. Returns false if the value
+      cannot be represented in JSON (see getError()).
+      */
+    bool write(Atom value);
+
+    QString getOutput() {
+        return output;
+    }
+
+    QString getError() {
+        return error;
+    }
+};
+
+#endif // JSONPARSER_H
@@ -0,0 +1,75 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+#include "vm/mappedfile.h"
+
+#include <cstring>
+
+MappedFile::MappedFile(const QString& path) :
+    file(path), bytes(NULL), length(0)
+{
+    if (!file.open(QFile::ReadOnly)) {
+        error = QString("Cannot open %1: %2").arg(path, file.errorString());
+        return;
+    }
+    length = file.size();
+    if (length > 0) {
+        bytes = reinterpret_cast<const char*>(file.map(0, length));
+        if (bytes == NULL) {
+            error = QString("Cannot map %1: %2").arg(path,
+                                                     file.errorString());
+            length = 0;
+        }
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (bytes != NULL) {
+        file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(bytes)));
+    }
+}
+
+QString MappedFile::decode(qint64 offset, qint64 count) {
+    if (count <= 0) {
+        return QString("");
+    }
+    return QString::fromUtf8(bytes + offset, static_cast<int>(count));
+}
+
+qint64 MappedFile::indexOf(const QByteArray& needle, qint64 from, qint64 to) {
+    if (needle.isEmpty()) {
+        return from <= to ? from : -1;
+    }
+    qint64 last = to - needle.size();
+    const char* first = needle.constData();
+    while (from <= last) {
+        // memchr is heavily optimized, therefore we use it to skip to the
+        // next candidate instead of comparing byte by byte...
+        const char* candidate = static_cast<const char*>(
+                    memchr(bytes + from, *first, last - from + 1));
+        if (candidate == NULL) {
+            return -1;
+        }
+        qint64 pos = candidate - bytes;
+        if (memcmp(candidate, first, needle.size()) == 0) {
+            return pos;
+        }
+        from = pos + 1;
+    }
+    return -1;
+}
@@ -0,0 +1,100 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+/**
+  ---------------------------------------------------------------------------
+  Contains the read-only memory mapping of a file.
+  ---------------------------------------------------------------------------
+  */
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <QFile>
+#include <QString>
+
+/**
+  Maps a whole file read-only into memory. The contents are provided by
+  the operating system on demand and are never copied into the heap,
+  unless a range is decoded into a string.
+  */
+class MappedFile
+{
+private:
+    QFile file;
+
+    /**
+      Points to the first byte of the file. This is NULL for an empty file,
+      which cannot be mapped.
+      */
+    const char* bytes;
+
+    qint64 length;
+
+    QString error;
+
+    Q_DISABLE_COPY(MappedFile)
+public:
+    /**
+      Maps the given file. Use isValid() to check if this succeeded.
+      */
+    MappedFile(const QString& path);
+
+    /**
+      Determines if the file was opened and mapped.
+      */
+    bool isValid() {
+        return error.isEmpty();
+    }
+
+    /**
+      Returns the reason why the file could not be mapped.
+      */
+    QString getError() {
+        return error;
+    }
+
+    QString getPath() {
+        return file.fileName();
+    }
+
+    /**
+      Returns the mapped bytes. Only valid as long as this object exists.
+      */
+    const char* data() {
+        return bytes;
+    }
+
+    qint64 size() {
+        return length;
+    }
+
+    /**
+      Decodes the given range (UTF-8) into a string.
+      */
+    QString decode(qint64 offset, qint64 count);
+
+    /**
+      Returns the position of the first occurrence of needle within the
+      range [from, to) or -1 if it is not contained.
+      */
+    qint64 indexOf(const QByteArray& needle, qint64 from, qint64 to);
+
+    ~MappedFile();
+};
+
+#endif // MAPPEDFILE_H
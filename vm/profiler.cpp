@@ -0,0 +1,183 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <functional>
+
+#include <QFile>
+#include <QTextStream>
+#include <QMutexLocker>
+
+void SequenceProfiler::reset() {
+    counts.clear();
+    previous = 0;
+    beforePrevious = 0;
+}
+
+std::vector< std::pair<Word, Word> > SequenceProfiler::mostFrequent(
+        Word limit)
+{
+    std::vector< std::pair<Word, Word> > result;
+    for(std::map<Word, Word>::iterator
+        i = counts.begin();
+        i != counts.end();
+        ++i)
+    {
+        result.push_back(std::make_pair(i->second, i->first));
+    }
+    std::sort(result.begin(),
+              result.end(),
+              std::greater< std::pair<Word, Word> >());
+    if (result.size() > limit) {
+        result.resize(limit);
+    }
+    return result;
+}
+
+std::vector<Atom> SequenceProfiler::decode(Word sequence) {
+    std::vector<Atom> result;
+    for(int shift = 16; shift >= 0; shift -= 8) {
+        Word index = (sequence >> shift) & 0xFF;
+        if (index != 0) {
+            result.push_back(SYMBOL(OP_CODE_INDEX + index - 1));
+        }
+    }
+    return result;
+}
+
+void OpProfiler::recordBuiltInFunction(Word index, Word cycles) {
+    if (index >= bifCounts.size()) {
+        bifCounts.resize(index + 1, 0);
+        bifCycles.resize(index + 1, 0);
+    }
+    bifCounts[index]++;
+    bifCycles[index] += cycles;
+}
+
+void OpProfiler::reset() {
+    for(Word i = 0; i < NUMBER_OF_OP_CODES; i++) {
+        opCounts[i] = 0;
+        opCycles[i] = 0;
+    }
+    bifCounts.clear();
+    bifCycles.clear();
+}
+
+static bool compareByCycles(const ProfileEntry& a, const ProfileEntry& b) {
+    return a.cycles > b.cycles;
+}
+
+std::vector<ProfileEntry> OpProfiler::report() {
+    std::vector<ProfileEntry> result;
+    for(Word i = 0; i < NUMBER_OF_OP_CODES; i++) {
+        if (opCounts[i] > 0) {
+            ProfileEntry entry;
+            entry.name = SYMBOL(OP_CODE_INDEX + i);
+            entry.count = opCounts[i];
+            entry.cycles = opCycles[i];
+            result.push_back(entry);
+        }
+    }
+    for(Word i = 0; i < bifCounts.size(); i++) {
+        if (bifCounts[i] > 0) {
+            ProfileEntry entry;
+            entry.name = tagIndex(i, TAG_TYPE_BIF);
+            entry.count = bifCounts[i];
+            entry.cycles = bifCycles[i];
+            result.push_back(entry);
+        }
+    }
+    std::stable_sort(result.begin(), result.end(), compareByCycles);
+    return result;
+}
+
+void SamplingTimer::run() {
+    while (active) {
+        msleep(interval);
+        if (active) {
+            profiler->requestSample();
+        }
+    }
+}
+
+void SamplingProfiler::start(unsigned long interval) {
+    QMutexLocker timerLocker(&timerLock);
+    stopTimer();
+    QMutexLocker locker(&lock);
+    stacks.clear();
+    sampleRequested.fetchAndStoreOrdered(false);
+    timer = new SamplingTimer(this, interval);
+    timer->start();
+}
+
+void SamplingProfiler::stop() {
+    QMutexLocker locker(&timerLock);
+    stopTimer();
+}
+
+void SamplingProfiler::stopTimer() {
+    if (timer != NULL) {
+        timer->deactivate();
+        timer->wait();
+        delete timer;
+        timer = NULL;
+    }
+    sampleRequested.fetchAndStoreOrdered(false);
+}
+
+void SamplingProfiler::record(const QString& stack) {
+    sampleRequested.fetchAndStoreOrdered(false);
+    QMutexLocker locker(&lock);
+    stacks[stack]++;
+}
+
+std::vector< std::pair<Word, QString> > SamplingProfiler::report() {
+    std::vector< std::pair<Word, QString> > result;
+    QMutexLocker locker(&lock);
+    for(std::map<QString, Word>::iterator
+        i = stacks.begin();
+        i != stacks.end();
+        ++i)
+    {
+        result.push_back(std::make_pair(i->second, i->first));
+    }
+    std::sort(result.begin(),
+              result.end(),
+              std::greater< std::pair<Word, QString> >());
+    return result;
+}
+
+bool SamplingProfiler::writeFoldedStacks(const QString& fileName) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    QTextStream out(&file);
+    QMutexLocker locker(&lock);
+    for(std::map<QString, Word>::iterator
+        i = stacks.begin();
+        i != stacks.end();
+        ++i)
+    {
+        out << i->first << " " << i->second << "\n";
+    }
+    return true;
+}
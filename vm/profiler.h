@@ -0,0 +1,329 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+/**
+  ---------------------------------------------------------------------------
+  Contains profilers which record statistics about the executed bytecode.
+  ---------------------------------------------------------------------------
+  */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "vm/env.h"
+
+#include <map>
+#include <vector>
+#include <utility>
+
+#include <QString>
+#include <QThread>
+#include <QMutex>
+#include <QAtomicInt>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#else
+#include <QElapsedTimer>
+#endif
+
+/**
+  Records how often sequences (n-grams) of two and three op codes are
+  executed. This is used to determine which sequences are worth to be
+  replaced by a superinstruction (see PeepholeOptimizer).
+  */
+class SequenceProfiler
+{
+private:
+    /**
+      Maps an encoded sequence to the number of times it was executed.
+      Each op code within a sequence is encoded as 8 bit value: Its offset
+      relative to OP_CODE_INDEX plus one, so that 0 means "no op code".
+      */
+    std::map<Word, Word> counts;
+
+    /**
+      Contains the encoded op code which was executed last.
+      */
+    Word previous;
+
+    /**
+      Contains the encoded op code which was executed before the last one.
+      */
+    Word beforePrevious;
+
+    Q_DISABLE_COPY(SequenceProfiler)
+public:
+    SequenceProfiler() : previous(0), beforePrevious(0) {}
+
+    /**
+      Records the execution of the given op code.
+      */
+    inline void record(Atom opcode) {
+        Word current = untagIndex(opcode) - OP_CODE_INDEX + 1;
+        if (previous != 0) {
+            counts[previous << 8 | current]++;
+            if (beforePrevious != 0) {
+                counts[beforePrevious << 16 | previous << 8 | current]++;
+            }
+        }
+        beforePrevious = previous;
+        previous = current;
+    }
+
+    /**
+      Discards all recorded sequences.
+      */
+    void reset();
+
+    /**
+      Returns the given number of sequences which were executed most often.
+      Each pair contains the number of executions and the encoded sequence.
+      */
+    std::vector< std::pair<Word, Word> > mostFrequent(Word limit);
+
+    /**
+      Decodes a sequence returned by mostFrequent into a list of op codes.
+      */
+    static std::vector<Atom> decode(Word sequence);
+};
+
+/**
+  Reads the time stamp counter of the CPU. On platforms without such a
+  counter, the elapsed nanoseconds are used instead.
+  */
+inline Word readCycleCounter() {
+#if defined(__i386__) || defined(__x86_64__)
+    return __rdtsc();
+#else
+    static QElapsedTimer timer;
+    if (!timer.isValid()) {
+        timer.start();
+    }
+    return timer.nsecsElapsed();
+#endif
+}
+
+/**
+  Represents a line reported by the OpProfiler: An op code or a built in
+  function along with its number of executions and the cycles spent.
+  */
+struct ProfileEntry {
+    Atom name;
+    Word count;
+    Word cycles;
+};
+
+/**
+  Records how often each op code and each built in function is executed
+  and how many cycles are spent within. The cycles of an op code which
+  invokes a built in function include the cycles of the function.
+  */
+class OpProfiler
+{
+private:
+    /**
+      Contains the number of executions per op code, indexed relative to
+      OP_CODE_INDEX.
+      */
+    Word opCounts[NUMBER_OF_OP_CODES];
+
+    /**
+      Contains the cycles spent per op code, indexed relative to
+      OP_CODE_INDEX.
+      */
+    Word opCycles[NUMBER_OF_OP_CODES];
+
+    /**
+      Contains the number of invocations per built in function, indexed
+      like the bifTable of the engine.
+      */
+    std::vector<Word> bifCounts;
+
+    /**
+      Contains the cycles spent per built in function, indexed like the
+      bifTable of the engine.
+      */
+    std::vector<Word> bifCycles;
+
+    Q_DISABLE_COPY(OpProfiler)
+public:
+    OpProfiler() {
+        reset();
+    }
+
+    /**
+      Records the execution of the given op code.
+      */
+    inline void recordOp(Atom opcode, Word cycles) {
+        Word index = untagIndex(opcode) - OP_CODE_INDEX;
+        if (index < NUMBER_OF_OP_CODES) {
+            opCounts[index]++;
+            opCycles[index] += cycles;
+        }
+    }
+
+    /**
+      Records the invocation of the built in function with the given
+      index.
+      */
+    void recordBuiltInFunction(Word index, Word cycles);
+
+    /**
+      Discards all recorded values.
+      */
+    void reset();
+
+    /**
+      Returns all op codes and built in functions which were executed at
+      least once, sorted by the cycles spent (descending).
+      */
+    std::vector<ProfileEntry> report();
+};
+
+class SamplingProfiler;
+
+/**
+  Periodically asks the SamplingProfiler to take a sample. This runs in its
+  own thread, so that it doesn't depend on the event loop which is blocked
+  while the engine interprets.
+  */
+class SamplingTimer : public QThread
+{
+private:
+    SamplingProfiler* profiler;
+    unsigned long interval;
+    QAtomicInt active;
+public:
+    SamplingTimer(SamplingProfiler* profiler, unsigned long interval) :
+        profiler(profiler), interval(interval), active(true) {}
+
+    /**
+      Requests the timer to stop. Use wait() to await its termination.
+      */
+    void deactivate() {
+        active.fetchAndStoreOrdered(false);
+    }
+protected:
+    virtual void run();
+};
+
+/**
+  Aggregates samples of the call stack as "folded stacks": Each distinct
+  stack (outermost frame first, frames separated by ';') is mapped to the
+  number of samples it was seen in. This is the input format of
+  flamegraph.pl and speedscope.
+
+  The SamplingTimer only sets a flag, the engine checks it while
+  interpreting and then records its current stack via record().
+  */
+class SamplingProfiler
+{
+private:
+    /**
+      Maps each folded stack to its number of samples.
+      */
+    std::map<QString, Word> stacks;
+
+    /**
+      Set by the timer thread, once a sample should be taken.
+      */
+    QAtomicInt sampleRequested;
+
+    /**
+      Contains the running timer or NULL, if the profiler is stopped.
+      */
+    SamplingTimer* timer;
+
+    /**
+      Protects timer, as the profiler is started and stopped by the UI as
+      well as by the engine thread (via engine::setValue).
+      */
+    QMutex timerLock;
+
+    /**
+      Protects stacks, as samples are recorded by the engine thread while
+      the UI reads them.
+      */
+    QMutex lock;
+
+    /**
+      Stops the timer. The timerLock must be held by the caller.
+      */
+    void stopTimer();
+
+    Q_DISABLE_COPY(SamplingProfiler)
+public:
+    SamplingProfiler() : sampleRequested(false), timer(NULL) {}
+
+    ~SamplingProfiler() {
+        stop();
+    }
+
+    /**
+      Discards all previous samples and starts a timer which requests a
+      sample every given number of milliseconds.
+      */
+    void start(unsigned long interval);
+
+    /**
+      Stops the timer. The recorded samples remain available.
+      */
+    void stop();
+
+    /**
+      Determines if the timer is running.
+      */
+    bool isRunning() {
+        QMutexLocker locker(&timerLock);
+        return timer != NULL;
+    }
+
+    /**
+      Called by the timer thread to request a sample.
+      */
+    inline void requestSample() {
+        sampleRequested.fetchAndStoreOrdered(true);
+    }
+
+    /**
+      Determines if the engine should record a sample.
+      */
+    inline bool isSampleRequested() {
+        return sampleRequested;
+    }
+
+    /**
+      Records a sample of the given folded stack.
+      */
+    void record(const QString& stack);
+
+    /**
+      Returns all recorded stacks along with their number of samples,
+      sorted by the number of samples (descending).
+      */
+    std::vector< std::pair<Word, QString> > report();
+
+    /**
+      Writes all recorded stacks as "stack count" lines into the given file.
+      Returns false if the file cannot be written.
+      */
+    bool writeFoldedStacks(const QString& fileName);
+};
+
+#endif // PROFILER_H
@@ -0,0 +1,60 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+/**
+  ---------------------------------------------------------------------------
+  Contains the base class for references which can be destructured like a
+  list.
+  ---------------------------------------------------------------------------
+  */
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#include "vm/reference.h"
+#include "vm/storage.h"
+
+/**
+  A reference which produces its elements one by one, on demand.
+
+  A sequence can be used wherever a list is destructured ([h|t := seq : ..]).
+  The head is bound to the next element and the tail to the sequence itself.
+  Therefore functions like each:do: or fold:with:start: consume a sequence
+  element by element, without it ever being materialized as a list. As the
+  sequence keeps its position, it can only be traversed once.
+  */
+class Sequence : public Reference
+{
+protected:
+    Sequence() {}
+public:
+    /**
+      Creates the next element in the given storage and stores it in value.
+      Returns false once the sequence is exhausted.
+      */
+    virtual bool next(Storage* storage, AtomRef* value) = 0;
+
+    /**
+      Returns a description of the error, if next returned false because
+      the input was invalid. The engine turns this into a panic.
+      */
+    virtual QString getError() {
+        return QString();
+    }
+};
+
+#endif // SEQUENCE_H
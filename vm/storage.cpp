@@ -23,9 +23,13 @@
 #include <algorithm>
 #include <deque>
 
-Storage::Storage() : log("STORE") {
+#include <QElapsedTimer>
+
+Storage::Storage() : log("STORE"), symbolTable(SymbolTable::INSTANCE) {
     initializeSymbols();
     gcCounter = 0;
+    gcTime = 0;
+    globalsVersion = 0;
     nextFree = 0;
     cellSize = 0;
     cellsInUse = 0;
@@ -88,6 +92,26 @@ void Storage::initializeSymbols() {
     declaredFixedSymbol(SYMBOL_OP_LINE, "LINE");
     declaredFixedSymbol(SYMBOL_OP_RPLCAR, "RPLCAR");
     declaredFixedSymbol(SYMBOL_OP_RPLCDR, "RPLCDR");
+    declaredFixedSymbol(SYMBOL_OP_LDADDC, "LDADDC");
+    declaredFixedSymbol(SYMBOL_OP_LDSUBC, "LDSUBC");
+    declaredFixedSymbol(SYMBOL_OP_TESTC, "TESTC");
+    declaredFixedSymbol(SYMBOL_OP_CALLG, "CALLG");
+    declaredFixedSymbol(SYMBOL_OP_CALLG0, "CALLG0");
+    declaredFixedSymbol(SYMBOL_OP_AP1, "AP1");
+    declaredFixedSymbol(SYMBOL_OP_AP2, "AP2");
+    declaredFixedSymbol(SYMBOL_OP_AP3, "AP3");
+    declaredFixedSymbol(SYMBOL_OP_AP4, "AP4");
+    declaredFixedSymbol(SYMBOL_OP_APV, "APV");
+    declaredFixedSymbol(SYMBOL_OP_ENTRY, "ENTRY");
+    declaredFixedSymbol(SYMBOL_OP_JIT, "JIT");
+    declaredFixedSymbol(SYMBOL_OP_LDU, "LDU");
+    declaredFixedSymbol(SYMBOL_OP_STU, "STU");
+    declaredFixedSymbol(SYMBOL_OP_LDGU, "LDGU");
+    declaredFixedSymbol(SYMBOL_OP_STGU, "STGU");
+    declaredFixedSymbol(SYMBOL_OP_LINEU, "LINEU");
+    declaredFixedSymbol(SYMBOL_OP_LDADDCU, "LDADDCU");
+    declaredFixedSymbol(SYMBOL_OP_LDSUBCU, "LDSUBCU");
+    declaredFixedSymbol(SYMBOL_OP_TESTCU, "TESTCU");
     declaredFixedSymbol(SYMBOL_VALUE_HOME_PATH, "HOME_PATH");
     declaredFixedSymbol(SYMBOL_VALUE_OP_COUNT, "OP_COUNT");
     declaredFixedSymbol(SYMBOL_VALUE_GC_COUNT, "GC_COUNT");
@@ -112,18 +136,28 @@ void Storage::initializeSymbols() {
                         "NUM_TOTAL_ARRAYS");
     declaredFixedSymbol(SYMBOL_VALUE_NUM_ARRAYS_USED,
                         "NUM_ARRAYS_USED");
+    declaredFixedSymbol(SYMBOL_VALUE_PROFILE_OP_SEQUENCES,
+                        "PROFILE_OP_SEQUENCES");
+    declaredFixedSymbol(SYMBOL_VALUE_OP_SEQUENCES, "OP_SEQUENCES");
+    declaredFixedSymbol(SYMBOL_VALUE_PROFILE_OPS, "PROFILE_OPS");
+    declaredFixedSymbol(SYMBOL_VALUE_OP_PROFILE, "OP_PROFILE");
+    declaredFixedSymbol(SYMBOL_VALUE_PROFILE_SAMPLES, "PROFILE_SAMPLES");
+    declaredFixedSymbol(SYMBOL_VALUE_SAMPLES, "SAMPLES");
+    declaredFixedSymbol(SYMBOL_VALUE_JIT_ENABLED, "JIT_ENABLED");
+    declaredFixedSymbol(SYMBOL_VALUE_JIT_BLOCKS, "JIT_BLOCKS");
+    declaredFixedSymbol(SYMBOL_VALUE_JIT_PERF_MAP, "JIT_PERF_MAP");
 }
 
 
 Atom Storage::makeSymbol(const QString& name) {
-    Word result = symbolTable.add(name, name);
+    Word result = symbolTable->add(name);
     assert(result < MAX_INDEX_SIZE);
     return tagIndex(result, TAG_TYPE_SYMBOL);
 }
 
 QString Storage::getSymbolName(Atom symbol) {
     assert(isSymbol(symbol));
-    return symbolTable.getKey(untagIndex(symbol));
+    return symbolTable->getName(untagIndex(symbol));
 }
 
 Atom Storage::makeCons(Atom car, Atom cdr) {
@@ -181,6 +215,8 @@ Atom Storage::makeCons(Atom car, Atom cdr) {
 }
 
 void Storage::gc(bool major, Atom car, Atom cdr) {
+    QElapsedTimer watch;
+    watch.start();
 
     if (major) {
         // Cleanup ref counts
@@ -194,6 +230,7 @@ void Storage::gc(bool major, Atom car, Atom cdr) {
                 arrayTable.get(i).data()->checked = false;
             }
         }
+        dirtyArrays.clear();
 
         for(Word i = 0; i < cellSize; i++) {
             states[i] = GRAY;
@@ -241,6 +278,18 @@ void Storage::gc(bool major, Atom car, Atom cdr) {
         }
     }
 
+    // Arrays which were written since they were checked might be
+    // reachable from checked cells only, which a minor GC doesn't revisit.
+    for(std::vector<Array*>::iterator
+        iter = dirtyArrays.begin();
+        iter != dirtyArrays.end();
+        ++iter) {
+        if (!(*iter)->checked) {
+            markArray(*iter, NULL);
+        }
+    }
+    dirtyArrays.clear();
+
     FINE(log, "GC: GC-Roots:" << gcRoots);
 
     // execute mark-phase
@@ -248,6 +297,7 @@ void Storage::gc(bool major, Atom car, Atom cdr) {
 
     // execute sweep-phase
     sweep();
+    clearWeakReferences();
 
     if (major) {
         stringTable.gc();
@@ -258,6 +308,7 @@ void Storage::gc(bool major, Atom car, Atom cdr) {
     }
 
     gcCounter++;
+    gcTime += watch.nsecsElapsed();
 }
 
 void Storage::incValueTable(Atom atom, Word idx, std::deque<Word>* refQueue) {
@@ -271,27 +322,31 @@ void Storage::incValueTable(Atom atom, Word idx, std::deque<Word>* refQueue) {
         arrayTable.inc(idx);
         Array* array = arrayTable.get(idx).data();
         if (!array->checked) {
-            array->checked = true;
-            for(int i = 1; i < array->length(); i++) {
-                Atom a = array->at(i);
-                Word aIdx = untagIndex(a);
-                if (isCons(a)) {
-                    if (states[aIdx] != CHECKED) {
-                        states[aIdx] = REFERENCED;
-                        if (refQueue != NULL) {
-                            refQueue->push_back(aIdx);
-                        }
-                    }
-                } else {
-                    incValueTable(a, aIdx, refQueue);
-                }
-            }
+            markArray(array, refQueue);
         }
     } else if (isReference(atom)) {
         referenceTable.inc(idx);
     }
 }
 
+void Storage::markArray(Array* array, std::deque<Word>* refQueue) {
+    array->checked = true;
+    for(int i = 1; i <= array->length(); i++) {
+        Atom a = array->at(i);
+        Word aIdx = untagIndex(a);
+        if (isCons(a)) {
+            if (states[aIdx] != CHECKED) {
+                states[aIdx] = REFERENCED;
+                if (refQueue != NULL) {
+                    refQueue->push_back(aIdx);
+                }
+            }
+        } else {
+            incValueTable(a, aIdx, refQueue);
+        }
+    }
+}
+
 void Storage::markCell(Word index,
                        std::deque<Word>& refQueue,
                        bool alwaysQueue) {
@@ -369,12 +424,28 @@ void Storage::sweep() {
          ", Avg: " << avgGCEfficiency.average() << "%)");
 }
 
+void Storage::clearWeakReferences() {
+    for(std::set<WeakAtomRef*>::iterator
+        iter = weakReferences.begin();
+        iter != weakReferences.end();
+        ++iter) {
+        WeakAtomRef* ref = *iter;
+        if (isCons(ref->atom()) && states[untagIndex(ref->atom())] == UNUSED) {
+            ref->atom(NIL);
+        }
+    }
+}
+
 AtomRef* Storage::ref(Atom atom) {
     AtomRef* result = new AtomRef(this, atom);
 
     return result;
 }
 
+WeakAtomRef* Storage::weakRef(Atom atom) {
+    return new WeakAtomRef(this, atom);
+}
+
 Atom Storage::append(Atom tail, Atom next) {
     AtomRef tailRef(this, tail);
     Atom tmp = makeCons(next, NIL);
@@ -434,6 +505,11 @@ QString Storage::getGlobalName(Atom atom) {
     return getSymbolName(globalsTable.getKey(untagIndex(atom)));
 }
 
+Atom Storage::getGlobalSymbol(Atom atom) {
+    assert(isGlobal(atom));
+    return globalsTable.getKey(untagIndex(atom));
+}
+
 Atom Storage::readGlobal(Atom atom) {
     assert(isGlobal(atom));
     return globalsTable.getValue(untagIndex(atom));
@@ -441,15 +517,102 @@ Atom Storage::readGlobal(Atom atom) {
 
 void Storage::writeGlobal(Atom atom, Atom value) {
     assert(isGlobal(atom));
+    Atom oldValue = globalsTable.getValue(untagIndex(atom));
+    if (oldValue != value && (isCons(oldValue) || isBIF(oldValue))) {
+        // Invalidate all inline caches which might refer to the old value.
+        // The version is kept within the range of small numbers.
+        globalsVersion = (globalsVersion + 1) & MAX_SMALL_INT_SIZE;
+    }
     globalsTable.setValue(untagIndex(atom), value);
 }
 
+void Storage::invalidateForeignCaches(Storage* source) {
+    globalsVersion = (qMax(globalsVersion, source->globalsVersion) + 1) &
+            MAX_SMALL_INT_SIZE;
+}
+
 Atom Storage::makeString(const QString& string) {
-    Word index = stringTable.allocate(string);
+    StringValue value;
+    value.buffer = string;
+    value.offset = 0;
+    value.length = string.length();
+    Word index = stringTable.allocate(value);
+    assert(index < MAX_INDEX_SIZE);
+    return tagIndex(index, TAG_TYPE_STRING);
+}
+
+int Storage::getStringLength(Atom atom) {
+    assert(isString(atom));
+    return stringTable.get(untagIndex(atom)).length;
+}
+
+QChar Storage::getStringChar(Atom atom, int pos) {
+    assert(isString(atom));
+    StringValue value = stringTable.get(untagIndex(atom));
+    assert(pos >= 0 && pos < value.length);
+    return value.chars().at(value.offset + pos);
+}
+
+Atom Storage::makeSubString(Atom string, int pos, int length) {
+    assert(isString(string));
+    StringValue value = stringTable.get(untagIndex(string));
+    assert(pos >= 0 && length >= 0 && pos + length <= value.length);
+    if (pos == 0 && length == value.length) {
+        // Strings are immutable, therefore the string itself can be used.
+        return string;
+    }
+    if (length < (int)TUNING_PARAM_MIN_SUBSTRING_SHARING_LENGTH) {
+        // Short substrings are copied, so that a single token doesn't keep
+        // a large text alive.
+        return makeString(value.chars().mid(value.offset + pos, length));
+    }
+    value.offset += pos;
+    value.length = length;
+    Word index = stringTable.allocate(value);
+    assert(index < MAX_INDEX_SIZE);
+    return tagIndex(index, TAG_TYPE_STRING);
+}
+
+Atom Storage::appendString(Atom string, const QString& suffix) {
+    assert(isString(string));
+    StringValue value = stringTable.get(untagIndex(string));
+    if (value.builder.isNull() ||
+        value.offset + value.length != value.builder->length()) {
+        if (value.length + suffix.length() <
+                (int)TUNING_PARAM_MIN_STRING_BUILDER_LENGTH) {
+            return makeString(getString(string) + suffix);
+        }
+        // Either the string has no builder or another string was already
+        // appended to it. Therefore a new builder is started.
+        QSharedPointer<QString> builder(new QString());
+        builder->reserve(2 * (value.length + suffix.length()));
+        builder->append(value.chars().mid(value.offset, value.length));
+        value.buffer = QString();
+        value.builder = builder;
+        value.offset = 0;
+    }
+    value.builder->append(suffix);
+    value.length += suffix.length();
+    Word index = stringTable.allocate(value);
     assert(index < MAX_INDEX_SIZE);
     return tagIndex(index, TAG_TYPE_STRING);
 }
 
+int Storage::compareStrings(Atom a, Atom b) {
+    assert(isString(a) && isString(b));
+    StringValue as = stringTable.get(untagIndex(a));
+    StringValue bs = stringTable.get(untagIndex(b));
+    const QChar* pa = as.chars().unicode() + as.offset;
+    const QChar* pb = bs.chars().unicode() + bs.offset;
+    int length = std::min(as.length, bs.length);
+    for(int i = 0; i < length; i++) {
+        if (pa[i] != pb[i]) {
+            return pa[i].unicode() - pb[i].unicode();
+        }
+    }
+    return as.length - bs.length;
+}
+
 double Storage::getDecimal(Atom atom) {
     assert(isDecimalNumber(atom));
     Word index = untagIndex(atom);
@@ -468,7 +631,14 @@ Array* Storage::getArray(Atom atom) {
 }
 
 Atom Storage::makeArray(int size) {
-    Array* result = new Array(size);
+    Array* result = new Array(size, &dirtyArrays);
+    Word index = arrayTable.allocate(QSharedPointer<Array>(result));
+    assert(index < MAX_INDEX_SIZE);
+    return tagIndex(index, TAG_TYPE_ARRAY);
+}
+
+Atom Storage::makeArraySlice(Atom array, int pos, int length) {
+    Array* result = new Array(getArray(array), pos, length);
     Word index = arrayTable.allocate(QSharedPointer<Array>(result));
     assert(index < MAX_INDEX_SIZE);
     return tagIndex(index, TAG_TYPE_ARRAY);
@@ -489,12 +659,16 @@ Atom Storage::makeReference(Reference* value) {
 QString Storage::getString(Atom atom) {
     assert(isString(atom));
     Word index = untagIndex(atom);
-    return stringTable.get(index);
+    StringValue value = stringTable.get(index);
+    if (value.offset == 0 && value.length == value.chars().length()) {
+        return value.chars();
+    }
+    return value.chars().mid(value.offset, value.length);
 }
 
 Atom Storage::makeNumber(Number value) {
-    if ((value & LOST_BITS) == 0 || (value & LOST_BITS) == LOST_BITS) {
-        return static_cast<Word>(value) << TAG_LENGTH | TAG_TYPE_NUMBER;
+    if (fitsSmallNumber(value)) {
+        return tagSmallNumber(value);
     } else {
         Word index = largeNumberTable.allocate(value);
         assert(index < MAX_INDEX_SIZE);
@@ -505,11 +679,7 @@ Atom Storage::makeNumber(Number value) {
 Number Storage::getNumber(Atom atom) {
     assert(isNumber(atom));
     if (isSmallNumber(atom)) {
-        Word result = atom >> TAG_LENGTH;
-        if (atom & SIGN_CHECK_BIT) {
-            result |= LOST_BITS;
-        }
-        return static_cast<Number>(result);
+        return untagSmallNumber(atom);
     } else {
         Word index = untagIndex(atom);
         return largeNumberTable.get(index);
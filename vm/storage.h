@@ -27,6 +27,7 @@
 
 #include "vm/env.h"
 #include "vm/lookuptable.h"
+#include "vm/symboltable.h"
 #include "vm/valuetable.h"
 #include "vm/reference.h"
 #include "vm/array.h"
@@ -37,6 +38,7 @@
 
 #include <set>
 #include <deque>
+#include <vector>
 
 /**
   Represents the central unit of memory management. All data
@@ -71,10 +73,36 @@ enum EntryState {
     CHECKED
 };
 
+/**
+  Represents the value of a string. A substring (see
+  Storage::makeSubString) refers to the characters of the string it was
+  taken from, instead of copying them. The QString is implicitly shared,
+  therefore it stays alive as long as one of its substrings is in use.
+
+  Large strings which are built by concatenation (see Storage::appendString)
+  keep their characters in a builder instead. This is shared by all
+  strings created by appending to the same string. As each of them only
+  refers to a prefix of the builder, it can be extended in place.
+  */
+struct StringValue {
+    QString buffer;
+    QSharedPointer<QString> builder;
+    int offset;
+    int length;
+
+    /**
+      Returns the buffer which contains the characters of the string.
+      */
+    const QString& chars() const {
+        return builder.isNull() ? buffer : *builder;
+    }
+};
+
 /**
   Forward reference. See below.
   */
 class AtomRef;
+class WeakAtomRef;
 
 /**
   Storage area, contains a complete storage image for
@@ -98,19 +126,25 @@ class Storage
     Logger log;
 
     /**
-      Maps Strings to unique symbol indices
+      Maps Strings to unique symbol indices. This is shared by all storages.
       */
-    LookupTable <QString, QString, Word> symbolTable;
+    SymbolTable* symbolTable;
 
     /**
       Maps symbols to global variables.
       */
     LookupTable <Word, Atom, Word> globalsTable;
 
+    /**
+      Incremented each time a global, which contained a closure or a built
+      in function, is overwritten. This is used to validate inline caches.
+      */
+    Word globalsVersion;
+
     /**
       Contains the table of used strings.
       */
-    ValueTable <Word, QString> stringTable;
+    ValueTable <Word, StringValue> stringTable;
 
     /**
       Contains the table of large numbers.
@@ -127,6 +161,12 @@ class Storage
       */
     ValueTable < Word, QSharedPointer<Array> > arrayTable;
 
+    /**
+      Contains the arrays which were written after the garbage collector
+      checked them. See Array::put.
+      */
+    std::vector<Array*> dirtyArrays;
+
     /**
       Contains the table of references
       */
@@ -157,6 +197,11 @@ class Storage
       */
     Word gcCounter;
 
+    /**
+      Contains the total time spent in garbage collections in nanoseconds.
+      */
+    qint64 gcTime;
+
     /**
       Contains the average ratio of freed cells within a GC run.
       */
@@ -173,12 +218,22 @@ class Storage
       */
     std::set<AtomRef*> strongReferences;
 
+    /**
+      Contains all external references to cells which don't keep them alive.
+      */
+    std::set<WeakAtomRef*> weakReferences;
+
     /**
       Increments the location in the given value table if the given
       atom points to one.
       */
     void incValueTable(Atom atom, Word idx, std::deque<Word>* refQueue);
 
+    /**
+      Marks the elements of the given array as referenced.
+      */
+    void markArray(Array* array, std::deque<Word>* refQueue);
+
     /**
       Invokes the garbage collector.
       */
@@ -200,8 +255,14 @@ class Storage
       */
     void sweep();
 
+    /**
+      Resets all weak references to NIL whose cell was reclaimed by the
+      last sweep.
+      */
+    void clearWeakReferences();
 
     friend class AtomRef;
+    friend class WeakAtomRef;
 
     Q_DISABLE_COPY(Storage)
 public:
@@ -256,6 +317,11 @@ public:
       */
     QString getGlobalName(Atom atom);
 
+    /**
+      Returns the symbol which names the given global.
+      */
+    Atom getGlobalSymbol(Atom atom);
+
     /**
       Reads the given global.
       */
@@ -266,6 +332,21 @@ public:
       */
     void writeGlobal(Atom atom, Atom value);
 
+    /**
+      Returns the current version of the globals table as number atom. Values
+      read from globals can be cached as long as this version doesn't change.
+      */
+    inline Atom getGlobalsVersion() {
+        return makeNumber(globalsVersion);
+    }
+
+    /**
+      Makes the globals version newer than the one of the given storage.
+      Code which is copied from there (see Copier) contains inline caches
+      which are invalidated this way.
+      */
+    void invalidateForeignCaches(Storage* source);
+
     /**
       Returns the string value to which the given atom points.
       */
@@ -276,6 +357,40 @@ public:
       */
     Atom makeString(const QString& string);
 
+    /**
+      Returns the length of the given string, without materializing it, if
+      it is a substring.
+      */
+    int getStringLength(Atom atom);
+
+    /**
+      Returns the character at the given position (starting at 0) of the
+      given string.
+      */
+    QChar getStringChar(Atom atom, int pos);
+
+    /**
+      Creates a substring of the given string which contains length
+      characters, starting at pos (starting at 0). The range must be within
+      the given string. Unless it is very short, the substring shares the
+      characters of the given string.
+      */
+    Atom makeSubString(Atom string, int pos, int length);
+
+    /**
+      Compares the two given strings by their UTF-16 code units, like
+      QString::compare does. Substrings are not materialized.
+      */
+    int compareStrings(Atom a, Atom b);
+
+    /**
+      Creates a string which consists of the given string followed by the
+      given suffix. If the string ends at the end of its builder, the suffix
+      is appended in place, therefore appending to a large string in a
+      loop takes amortized linear time overall.
+      */
+    Atom appendString(Atom string, const QString& suffix);
+
     /**
       Returns the number value to which the given atom points.
       */
@@ -306,6 +421,13 @@ public:
       */
     Atom makeArray(int size);
 
+    /**
+      Creates a slice of the given array which contains length elements,
+      starting at pos (starting at 1). The range must be within the given
+      array. See Array for details.
+      */
+    Atom makeArraySlice(Atom array, int pos, int length);
+
     /**
       Returns the reference to which the given atom points.
       */
@@ -322,6 +444,13 @@ public:
       */
     AtomRef* ref(Atom atom);
 
+    /**
+      Creates a new weak reference to the given cell. Other than a ref, it
+      doesn't keep the cell alive but is reset to NIL once the cell is
+      reclaimed.
+      */
+    WeakAtomRef* weakRef(Atom atom);
+
     /**
       Returns the number of executed GCs.
       */
@@ -329,6 +458,13 @@ public:
         return gcCounter;
     }
 
+    /**
+      Returns the total time spent in GCs in nanoseconds.
+      */
+    qint64 statusGCTime() {
+        return gcTime;
+    }
+
     double statusGCEfficienty() {
         return avgGCEfficiency.average();
     }
@@ -344,7 +480,7 @@ public:
       Returns the size of the symbol table.
       */
     Word statusNumSymbols() {
-        return symbolTable.size();
+        return symbolTable->size();
     }
 
     /**
@@ -472,5 +608,36 @@ public:
 
 };
 
+/**
+  Describes a "weak" reference to a cell. It doesn't prevent the cell from
+  beeing garbage collected, but is reset to NIL once this happens.
+  */
+class WeakAtomRef {
+private:
+    Storage* storage;
+    Atom referencedAtom;
+
+    Q_DISABLE_COPY(WeakAtomRef)
+public:
+    WeakAtomRef(Storage* storage, Atom atom) :
+        storage(storage),
+        referencedAtom(atom) {
+        storage->weakReferences.insert(this);
+    }
+
+    inline Atom atom() {
+        return referencedAtom;
+    }
+
+    inline void atom(Atom atom) {
+        referencedAtom = atom;
+    }
+
+    ~WeakAtomRef() {
+        storage->weakReferences.erase(this);
+    }
+
+};
+
 
 #endif // STORAGE_H
@@ -0,0 +1,67 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+
+#include "vm/submissionqueue.h"
+#include "vm/asyncoperation.h"
+
+SubmissionQueue::~SubmissionQueue() {
+    Submission* submission = takeAll();
+    while(submission != NULL) {
+        Submission* next = submission->next;
+        delete submission->fn;
+        delete submission->operation;
+        delete submission;
+        submission = next;
+    }
+}
+
+void SubmissionQueue::push(Submission* submission) {
+    Submission* current;
+    do {
+        current = head;
+        submission->next = current;
+    } while(!head.testAndSetOrdered(current, submission));
+    signal.release();
+}
+
+Submission* SubmissionQueue::takeAll() {
+    Submission* submission = head.fetchAndStoreOrdered(NULL);
+    // The stack contains the latest submission first, therefore we reverse
+    // it...
+    Submission* result = NULL;
+    while(submission != NULL) {
+        Submission* next = submission->next;
+        submission->next = result;
+        result = submission;
+        submission = next;
+    }
+    return result;
+}
+
+bool SubmissionQueue::isEmpty() {
+    return static_cast<Submission*>(head) == NULL;
+}
+
+void SubmissionQueue::waitForSubmissions() {
+    signal.acquire();
+}
+
+void SubmissionQueue::wakeUp() {
+    signal.release();
+}
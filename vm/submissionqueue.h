@@ -0,0 +1,134 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+/**
+  ---------------------------------------------------------------------------
+  Contains the queue which passes work from other threads to the engine.
+  ---------------------------------------------------------------------------
+  */
+
+#ifndef SUBMISSIONQUEUE_H
+#define SUBMISSIONQUEUE_H
+
+#include "vm/env.h"
+#include "vm/storage.h"
+
+#include <QString>
+#include <QAtomicPointer>
+#include <QSemaphore>
+
+class AsyncOperation;
+
+/**
+  Represents work submitted to the engine: Either source code, which is
+  compiled by the engine once it accepts the submission, an already
+  compiled function or the continuation of a completed AsyncOperation.
+  */
+struct Submission {
+    /**
+      Contains the source code to compile, if fn is NULL.
+      */
+    QString source;
+
+    /**
+      Contains the name of the file which is executed.
+      */
+    QString filename;
+
+    /**
+      Contains the function to execute or NULL if source is to be compiled.
+      */
+    AtomRef* fn;
+
+    /**
+      If not NULL, fn is a continuation which is applied to the arguments
+      created by this operation.
+      */
+    AsyncOperation* operation;
+
+    /**
+      Determines if the result of the execution is to be logged.
+      */
+    bool printStackTop;
+
+    /**
+      Links the submissions within the queue.
+      */
+    Submission* next;
+};
+
+/**
+  A lock-free multi producer / single consumer queue of submissions.
+
+  Producers push onto a linked stack using compare and swap. The consumer
+  (the engine thread) takes all submissions at once by swapping the head
+  with NULL and then reverses them into submission order. As single
+  elements are never removed, this doesn't suffer from the ABA problem.
+
+  Waiting for new submissions is the only operation which blocks.
+  */
+class SubmissionQueue
+{
+private:
+    /**
+      Contains the last submission pushed or NULL if the queue is empty.
+      */
+    QAtomicPointer<Submission> head;
+
+    /**
+      Released once for each push, so that the consumer can sleep while
+      there is nothing to do.
+      */
+    QSemaphore signal;
+
+    Q_DISABLE_COPY(SubmissionQueue)
+public:
+    SubmissionQueue() : head(NULL) {}
+    ~SubmissionQueue();
+
+    /**
+      Adds the given submission. Can be called from any thread. The queue
+      takes ownership of the submission.
+      */
+    void push(Submission* submission);
+
+    /**
+      Removes all submissions and returns them in the order they were
+      pushed, linked via next. Must only be called by the consumer, which
+      takes ownership of the returned submissions.
+      */
+    Submission* takeAll();
+
+    /**
+      Determines if there are no pending submissions.
+      */
+    bool isEmpty();
+
+    /**
+      Blocks until wakeUp() is called or a submission was pushed since the
+      last call. Must only be called by the consumer.
+      */
+    void waitForSubmissions();
+
+    /**
+      Wakes up the consumer if it waits for submissions.
+      */
+    void wakeUp();
+};
+
+#endif // SUBMISSIONQUEUE_H
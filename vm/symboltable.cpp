@@ -0,0 +1,44 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+
+#include "vm/symboltable.h"
+
+SymbolTable* SymbolTable::INSTANCE = new SymbolTable();
+
+Word SymbolTable::add(const QString& name) {
+    Word result = 0;
+    {
+        QReadLocker locker(&lock);
+        if (table.find(name, &result)) {
+            return result;
+        }
+    }
+    QWriteLocker locker(&lock);
+    return table.add(name, name);
+}
+
+QString SymbolTable::getName(Word index) {
+    QReadLocker locker(&lock);
+    return table.getKey(index);
+}
+
+Word SymbolTable::size() {
+    QReadLocker locker(&lock);
+    return table.size();
+}
@@ -0,0 +1,82 @@
+/**
+    Licensed to the Apache Software Foundation (ASF) under one
+    or more contributor license agreements.  See the NOTICE file
+    distributed with this work for additional information
+    regarding copyright ownership.  The ASF licenses this file
+    to you under the Apache License, Version 2.0 (the
+    "License"); you may not use this file except in compliance
+    with the License.  You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing,
+    software distributed under the License is distributed on an
+    "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+    KIND, either express or implied.  See the License for the
+    specific language governing permissions and limitations
+    under the License.
+ */
+/**
+  ---------------------------------------------------------------------------
+  Contains the symbol table which is shared by all storages.
+  ---------------------------------------------------------------------------
+  */
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include "vm/env.h"
+#include "vm/lookuptable.h"
+
+#include <QString>
+#include <QReadWriteLock>
+
+/**
+  Maps names to unique symbol indices.
+
+  There is only one symbol table per process (see INSTANCE), so that a
+  symbol has the same index in each storage. As symbols are never removed,
+  the table only grows and each storage (isolate) can use it concurrently.
+  The fixed symbols, declared by Storage::initializeSymbols, therefore keep
+  their indices no matter how many storages are created.
+  */
+class SymbolTable
+{
+private:
+    /**
+      Contains the actual mapping.
+      */
+    LookupTable <QString, QString, Word> table;
+
+    /**
+      Protects the table. Most accesses only lookup existing symbols and
+      can be performed concurrently.
+      */
+    QReadWriteLock lock;
+
+    Q_DISABLE_COPY(SymbolTable)
+public:
+    SymbolTable() {}
+
+    /**
+      Contains the symbol table shared by all storages.
+      */
+    static SymbolTable* INSTANCE;
+
+    /**
+      Returns the index of the given name. Creates a new entry if the name
+      is unknown.
+      */
+    Word add(const QString& name);
+
+    /**
+      Returns the name of the symbol with the given index.
+      */
+    QString getName(Word index);
+
+    /**
+      Returns the number of known symbols.
+      */
+    Word size();
+};
+
+#endif // SYMBOLTABLE_H